@@ -161,17 +161,14 @@ public:
         InetPtonA(AF_INET, "127.0.0.1", &target.sin_addr);
     }
 
+    // Sends one sample. The modular host rate-limits this on its own thread.
     void SendOscData(EtData etData) {
-        while (true)
-        {
-            float eyesClosed[2] = {etData.leftEyeOpenness, etData.rightEyeOpenness};
-            float vec[4] = {etData.leftEyeMiddleCanthusUvX, etData.leftEyeMiddleCanthusUvY,
-                            etData.rightEyeMiddleCanthusUvX, etData.rightEyeMiddleCanthusUvY};
-
-            sendOSC(oscSocket, target, "/tracking/eye/EyesClosedAmount", eyesClosed, 2);
-            sendOSC(oscSocket, target, "/tracking/eye/LeftRightVec", vec, 4);
-        }
+        float eyesClosed[2] = {etData.leftEyeOpenness, etData.rightEyeOpenness};
+        float vec[4] = {etData.leftEyeMiddleCanthusUvX, etData.leftEyeMiddleCanthusUvY,
+                        etData.rightEyeMiddleCanthusUvX, etData.rightEyeMiddleCanthusUvY};
 
+        sendOSC(oscSocket, target, "/tracking/eye/EyesClosedAmount", eyesClosed, 2);
+        sendOSC(oscSocket, target, "/tracking/eye/LeftRightVec", vec, 4);
     }
 
     void Stop()
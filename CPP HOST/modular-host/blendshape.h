@@ -0,0 +1,231 @@
+#include <cstdint>
+#include <cstring>
+#include "framing.h"
+
+#ifndef BLENDSHAPE_H
+#define BLENDSHAPE_H
+
+// Face and lip tracking as a generic blendshape stream, for any number of
+// named channels up to BLENDSHAPE_MAX_CHANNELS. A client that offers
+// HELLO_BLENDSHAPES and has it acknowledged sends, once per connection and
+// before any frame, a FRAME_BLENDSHAPE_DICT:
+//   BlendshapeDictHeader, then channelCount NUL-terminated names
+// naming the channels in the order every FRAME_BLENDSHAPES carries them:
+//   BlendshapeFrameHeader, then channelCount values in the dictionary's encoding
+//
+// Weights are 0..1. At 70 channels and 90 Hz the dense 8-bit encoding is 80
+// payload bytes a frame, a quarter of raw floats, at a step of 1/255 that no
+// avatar rig resolves; 16-bit and float are there for consumers that want them.
+// Names are the only strings on the wire and go once, so the host can map
+// channels to OSC addresses by name whatever runtime the client reads.
+
+#define BLENDSHAPE_MAX_CHANNELS 96
+#define BLENDSHAPE_MAX_NAME 32 // including the NUL
+
+enum BlendshapeEncoding : uint8_t
+{
+    BLENDSHAPE_UNORM8 = 1,  // round(w * 255)
+    BLENDSHAPE_UNORM16 = 2, // round(w * 65535)
+    BLENDSHAPE_FLOAT32 = 3,
+};
+
+// BlendshapeFrame::flags
+#define BLENDSHAPE_EYES_VALID 0x1 // the eye channels follow the eyes, not only the lids
+#define BLENDSHAPE_FROM_AUDIO 0x2 // the mouth was inferred from the microphone
+
+#pragma pack(push, 1)
+struct BlendshapeDictHeader
+{
+    uint8_t encoding;     // BlendshapeEncoding of every frame on the connection
+    uint8_t channelCount;
+};
+
+struct BlendshapeFrameHeader
+{
+    uint64_t time;        // XrTime of the reading, ns
+    uint8_t flags;
+    uint8_t channelCount; // must match the dictionary
+};
+#pragma pack(pop)
+
+struct BlendshapeDictionary
+{
+    uint8_t encoding = BLENDSHAPE_UNORM8;
+    int channelCount = 0;
+    char names[BLENDSHAPE_MAX_CHANNELS][BLENDSHAPE_MAX_NAME];
+};
+
+// One reading of every channel, decoded.
+struct BlendshapeFrame
+{
+    uint64_t time;      // headset XrTime, ns
+    uint64_t captureNs; // sender monotonic clock at capture; not sent
+    uint64_t hostTime;  // time on the host's clock once synced (clocksync.h), 0 otherwise; not sent
+    uint8_t flags;
+    uint8_t channelCount;
+    float weights[BLENDSHAPE_MAX_CHANNELS];
+};
+
+inline size_t BlendshapeValueSize(uint8_t encoding)
+{
+    switch (encoding)
+    {
+    case BLENDSHAPE_UNORM8:
+        return 1;
+    case BLENDSHAPE_UNORM16:
+        return 2;
+    case BLENDSHAPE_FLOAT32:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Largest framed FRAME_BLENDSHAPES, for senders sizing their buffers.
+#define BLENDSHAPE_MAX_FRAME (sizeof(FrameHeader) + sizeof(BlendshapeFrameHeader) + 4 * BLENDSHAPE_MAX_CHANNELS)
+
+// Names become OSC address parts, so they are held to characters that are
+// literal in an OSC address.
+inline bool ValidBlendshapeName(const char *name)
+{
+    size_t length = 0;
+    for (; name[length] != '\0'; ++length)
+    {
+        char c = name[length];
+        bool ok = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' ||
+                  c == '-' || c == '.';
+        if (!ok)
+            return false;
+    }
+    return length > 0 && length < BLENDSHAPE_MAX_NAME;
+}
+
+// Writes dictionary as one framed FRAME_BLENDSHAPE_DICT. Returns its size, or
+// 0 when a name is invalid or the frame does not fit into cap.
+inline size_t WriteBlendshapeDictionary(const BlendshapeDictionary &dictionary, uint8_t *out, size_t cap)
+{
+    uint8_t payload[sizeof(BlendshapeDictHeader) + BLENDSHAPE_MAX_CHANNELS * BLENDSHAPE_MAX_NAME];
+    if (dictionary.channelCount <= 0 || dictionary.channelCount > BLENDSHAPE_MAX_CHANNELS ||
+        BlendshapeValueSize(dictionary.encoding) == 0)
+        return 0;
+    BlendshapeDictHeader hdr{dictionary.encoding, (uint8_t)dictionary.channelCount};
+    std::memcpy(payload, &hdr, sizeof(hdr));
+    size_t length = sizeof(hdr);
+    for (int i = 0; i < dictionary.channelCount; ++i)
+    {
+        if (!ValidBlendshapeName(dictionary.names[i]))
+            return 0;
+        size_t size = std::strlen(dictionary.names[i]) + 1;
+        std::memcpy(payload + length, dictionary.names[i], size);
+        length += size;
+    }
+    return WriteFrame(out, cap, FRAME_BLENDSHAPE_DICT, payload, (uint16_t)length);
+}
+
+// Parses a FRAME_BLENDSHAPE_DICT payload. Rejects unknown encodings, invalid
+// names and trailing bytes.
+inline bool ReadBlendshapeDictionary(const uint8_t *payload, size_t length, BlendshapeDictionary &dictionary)
+{
+    BlendshapeDictHeader hdr;
+    if (length < sizeof(hdr))
+        return false;
+    std::memcpy(&hdr, payload, sizeof(hdr));
+    if (hdr.channelCount == 0 || hdr.channelCount > BLENDSHAPE_MAX_CHANNELS || BlendshapeValueSize(hdr.encoding) == 0)
+        return false;
+
+    size_t at = sizeof(hdr);
+    for (int i = 0; i < hdr.channelCount; ++i)
+    {
+        const void *end = std::memchr(payload + at, '\0', length - at);
+        if (end == nullptr)
+            return false;
+        size_t size = (const uint8_t *)end - (payload + at) + 1;
+        if (size > BLENDSHAPE_MAX_NAME)
+            return false;
+        std::memcpy(dictionary.names[i], payload + at, size);
+        if (!ValidBlendshapeName(dictionary.names[i]))
+            return false;
+        at += size;
+    }
+    if (at != length)
+        return false;
+    dictionary.encoding = hdr.encoding;
+    dictionary.channelCount = hdr.channelCount;
+    return true;
+}
+
+// Writes frame as one framed FRAME_BLENDSHAPES in encoding. Returns its size,
+// or 0 when it does not fit into cap. Weights outside 0..1 are clamped for the
+// integer encodings.
+inline size_t EncodeBlendshapes(const BlendshapeFrame &frame, uint8_t encoding, uint8_t *out, size_t cap)
+{
+    uint8_t payload[sizeof(BlendshapeFrameHeader) + 4 * BLENDSHAPE_MAX_CHANNELS];
+    size_t valueSize = BlendshapeValueSize(encoding);
+    if (valueSize == 0 || frame.channelCount > BLENDSHAPE_MAX_CHANNELS)
+        return 0;
+    BlendshapeFrameHeader hdr{frame.time, frame.flags, frame.channelCount};
+    std::memcpy(payload, &hdr, sizeof(hdr));
+
+    uint8_t *values = payload + sizeof(hdr);
+    for (int i = 0; i < frame.channelCount; ++i)
+    {
+        float w = frame.weights[i];
+        if (encoding == BLENDSHAPE_FLOAT32)
+        {
+            std::memcpy(values + 4 * i, &w, 4);
+            continue;
+        }
+        w = w > 0.0f ? (w < 1.0f ? w : 1.0f) : 0.0f; // also maps NaN to 0
+        if (encoding == BLENDSHAPE_UNORM8)
+        {
+            values[i] = (uint8_t)(w * 255.0f + 0.5f);
+        }
+        else
+        {
+            uint16_t q = (uint16_t)(w * 65535.0f + 0.5f);
+            std::memcpy(values + 2 * i, &q, 2);
+        }
+    }
+    return WriteFrame(out, cap, FRAME_BLENDSHAPES, payload,
+                      (uint16_t)(sizeof(hdr) + valueSize * frame.channelCount));
+}
+
+// Decodes a FRAME_BLENDSHAPES payload sent under dictionary. captureNs and
+// hostTime are left to the caller.
+inline bool DecodeBlendshapes(const uint8_t *payload, size_t length, const BlendshapeDictionary &dictionary,
+                              BlendshapeFrame &frame)
+{
+    BlendshapeFrameHeader hdr;
+    size_t valueSize = BlendshapeValueSize(dictionary.encoding);
+    if (length < sizeof(hdr))
+        return false;
+    std::memcpy(&hdr, payload, sizeof(hdr));
+    if (dictionary.channelCount == 0 || hdr.channelCount != dictionary.channelCount ||
+        length != sizeof(hdr) + valueSize * hdr.channelCount)
+        return false;
+
+    frame.time = hdr.time;
+    frame.flags = hdr.flags;
+    frame.channelCount = hdr.channelCount;
+    const uint8_t *values = payload + sizeof(hdr);
+    for (int i = 0; i < hdr.channelCount; ++i)
+    {
+        if (dictionary.encoding == BLENDSHAPE_UNORM8)
+        {
+            frame.weights[i] = values[i] * (1.0f / 255.0f);
+        }
+        else if (dictionary.encoding == BLENDSHAPE_UNORM16)
+        {
+            uint16_t q;
+            std::memcpy(&q, values + 2 * i, 2);
+            frame.weights[i] = q * (1.0f / 65535.0f);
+        }
+        else
+        {
+            std::memcpy(&frame.weights[i], values + 4 * i, 4);
+        }
+    }
+    return true;
+}
+
+#endif
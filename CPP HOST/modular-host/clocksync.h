@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+// Maps a headset's XrTime onto the host's MonotonicNs(). The host pings the
+// headset with CONTROL_TIME_SYNC (control.h); every answer is one NTP-style
+// exchange:
+//   t1 host send, t2 headset receipt, t3 = t2 + turnaround headset reply, t4 host receipt
+//   offset = ((t2 - t1) + (t3 - t4)) / 2    headset clock minus host clock
+//   delay  = (t4 - t1) - (t3 - t2)          time on the wire, both ways
+//
+// An exchange delayed by queueing gets its offset wrong by up to half the
+// extra delay, always in the same direction as the slower leg. So of the last
+// CLOCK_SYNC_WINDOW exchanges only the CLOCK_SYNC_FIT with the least delay
+// count, and a least-squares line through their offsets over host time gives
+// the offset now and its drift. One exchange is enough to start mapping;
+// drift is estimated once the kept exchanges span CLOCK_SYNC_MIN_SPAN_NS.
+//
+// Not thread safe; the receiving thread owns it.
+
+#define CLOCK_SYNC_WINDOW 32
+#define CLOCK_SYNC_FIT 8
+#define CLOCK_SYNC_MIN_SPAN_NS 2000000000LL
+#define CLOCK_SYNC_MAX_DRIFT 0.0005 // 500 ppm; a bigger slope is a bad fit, not a clock
+
+class ClockSync
+{
+public:
+    void Reset() { *this = ClockSync(); }
+
+    // Adds one exchange. Returns false when it cannot be right: no headset
+    // time, or a negative delay.
+    bool Add(uint64_t hostSend, uint64_t headsetReceive, uint32_t turnaroundNs, uint64_t hostReceive)
+    {
+        int64_t delay = (int64_t)(hostReceive - hostSend) - (int64_t)turnaroundNs;
+        if (headsetReceive == 0 || delay < 0)
+            return false;
+
+        Exchange &e = window[next];
+        next = (next + 1) % CLOCK_SYNC_WINDOW;
+        if (count < CLOCK_SYNC_WINDOW)
+            ++count;
+        e.hostMid = hostSend + (uint64_t)(delay / 2);
+        e.offset = (int64_t)(headsetReceive - hostSend) - delay / 2;
+        e.delay = delay;
+        Fit();
+        return true;
+    }
+
+    bool Synced() const { return count > 0; }
+
+    // The host time headsetTime corresponds to, or 0 before the first exchange.
+    uint64_t ToHostTime(uint64_t headsetTime) const
+    {
+        if (count == 0 || headsetTime == 0)
+            return 0;
+        // offset depends on host time; one correction step is exact to well
+        // below a nanosecond at any plausible drift.
+        uint64_t host = headsetTime - (uint64_t)offset;
+        return headsetTime - (uint64_t)OffsetAt(host);
+    }
+
+    int64_t OffsetNs() const { return offset; }
+    double DriftPpm() const { return drift * 1e6; }
+    int64_t BestDelayNs() const { return bestDelay; }
+    int ExchangeCount() const { return count; }
+
+private:
+    struct Exchange
+    {
+        uint64_t hostMid; // host time of the headset's receipt, by the symmetric estimate
+        int64_t offset;
+        int64_t delay;
+    };
+
+    int64_t OffsetAt(uint64_t host) const
+    {
+        return offset + (int64_t)(drift * (double)(int64_t)(host - reference));
+    }
+
+    void Fit()
+    {
+        Exchange best[CLOCK_SYNC_WINDOW];
+        std::copy(window, window + count, best);
+        int used = count < CLOCK_SYNC_FIT ? count : CLOCK_SYNC_FIT;
+        std::partial_sort(best, best + used, best + count,
+                          [](const Exchange &a, const Exchange &b) { return a.delay < b.delay; });
+        bestDelay = best[0].delay;
+
+        // Offsets relative to the least delayed exchange keep the sums small.
+        reference = best[0].hostMid;
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        uint64_t first = reference, last = reference;
+        for (int i = 0; i < used; ++i)
+        {
+            double x = (double)(int64_t)(best[i].hostMid - reference);
+            double y = (double)(best[i].offset - best[0].offset);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            first = (int64_t)(best[i].hostMid - first) < 0 ? best[i].hostMid : first;
+            last = (int64_t)(best[i].hostMid - last) > 0 ? best[i].hostMid : last;
+        }
+
+        double slope = 0;
+        double denominator = used * sxx - sx * sx;
+        if ((int64_t)(last - first) >= CLOCK_SYNC_MIN_SPAN_NS && denominator > 0)
+            slope = (used * sxy - sx * sy) / denominator;
+        if (slope > CLOCK_SYNC_MAX_DRIFT || slope < -CLOCK_SYNC_MAX_DRIFT)
+            slope = drift; // keep the last estimate that made sense
+        drift = slope;
+        // The line through the mean, evaluated at the reference.
+        offset = best[0].offset + (int64_t)((sy - slope * sx) / used);
+    }
+
+    Exchange window[CLOCK_SYNC_WINDOW];
+    int next = 0;
+    int count = 0;
+    uint64_t reference = 0; // host time the offset below holds for
+    int64_t offset = 0;
+    double drift = 0;       // offset change per host nanosecond
+    int64_t bestDelay = 0;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstdint>
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+// Host -> headset control on the stream connection (TCP only). A client that
+// offers HELLO_CONTROL and has it acknowledged reads FRAME_CONTROL frames from
+// the host and answers each with a FRAME_CONTROL_ACK carrying the same command,
+// whether it was accepted, and the value it actually applied. The one
+// exception is CONTROL_LINK_REPORT, which only informs and is not answered;
+// the host sends it to clients that also offered HELLO_LINK_REPORTS.
+
+enum ControlCommand : uint8_t
+{
+    CONTROL_SET_RATE = 1,     // value: samples per second
+    CONTROL_SET_CHANNELS = 2, // value: bit i enables EtData channel i; disabled channels read 0
+    CONTROL_TIME_SYNC = 3,    // ack: clientTime at receipt, value ns until the reply (clocksync.h)
+    CONTROL_RECALIBRATE = 4,  // restart the eye tracker
+    CONTROL_LINK_REPORT = 5,  // value: smoothed round trip of the time sync pings, us; loss as below
+};
+
+enum ControlStatus : uint8_t
+{
+    CONTROL_OK = 0,
+    CONTROL_UNSUPPORTED = 1,
+};
+
+#define CONTROL_ALL_CHANNELS 0xff
+#define CONTROL_LEFT_CHANNELS 0x35  // left openness, pupil, canthus u and v
+#define CONTROL_RIGHT_CHANNELS 0xca // right openness, pupil, canthus u and v
+
+#pragma pack(push, 1)
+struct ControlPayload
+{
+    uint8_t command;     // ControlCommand
+    uint8_t status;      // ack: ControlStatus
+    uint16_t loss;       // link report: share of pings not answered in time, per mille; otherwise 0
+    uint32_t value;      // request: wanted; ack: applied
+    uint64_t hostTime;   // time sync: host monotonic clock at send, ns, echoed in the ack
+    uint64_t clientTime; // time sync ack: headset XrTime at receipt, ns, as samples are stamped
+};
+#pragma pack(pop)
+
+#endif
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <cstring>
+#include "framing.h"
+#include "latency.h"
+
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+// UDP transport: each datagram is one DatagramHeader followed by exactly one
+// frame (see framing.h). Eye samples are latest-value-wins, so the receiver
+// drops anything older than what it already has instead of waiting for it.
+// Only self-contained frames (legacy messages, v2 key records) go over UDP.
+
+#define DATAGRAM_MAGIC 0x5544 // "DU" on the wire
+
+#pragma pack(push, 1)
+struct DatagramHeader
+{
+    uint16_t magic;
+    uint16_t captureAgeUs; // capture -> send on the sender, us, saturating; 0 = unknown
+    uint32_t sequence; // per sender, +1 per datagram
+    uint64_t sendTime; // sender monotonic clock, ns
+};
+#pragma pack(pop)
+
+// Tracks one sender's sequence numbers and timing, RTP style.
+class DatagramStats
+{
+public:
+    // Returns false when the datagram is stale (not newer than the last one
+    // accepted) and should be dropped.
+    bool Accept(uint32_t sequence, uint64_t sendTime, uint64_t recvTime)
+    {
+        int64_t transit = (int64_t)(recvTime - sendTime);
+        if (received == 0)
+        {
+            firstSequence = sequence;
+            highestSequence = sequence;
+        }
+        else if ((int32_t)(sequence - highestSequence) <= 0)
+        {
+            ++stale;
+            return false;
+        }
+        else
+        {
+            // RFC 3550 interarrival jitter.
+            int64_t d = transit - lastTransit;
+            if (d < 0)
+                d = -d;
+            jitterNs += (d - jitterNs) / 16.0;
+            highestSequence = sequence;
+        }
+
+        lastLatencyNs = floor.Above(sendTime, recvTime);
+        latencyNs += (lastLatencyNs - latencyNs) / 16.0;
+        lastTransit = transit;
+        ++received;
+        return true;
+    }
+
+    uint64_t Expected() const { return received ? (uint64_t)(highestSequence - firstSequence) + 1 : 0; }
+    uint64_t Lost() const { return Expected() - received; }
+
+    uint64_t received = 0;
+    uint64_t stale = 0;
+    double jitterNs = 0;
+    // Without a shared clock the one-way latency is reported relative to the
+    // fastest datagram seen so far, which is what queueing and retries add.
+    double latencyNs = 0;
+    int64_t lastLatencyNs = 0; // of the datagram just accepted
+
+private:
+    uint32_t firstSequence = 0;
+    uint32_t highestSequence = 0;
+    int64_t lastTransit = 0;
+    TransitFloor floor;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include <cstdint>
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+// Host discovery on the local network. A headset without a configured host
+// broadcasts a DISCOVERY_PROBE to DISCOVERY_PORT; every host listening there
+// answers the sender directly with a DISCOVERY_ANNOUNCE naming the port and
+// transport it streams on. The headset connects to the first matching answer.
+
+#define DISCOVERY_PORT 54001
+#define DISCOVERY_MAGIC 0x5344 // "DS" on the wire
+#define DISCOVERY_VERSION 1
+
+enum DiscoveryKind : uint8_t
+{
+    DISCOVERY_PROBE = 1,
+    DISCOVERY_ANNOUNCE = 2,
+};
+
+enum DiscoveryTransport : uint8_t
+{
+    DISCOVERY_TCP = 1,
+    DISCOVERY_UDP = 2,
+};
+
+#pragma pack(push, 1)
+struct DiscoveryMessage
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t kind;        // DiscoveryKind
+    uint16_t streamPort; // announce: where the host accepts eye samples
+    uint8_t transports;  // announce: DiscoveryTransport bits
+    uint8_t reserved;
+    char name[32];       // announce: host name for logs, NUL-terminated
+};
+#pragma pack(pop)
+
+#endif
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "platform.h"
+#include "discovery.h"
+#include "lifecycle.h"
+
+#ifndef DISCOVERYRESPONDER_CPP
+#define DISCOVERYRESPONDER_CPP
+
+// Answers headsets looking for a host (see discovery.h), so they do not need
+// this machine's address baked in. Runs on its own thread next to the host
+// until Stop() or the host's stop token.
+class DiscoveryResponder
+{
+public:
+    explicit DiscoveryResponder(const StopToken &stopToken) : sock(INVALID_SOCKET), stop(stopToken) {}
+    ~DiscoveryResponder() { Stop(); }
+
+    // NetStartup() must have been called.
+    bool Start(uint16_t streamPort, bool udp, uint16_t port = DISCOVERY_PORT)
+    {
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET)
+        {
+            std::cerr << "[DISCOVERY] Socket creation failed\n";
+            return false;
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+
+        // A TCP and a UDP host on the same machine can both answer; on Windows
+        // only the first gets the port (see SetReusePort).
+        SetReusePort(sock);
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+        {
+            std::cerr << "[DISCOVERY] Bind to port " << port << " failed, headsets must be given this host's address\n";
+            CloseSocket(sock);
+            sock = INVALID_SOCKET;
+            return false;
+        }
+
+        announce = DiscoveryMessage{};
+        announce.magic = DISCOVERY_MAGIC;
+        announce.version = DISCOVERY_VERSION;
+        announce.kind = DISCOVERY_ANNOUNCE;
+        announce.streamPort = htons(streamPort);
+        announce.transports = udp ? DISCOVERY_UDP : DISCOVERY_TCP;
+        if (gethostname(announce.name, sizeof(announce.name)) != 0)
+            std::strcpy(announce.name, "host");
+        announce.name[sizeof(announce.name) - 1] = '\0';
+
+        running = true;
+        thread = std::thread(&DiscoveryResponder::Loop, this);
+        std::cout << "[DISCOVERY] Answering on port " << port << "\n";
+        return true;
+    }
+
+    void Stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+        if (sock != INVALID_SOCKET)
+        {
+            CloseSocket(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+
+private:
+    void Loop()
+    {
+        SOCKET wake = stop.WakeSocket();
+        while (running && !stop.Requested())
+        {
+            // Wake up now and then to notice Stop().
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+            if (wake != INVALID_SOCKET)
+                FD_SET(wake, &readable);
+            timeval timeout{0, 200 * 1000};
+            int highest = (int)(wake != INVALID_SOCKET && wake > sock ? wake : sock);
+            if (select(highest + 1, &readable, nullptr, nullptr, &timeout) <= 0 || !FD_ISSET(sock, &readable))
+                continue;
+
+            DiscoveryMessage probe;
+            sockaddr_in from{};
+            socklen_t fromLen = sizeof(from);
+            int received = recvfrom(sock, (char *)&probe, sizeof(probe), 0, (sockaddr *)&from, &fromLen);
+            if (received < 4 || probe.magic != DISCOVERY_MAGIC || probe.kind != DISCOVERY_PROBE)
+                continue;
+
+            sendto(sock, (const char *)&announce, sizeof(announce), 0, (sockaddr *)&from, fromLen);
+            char address[INET_ADDRSTRLEN] = "?";
+            inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+            std::cout << "[DISCOVERY] Answered " << address << "\n";
+        }
+    }
+
+    SOCKET sock;
+    const StopToken &stop;
+    DiscoveryMessage announce{};
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+#endif
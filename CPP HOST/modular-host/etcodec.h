@@ -0,0 +1,219 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "shared.cpp"
+#include "framing.h"
+
+#ifndef ETCODEC_H
+#define ETCODEC_H
+
+// Wire format v2 for eye samples. Instead of the 76-byte legacy Message, each
+// sample is either a key record (XrTime, tracking state and all eight EtData
+// channels as 16-bit fixed point) or, when delta encoding is on, a delta record
+// holding the time step plus int8 deltas for the channels that changed.
+//
+// The version is negotiated at connect: the client sends FRAME_HELLO, the host
+// answers FRAME_HELLO_ACK. A client that gets no answer keeps sending
+// FRAME_LEGACY_MESSAGE.
+
+#define ET_WIRE_LEGACY 1
+#define ET_WIRE_V2 2
+
+#define ET_CHANNELS 8
+
+enum HelloFlags : uint8_t
+{
+    HELLO_DELTA = 1 << 0,
+    HELLO_TIMING = 1 << 1,      // client prefixes each send with a FRAME_TIMING
+    HELLO_CONTROL = 1 << 2,     // client takes FRAME_CONTROL from the host (control.h)
+    HELLO_BLENDSHAPES = 1 << 3, // client sends face and lip tracking (blendshape.h)
+    HELLO_POSES = 1 << 4,       // client sends body and motion-tracker poses (poses.h)
+    HELLO_GAZE = 1 << 5,        // client sends the combined gaze ray (gaze.h)
+    HELLO_LINK_REPORTS = 1 << 6, // client takes CONTROL_LINK_REPORT to adapt its rate (control.h)
+};
+
+#pragma pack(push, 1)
+struct HelloPayload
+{
+    uint8_t version; // highest version the sender speaks
+    uint8_t flags;   // HelloFlags
+};
+
+struct EtTimingPayload
+{
+    uint64_t sendTime;        // sender monotonic clock when the batch was written, ns
+    uint32_t captureToSendNs; // age of the oldest sample in the batch at sendTime
+};
+
+struct EtKeyRecord
+{
+    uint64_t time;          // XrTime, ns
+    uint8_t trackingState;  // XR_EYE_TRACKER_TRACKING_STATE_*_BIT_PICO
+    int16_t channels[ET_CHANNELS];
+};
+
+struct EtDeltaHeader
+{
+    uint32_t timeStep;      // ns since the previous record
+    uint8_t trackingState;
+    uint8_t mask;           // bit i set: an int8 delta for channel i follows
+};
+#pragma pack(pop)
+
+// Fixed-point steps per unit, in EtData field order. Openness and canthus UVs
+// live in [0, 1]; pupil dilation is reported in millimetres.
+static const float kEtChannelScale[ET_CHANNELS] = {
+    4096.0f, 4096.0f,  // openness
+    256.0f, 256.0f,    // pupil dilation
+    4096.0f, 4096.0f,  // left canthus uv
+    4096.0f, 4096.0f,  // right canthus uv
+};
+
+inline int16_t QuantizeChannel(float value, int channel)
+{
+    float q = std::nearbyint(value * kEtChannelScale[channel]);
+    if (!(q >= -32768.0f))
+        q = -32768.0f;
+    if (q > 32767.0f)
+        q = 32767.0f;
+    return (int16_t)q;
+}
+
+inline float DequantizeChannel(int16_t value, int channel)
+{
+    return value / kEtChannelScale[channel];
+}
+
+class EtEncoder
+{
+public:
+    explicit EtEncoder(bool useDelta = false, int keyInterval = 90) : useDelta(useDelta), keyInterval(keyInterval) {}
+
+    void Reset() { hasPrev = false; }
+
+    // Writes one framed v2 record into out and returns its size (0 if cap is too small).
+    size_t Encode(const EtSample &sample, uint8_t *out, size_t cap)
+    {
+        int16_t q[ET_CHANNELS];
+        const float *values = (const float *)&sample.data;
+        for (int i = 0; i < ET_CHANNELS; ++i)
+            q[i] = QuantizeChannel(values[i], i);
+
+        uint8_t state = (uint8_t)sample.trackingState;
+        uint64_t step = sample.time - prevTime;
+        bool delta = useDelta && hasPrev && sinceKey < keyInterval && sample.time >= prevTime && step <= UINT32_MAX;
+
+        uint8_t payload[sizeof(EtDeltaHeader) + ET_CHANNELS];
+        if (delta)
+        {
+            EtDeltaHeader hdr{(uint32_t)step, state, 0};
+            int n = 0;
+            for (int i = 0; i < ET_CHANNELS && delta; ++i)
+            {
+                int d = q[i] - prev[i];
+                if (d == 0)
+                    continue;
+                if (d < -128 || d > 127)
+                    delta = false;
+                hdr.mask |= 1 << i;
+                payload[sizeof(hdr) + n++] = (uint8_t)(int8_t)d;
+            }
+            if (delta)
+            {
+                std::memcpy(payload, &hdr, sizeof(hdr));
+                size_t written = WriteFrame(out, cap, FRAME_ET_V2_DELTA, payload, (uint16_t)(sizeof(hdr) + n));
+                if (written)
+                    Remember(sample.time, q, false);
+                return written;
+            }
+        }
+
+        EtKeyRecord key;
+        key.time = sample.time;
+        key.trackingState = state;
+        std::memcpy(key.channels, q, sizeof(q));
+        size_t written = WriteFrame(out, cap, FRAME_ET_V2_KEY, &key, sizeof(key));
+        if (written)
+            Remember(sample.time, q, true);
+        return written;
+    }
+
+private:
+    void Remember(uint64_t time, const int16_t *q, bool key)
+    {
+        std::memcpy(prev, q, sizeof(prev));
+        prevTime = time;
+        sinceKey = key ? 0 : sinceKey + 1;
+        hasPrev = true;
+    }
+
+    bool useDelta;
+    int keyInterval;
+    bool hasPrev = false;
+    int sinceKey = 0;
+    uint64_t prevTime = 0;
+    int16_t prev[ET_CHANNELS] = {};
+};
+
+class EtDecoder
+{
+public:
+    // Decodes a FRAME_ET_V2_KEY or FRAME_ET_V2_DELTA payload. Delta records
+    // that arrive before any key record are rejected.
+    bool Decode(uint8_t type, const uint8_t *payload, size_t length, EtSample &sample)
+    {
+        if (type == FRAME_ET_V2_KEY)
+        {
+            if (length != sizeof(EtKeyRecord))
+                return false;
+            EtKeyRecord key;
+            std::memcpy(&key, payload, sizeof(key));
+            prevTime = key.time;
+            state = key.trackingState;
+            std::memcpy(prev, key.channels, sizeof(prev));
+            hasPrev = true;
+        }
+        else if (type == FRAME_ET_V2_DELTA)
+        {
+            EtDeltaHeader hdr;
+            if (!hasPrev || length < sizeof(hdr))
+                return false;
+            std::memcpy(&hdr, payload, sizeof(hdr));
+            size_t n = 0;
+            for (int i = 0; i < ET_CHANNELS; ++i)
+                n += (hdr.mask >> i) & 1;
+            if (length != sizeof(hdr) + n)
+                return false;
+
+            const int8_t *deltas = (const int8_t *)(payload + sizeof(hdr));
+            for (int i = 0; i < ET_CHANNELS; ++i)
+            {
+                if (hdr.mask & (1 << i))
+                    prev[i] = (int16_t)(prev[i] + *deltas++);
+            }
+            prevTime += hdr.timeStep;
+            state = hdr.trackingState;
+        }
+        else
+        {
+            return false;
+        }
+
+        sample.time = prevTime;
+        sample.trackingState = state;
+        float *values = (float *)&sample.data;
+        for (int i = 0; i < ET_CHANNELS; ++i)
+            values[i] = DequantizeChannel(prev[i], i);
+        return true;
+    }
+
+    void Reset() { hasPrev = false; }
+
+private:
+    bool hasPrev = false;
+    uint64_t prevTime = 0;
+    uint8_t state = 0;
+    int16_t prev[ET_CHANNELS] = {};
+};
+
+#endif
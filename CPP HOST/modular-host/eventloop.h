@@ -0,0 +1,148 @@
+#include "platform.h"
+#ifdef _WIN32
+#include <vector>
+#else
+#include <sys/epoll.h>
+#endif
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+// Readiness notification for many sockets on one thread: epoll on Linux,
+// WSAPoll on Windows. A Poller is only used from the thread that owns it.
+
+struct PollEvent
+{
+    void *user;    // pointer passed to Add()
+    bool hangup;   // peer closed or error; a final recv() reports which
+    bool writable; // only reported while write interest is on
+};
+
+#ifdef _WIN32
+
+class Poller
+{
+public:
+    bool Add(SOCKET sock, void *user)
+    {
+        WSAPOLLFD pfd{};
+        pfd.fd = sock;
+        pfd.events = POLLRDNORM;
+        fds.push_back(pfd);
+        users.push_back(user);
+        return true;
+    }
+
+    void Remove(SOCKET sock)
+    {
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (fds[i].fd != sock)
+                continue;
+            fds[i] = fds.back();
+            users[i] = users.back();
+            fds.pop_back();
+            users.pop_back();
+            return;
+        }
+    }
+
+    // Also reports sock as writable until switched off again.
+    void WantWrite(SOCKET sock, void *user, bool want)
+    {
+        (void)user;
+        for (WSAPOLLFD &pfd : fds)
+        {
+            if (pfd.fd == sock)
+                pfd.events = want ? (POLLRDNORM | POLLWRNORM) : POLLRDNORM;
+        }
+    }
+
+    // Waits up to timeoutMs; returns the number of events written.
+    int Wait(PollEvent *events, int maxEvents, int timeoutMs)
+    {
+        if (fds.empty())
+        {
+            Sleep(timeoutMs);
+            return 0;
+        }
+        if (WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs) <= 0)
+            return 0;
+
+        int count = 0;
+        for (size_t i = 0; i < fds.size() && count < maxEvents; ++i)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            events[count].user = users[i];
+            events[count].hangup = (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+            events[count].writable = (fds[i].revents & POLLWRNORM) != 0;
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::vector<WSAPOLLFD> fds;
+    std::vector<void *> users;
+};
+
+#else
+
+class Poller
+{
+public:
+    Poller() : epollFd(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~Poller()
+    {
+        if (epollFd >= 0)
+            close(epollFd);
+    }
+    Poller(const Poller &) = delete;
+    Poller &operator=(const Poller &) = delete;
+
+    bool Add(SOCKET sock, void *user)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = user;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &ev) == 0;
+    }
+
+    void Remove(SOCKET sock)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, sock, nullptr);
+    }
+
+    // Also reports sock as writable until switched off again.
+    void WantWrite(SOCKET sock, void *user, bool want)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        if (want)
+            ev.events |= EPOLLOUT;
+        ev.data.ptr = user;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, sock, &ev);
+    }
+
+    // Waits up to timeoutMs; returns the number of events written.
+    int Wait(PollEvent *events, int maxEvents, int timeoutMs)
+    {
+        epoll_event ready[64];
+        int n = epoll_wait(epollFd, ready, maxEvents < 64 ? maxEvents : 64, timeoutMs);
+        for (int i = 0; i < n; ++i)
+        {
+            events[i].user = ready[i].data.ptr;
+            events[i].hangup = (ready[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+            events[i].writable = (ready[i].events & EPOLLOUT) != 0;
+        }
+        return n > 0 ? n : 0;
+    }
+
+private:
+    int epollFd;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,345 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "shared.cpp"
+#include "etcodec.h"
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+// Per-stream smoothing between the receivers and the OSC output. A sample is
+// optionally passed through a median-of-N outlier rejecter, then a One Euro
+// filter or a constant-velocity Kalman filter. While an eye is closed or not
+// tracked, its channels hold the last good value instead.
+//
+// The eight EtData floats are processed as eight lanes with the same code, so
+// every step below is a fixed 8-wide loop the compiler turns into one AVX (or
+// two SSE/NEON) operation. The state of all streams lives in one array, a few
+// hundred bytes per stream, so hundreds of streams fit in L2.
+
+#define MAX_MEDIAN_WINDOW 7
+
+enum class Smoothing
+{
+    None,
+    OneEuro,
+    Kalman,
+};
+
+// "none", "one-euro" or "kalman", as given on the command line.
+inline bool ParseSmoothing(const char *name, Smoothing &out)
+{
+    if (std::strcmp(name, "none") == 0)
+        out = Smoothing::None;
+    else if (std::strcmp(name, "one-euro") == 0)
+        out = Smoothing::OneEuro;
+    else if (std::strcmp(name, "kalman") == 0)
+        out = Smoothing::Kalman;
+    else
+        return false;
+    return true;
+}
+
+// Channel order is the EtData field order: openness L/R, pupil dilation L/R,
+// then the left and right canthus UV pairs.
+struct FilterSettings
+{
+    Smoothing smoothing = Smoothing::None;
+    int medianWindow = 1;        // odd, 1 (off) to MAX_MEDIAN_WINDOW
+    bool holdOnBlink = true;     // freeze pupil and gaze while the eyelid is closed
+    float blinkThreshold = 0.1f; // openness below this counts as closed
+
+    // One Euro: cutoff at rest (Hz) and how fast it opens up with speed.
+    float minCutoffHz[ET_CHANNELS] = {2.0f, 2.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f, 1.0f};
+    float beta[ET_CHANNELS] = {1.0f, 1.0f, 0.1f, 0.1f, 2.0f, 2.0f, 2.0f, 2.0f};
+    float derivativeCutoffHz = 1.0f;
+
+    // Kalman: white-noise acceleration density and measurement variance.
+    float processNoise[ET_CHANNELS] = {10.0f, 10.0f, 0.1f, 0.1f, 1.0f, 1.0f, 1.0f, 1.0f};
+    float measurementNoise[ET_CHANNELS] = {1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-4f, 1e-4f, 1e-4f, 1e-4f};
+};
+
+// Filters for up to streamCount streams. Apply() for a stream must only be
+// called from one thread at a time, which OutputStage::Publish already asks
+// of its callers.
+class FilterBank
+{
+public:
+    explicit FilterBank(int streamCount) : streams(new StreamState[streamCount]), count(streamCount) {}
+
+    // Call before the first Apply().
+    void Configure(const FilterSettings &filterSettings)
+    {
+        settings = filterSettings;
+        if (settings.medianWindow < 1)
+            settings.medianWindow = 1;
+        if (settings.medianWindow > MAX_MEDIAN_WINDOW)
+            settings.medianWindow = MAX_MEDIAN_WINDOW;
+        settings.medianWindow |= 1;
+    }
+
+    // Forgets a stream's history, e.g. when its slot goes to a new headset.
+    void Reset(int id)
+    {
+        if (id >= 0 && id < count)
+            streams[id].primed = false;
+    }
+
+    // Filters one sample into out. Returns false while a stream has not yet
+    // seen anything worth sending, such as the all-zero samples of a tracker
+    // that is still starting. receivedNs stands in for the capture time of
+    // legacy frames, which carry none.
+    bool Apply(int id, const EtSample &sample, uint64_t receivedNs, EtData &out)
+    {
+        if (id < 0 || id >= count)
+        {
+            out = sample.data;
+            return true;
+        }
+        StreamState &s = streams[id];
+
+        alignas(32) float in[ET_CHANNELS];
+        std::memcpy(in, &sample.data, sizeof(in));
+        uint64_t now = sample.time != 0 ? sample.time : receivedNs;
+
+        alignas(32) float hold[ET_CHANNELS];
+        HoldMask(in, sample.trackingState, hold);
+
+        float dt = s.primed ? (float)((int64_t)(now - s.lastNs) * 1e-9) : 0.0f;
+        if (!s.primed || dt > MAX_GAP_S || dt < 0.0f)
+        {
+            float anyTracked = 0.0f;
+            for (int i = 0; i < ET_CHANNELS; ++i)
+                anyTracked += 1.0f - hold[i];
+            if (!s.primed && anyTracked == 0.0f)
+                return false;
+            Prime(s, in, hold);
+            s.lastNs = now;
+            out = sample.data;
+            return true;
+        }
+        if (dt < MIN_DT_S)
+            dt = MIN_DT_S;
+        s.lastNs = now;
+
+        // A lane that just came out of a hold starts over from the new value:
+        // after a blink the eye is usually looking somewhere else.
+        alignas(32) float restart[ET_CHANNELS];
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            restart[i] = (s.held[i] > 0.0f && hold[i] == 0.0f) ? 1.0f : 0.0f;
+            s.held[i] = hold[i];
+        }
+
+        alignas(32) float z[ET_CHANNELS];
+        Median(s, in, restart, z);
+
+        alignas(32) float x[ET_CHANNELS];
+        alignas(32) float v[ET_CHANNELS];
+        switch (settings.smoothing)
+        {
+        case Smoothing::OneEuro:
+            OneEuro(s, z, dt, x, v);
+            break;
+        case Smoothing::Kalman:
+            Kalman(s, z, dt, x, v);
+            break;
+        case Smoothing::None:
+        default:
+            for (int i = 0; i < ET_CHANNELS; ++i)
+            {
+                x[i] = z[i];
+                v[i] = 0.0f;
+            }
+            break;
+        }
+
+        // Held lanes keep their state and output; restarted lanes take the input.
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            float fresh = restart[i] * (1.0f - hold[i]);
+            float kept = hold[i];
+            float next = fresh * z[i] + (1.0f - fresh) * x[i];
+            s.x[i] = kept * s.x[i] + (1.0f - kept) * next;
+            s.v[i] = kept * s.v[i] + (1.0f - kept) * (1.0f - fresh) * v[i];
+        }
+        if (settings.smoothing == Smoothing::Kalman)
+        {
+            for (int i = 0; i < ET_CHANNELS; ++i)
+            {
+                float fresh = restart[i] * (1.0f - hold[i]);
+                s.p00[i] = fresh * settings.measurementNoise[i] + (1.0f - fresh) * s.p00[i];
+                s.p01[i] = (1.0f - fresh) * s.p01[i];
+                s.p11[i] = fresh * INITIAL_VELOCITY_VARIANCE + (1.0f - fresh) * s.p11[i];
+            }
+        }
+
+        std::memcpy(&out, s.x, sizeof(out));
+        return true;
+    }
+
+private:
+    static constexpr float MIN_DT_S = 1e-4f;
+    static constexpr float MAX_GAP_S = 0.5f; // longer silences restart the filters
+    static constexpr float INITIAL_VELOCITY_VARIANCE = 1.0f;
+    static constexpr float PI = 3.14159265f;
+
+    struct StreamState
+    {
+        alignas(32) float x[ET_CHANNELS];  // filtered value
+        alignas(32) float v[ET_CHANNELS];  // One Euro: filtered derivative; Kalman: velocity
+        alignas(32) float p00[ET_CHANNELS]; // Kalman covariance
+        alignas(32) float p01[ET_CHANNELS];
+        alignas(32) float p11[ET_CHANNELS];
+        alignas(32) float held[ET_CHANNELS]; // 1 while the lane is held
+        alignas(32) float window[MAX_MEDIAN_WINDOW][ET_CHANNELS];
+        int windowPos = 0;
+        uint64_t lastNs = 0;
+        bool primed = false;
+    };
+
+    // 1 for every lane that must keep its last value. An eye that is not
+    // tracked holds all four of its channels; a closed eye holds all but its
+    // openness. An all-zero sample means the tracker had nothing at all.
+    void HoldMask(const float *in, uint64_t trackingState, float *hold) const
+    {
+        float any = 0.0f;
+        for (int i = 0; i < ET_CHANNELS; ++i)
+            any += std::fabs(in[i]);
+        bool tracked[2] = {any != 0.0f && (trackingState & ET_TRACKING_LEFT_EYE) != 0,
+                           any != 0.0f && (trackingState & ET_TRACKING_RIGHT_EYE) != 0};
+
+        for (int eye = 0; eye < 2; ++eye)
+        {
+            bool closed = settings.holdOnBlink && in[eye] < settings.blinkThreshold;
+            float holdAll = tracked[eye] ? 0.0f : 1.0f;
+            float holdRest = (!tracked[eye] || closed) ? 1.0f : 0.0f;
+            hold[eye] = holdAll;         // openness
+            hold[2 + eye] = holdRest;    // pupil dilation
+            hold[4 + 2 * eye] = holdRest; // canthus UV
+            hold[5 + 2 * eye] = holdRest;
+        }
+    }
+
+    void Prime(StreamState &s, const float *in, const float *hold)
+    {
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            s.x[i] = in[i];
+            s.v[i] = 0.0f;
+            s.p00[i] = settings.measurementNoise[i];
+            s.p01[i] = 0.0f;
+            s.p11[i] = INITIAL_VELOCITY_VARIANCE;
+            s.held[i] = hold[i];
+        }
+        for (int w = 0; w < MAX_MEDIAN_WINDOW; ++w)
+        {
+            for (int i = 0; i < ET_CHANNELS; ++i)
+                s.window[w][i] = in[i];
+        }
+        s.windowPos = 0;
+        s.primed = true;
+    }
+
+    // Median of the last medianWindow inputs per lane, by an odd-even
+    // transposition sort over whole rows. Held lanes are not added to the
+    // window; restarted lanes refill it with the new value.
+    void Median(StreamState &s, const float *in, const float *restart, float *out) const
+    {
+        int n = settings.medianWindow;
+        if (n == 1)
+        {
+            std::memcpy(out, in, ET_CHANNELS * sizeof(float));
+            return;
+        }
+
+        s.windowPos = (s.windowPos + 1) % n;
+        for (int w = 0; w < n; ++w)
+        {
+            float *row = s.window[w];
+            float write = w == s.windowPos ? 1.0f : 0.0f;
+            for (int i = 0; i < ET_CHANNELS; ++i)
+            {
+                float take = (1.0f - s.held[i]) * (write > restart[i] ? write : restart[i]);
+                row[i] = take * in[i] + (1.0f - take) * row[i];
+            }
+        }
+
+        alignas(32) float sorted[MAX_MEDIAN_WINDOW][ET_CHANNELS];
+        std::memcpy(sorted, s.window, sizeof(float) * ET_CHANNELS * n);
+        for (int pass = 0; pass < n; ++pass)
+        {
+            for (int w = pass & 1; w + 1 < n; w += 2)
+            {
+                for (int i = 0; i < ET_CHANNELS; ++i)
+                {
+                    float a = sorted[w][i], b = sorted[w + 1][i];
+                    sorted[w][i] = a < b ? a : b;
+                    sorted[w + 1][i] = a < b ? b : a;
+                }
+            }
+        }
+        std::memcpy(out, sorted[n / 2], ET_CHANNELS * sizeof(float));
+    }
+
+    // Casiez et al., "1 Euro Filter", CHI 2012.
+    void OneEuro(StreamState &s, const float *z, float dt, float *x, float *v) const
+    {
+        float derivativeAlpha = Alpha(settings.derivativeCutoffHz, dt);
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            float derivative = (z[i] - s.x[i]) / dt;
+            v[i] = s.v[i] + derivativeAlpha * (derivative - s.v[i]);
+            float cutoff = settings.minCutoffHz[i] + settings.beta[i] * std::fabs(v[i]);
+            x[i] = s.x[i] + Alpha(cutoff, dt) * (z[i] - s.x[i]);
+        }
+    }
+
+    // Constant-velocity model per lane: state (position, velocity), covariance
+    // [p00 p01; p01 p11]. The covariance is updated in place for all lanes;
+    // Apply() puts it back for held lanes.
+    void Kalman(StreamState &s, const float *z, float dt, float *x, float *v) const
+    {
+        alignas(32) float keep00[ET_CHANNELS], keep01[ET_CHANNELS], keep11[ET_CHANNELS];
+        float dt2 = dt * dt;
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            keep00[i] = s.p00[i];
+            keep01[i] = s.p01[i];
+            keep11[i] = s.p11[i];
+
+            float q = settings.processNoise[i];
+            float px = s.x[i] + s.v[i] * dt;
+            float p00 = s.p00[i] + dt * (2.0f * s.p01[i] + dt * s.p11[i]) + q * dt2 * dt / 3.0f;
+            float p01 = s.p01[i] + dt * s.p11[i] + q * dt2 / 2.0f;
+            float p11 = s.p11[i] + q * dt;
+
+            float k0 = p00 / (p00 + settings.measurementNoise[i]);
+            float k1 = p01 / (p00 + settings.measurementNoise[i]);
+            float residual = z[i] - px;
+            x[i] = px + k0 * residual;
+            v[i] = s.v[i] + k1 * residual;
+            s.p00[i] = (1.0f - k0) * p00;
+            s.p01[i] = (1.0f - k0) * p01;
+            s.p11[i] = p11 - k1 * p01;
+        }
+        for (int i = 0; i < ET_CHANNELS; ++i)
+        {
+            s.p00[i] = s.held[i] * keep00[i] + (1.0f - s.held[i]) * s.p00[i];
+            s.p01[i] = s.held[i] * keep01[i] + (1.0f - s.held[i]) * s.p01[i];
+            s.p11[i] = s.held[i] * keep11[i] + (1.0f - s.held[i]) * s.p11[i];
+        }
+    }
+
+    static float Alpha(float cutoffHz, float dt)
+    {
+        return 1.0f / (1.0f + 1.0f / (2.0f * PI * cutoffHz * dt));
+    }
+
+    FilterSettings settings;
+    std::unique_ptr<StreamState[]> streams;
+    int count;
+};
+
+#endif
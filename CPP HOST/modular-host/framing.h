@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+// Every record on the headset <-> host stream is wrapped in a FrameHeader so
+// the receiver can find record boundaries no matter how TCP merges or splits
+// segments. Like the rest of the wire structs, fields are little-endian.
+
+#define FRAME_MAGIC 0x5445 // "ET" on the wire
+#define FRAME_VERSION 1
+#define FRAME_MAX_PAYLOAD 4096
+
+enum FrameType : uint8_t
+{
+    FRAME_LEGACY_MESSAGE = 1,  // payload is a raw Message
+    FRAME_HELLO = 2,           // client -> host, HelloPayload
+    FRAME_HELLO_ACK = 3,       // host -> client, HelloPayload with the chosen version
+    FRAME_ET_V2_KEY = 4,       // EtKeyRecord
+    FRAME_ET_V2_DELTA = 5,     // EtDeltaHeader + int8 deltas
+    FRAME_TIMING = 6,          // EtTimingPayload, ahead of each batch when HELLO_TIMING was agreed
+    FRAME_CONTROL = 7,         // host -> client, ControlPayload, when HELLO_CONTROL was agreed
+    FRAME_CONTROL_ACK = 8,     // client -> host, ControlPayload answering a FRAME_CONTROL
+    FRAME_BLENDSHAPE_DICT = 9, // client -> host, channel names, once when HELLO_BLENDSHAPES was agreed
+    FRAME_BLENDSHAPES = 10,    // client -> host, one reading of every channel (blendshape.h)
+    FRAME_POSES = 11,          // client -> host, body joints or motion trackers (poses.h)
+    FRAME_GAZE_RAY = 12,       // client -> host, the combined gaze ray (gaze.h)
+};
+
+#pragma pack(push, 1)
+struct FrameHeader
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t length;   // payload bytes following the header
+    uint16_t checksum; // Fletcher-16 over version, type, length and payload
+};
+#pragma pack(pop)
+
+inline uint16_t Fletcher16(const uint8_t *data, size_t len, uint16_t seed = 0)
+{
+    uint32_t a = seed & 0xff;
+    uint32_t b = seed >> 8;
+    for (size_t i = 0; i < len; ++i)
+    {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (uint16_t)((b << 8) | a);
+}
+
+inline uint16_t FrameChecksum(const FrameHeader &hdr, const uint8_t *payload)
+{
+    // Skip the magic (always the same) and the checksum field itself.
+    uint16_t sum = Fletcher16((const uint8_t *)&hdr.version, 4);
+    return Fletcher16(payload, hdr.length, sum);
+}
+
+// Writes one frame into out. Returns the number of bytes written, or 0 when
+// the frame does not fit into cap.
+inline size_t WriteFrame(uint8_t *out, size_t cap, uint8_t type, const void *payload, uint16_t length)
+{
+    if (length > FRAME_MAX_PAYLOAD || cap < sizeof(FrameHeader) + length)
+        return 0;
+
+    FrameHeader hdr{};
+    hdr.magic = FRAME_MAGIC;
+    hdr.version = FRAME_VERSION;
+    hdr.type = type;
+    hdr.length = length;
+    hdr.checksum = FrameChecksum(hdr, (const uint8_t *)payload);
+
+    std::memcpy(out, &hdr, sizeof(hdr));
+    std::memcpy(out + sizeof(hdr), payload, length);
+    return sizeof(hdr) + length;
+}
+
+// Reassembles frames from an arbitrary byte stream. Bytes are received straight
+// into a ring buffer (WritePtr/Commit) and every whole frame currently buffered
+// is drained with Next(). On a bad magic, version, length or checksum the
+// decoder drops a single byte and scans forward for the next valid header.
+class FrameDecoder
+{
+public:
+    static const size_t CAPACITY = 1 << 16;
+
+    FrameDecoder() : ring(CAPACITY), scratch(FRAME_MAX_PAYLOAD), head(0), tail(0) {}
+
+    // Largest contiguous free region; recv() directly into it, then Commit().
+    uint8_t *WritePtr(size_t &space)
+    {
+        size_t used = tail - head;
+        size_t offset = tail % CAPACITY;
+        space = CAPACITY - used;
+        if (space > CAPACITY - offset)
+            space = CAPACITY - offset;
+        return ring.data() + offset;
+    }
+
+    void Commit(size_t n) { tail += n; }
+
+    // Pops the next whole frame. The payload pointer stays valid until the next
+    // call to Commit() or Next().
+    bool Next(FrameHeader &hdr, const uint8_t *&payload)
+    {
+        while (tail - head >= sizeof(FrameHeader))
+        {
+            Peek(0, &hdr, sizeof(hdr));
+            if (hdr.magic != FRAME_MAGIC || hdr.version != FRAME_VERSION || hdr.length > FRAME_MAX_PAYLOAD)
+            {
+                Skip();
+                continue;
+            }
+
+            if (tail - head < sizeof(hdr) + hdr.length)
+                return false;
+
+            size_t offset = (head + sizeof(hdr)) % CAPACITY;
+            if (offset + hdr.length <= CAPACITY)
+            {
+                payload = ring.data() + offset;
+            }
+            else
+            {
+                Peek(sizeof(hdr), scratch.data(), hdr.length);
+                payload = scratch.data();
+            }
+
+            if (FrameChecksum(hdr, payload) != hdr.checksum)
+            {
+                ++checksumErrors;
+                Skip();
+                continue;
+            }
+
+            head += sizeof(hdr) + hdr.length;
+            ++framesDecoded;
+            return true;
+        }
+        return false;
+    }
+
+    uint64_t framesDecoded = 0;
+    uint64_t bytesSkipped = 0;
+    uint64_t checksumErrors = 0;
+
+private:
+    void Peek(size_t at, void *dst, size_t n) const
+    {
+        size_t offset = (head + at) % CAPACITY;
+        size_t first = n < CAPACITY - offset ? n : CAPACITY - offset;
+        std::memcpy(dst, ring.data() + offset, first);
+        std::memcpy((uint8_t *)dst + first, ring.data(), n - first);
+    }
+
+    void Skip()
+    {
+        ++head;
+        ++bytesSkipped;
+    }
+
+    std::vector<uint8_t> ring;
+    std::vector<uint8_t> scratch;
+    size_t head;
+    size_t tail;
+};
+
+#endif
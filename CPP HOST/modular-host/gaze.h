@@ -0,0 +1,129 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "framing.h"
+#include "poses.h"
+
+#ifndef GAZE_H
+#define GAZE_H
+
+// The combined gaze ray in the headset's app space, computed on the headset
+// from the eye gaze and the head pose at the sample time, so consumers driving
+// look-at targets need not redo the geometry. A client that offers HELLO_GAZE
+// and has it acknowledged sends FRAME_GAZE_RAY, a GazeRayPayload each.
+//
+// 21 bytes a ray: the origin in millimetres as pose positions are
+// (PackPosition), the direction as a 16-bit octahedral unit vector (under
+// 0.01 degrees off), and the convergence distance, where the two eyes' rays
+// pass closest, in millimetres.
+
+// GazeRay::flags
+#define GAZE_CONVERGENCE 0x1 // convergence holds a distance; not for parallel or diverging rays
+#define GAZE_FROM_EYES 0x2   // combined from both eyes' rays, not the runtime's own combined gaze
+
+#pragma pack(push, 1)
+struct GazeRayPayload
+{
+    uint64_t time;          // XrTime the ray was located for, ns
+    int16_t origin[3];      // mm
+    int16_t direction[2];   // octahedral, snorm16
+    uint16_t convergenceMm; // 0 without GAZE_CONVERGENCE, saturates at 65.535 m
+    uint8_t flags;
+};
+#pragma pack(pop)
+
+struct GazeRay
+{
+    uint64_t time;      // headset XrTime, ns
+    uint64_t captureNs; // sender monotonic clock at capture; not sent
+    uint64_t hostTime;  // time on the host's clock once synced (clocksync.h), 0 otherwise; not sent
+    float origin[3];    // m
+    float direction[3]; // unit length
+    float convergence;  // m from the origin along the ray, 0 without GAZE_CONVERGENCE
+    uint8_t flags;
+};
+
+#define GAZE_MAX_FRAME (sizeof(FrameHeader) + sizeof(GazeRayPayload))
+
+inline int16_t PackSnorm16(float v)
+{
+    v = v > -1.0f ? (v < 1.0f ? v : 1.0f) : -1.0f; // also maps NaN to -1
+    return (int16_t)std::nearbyint(v * 32767.0f);
+}
+
+// Projects a unit vector onto the octahedron and unfolds the lower half over
+// the upper, so two numbers cover every direction at a near even resolution.
+inline void PackDirection(const float v[3], int16_t out[2])
+{
+    float l1 = std::fabs(v[0]) + std::fabs(v[1]) + std::fabs(v[2]);
+    if (!(l1 > 0.0f))
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = v[0] / l1, y = v[1] / l1;
+    if (v[2] < 0.0f)
+    {
+        float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = PackSnorm16(x);
+    out[1] = PackSnorm16(y);
+}
+
+inline void UnpackDirection(const int16_t in[2], float v[3])
+{
+    float x = in[0] / 32767.0f, y = in[1] / 32767.0f;
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f)
+    {
+        float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    float length = std::sqrt(x * x + y * y + z * z);
+    v[0] = x / length;
+    v[1] = y / length;
+    v[2] = z / length;
+}
+
+// Writes ray as one framed FRAME_GAZE_RAY. Returns its size, or 0 when it does
+// not fit into cap.
+inline size_t EncodeGazeRay(const GazeRay &ray, uint8_t *out, size_t cap)
+{
+    GazeRayPayload payload;
+    payload.time = ray.time;
+    for (int axis = 0; axis < 3; ++axis)
+        payload.origin[axis] = PackPosition(ray.origin[axis]);
+    PackDirection(ray.direction, payload.direction);
+    payload.flags = ray.flags;
+    payload.convergenceMm = 0;
+    if (ray.flags & GAZE_CONVERGENCE)
+    {
+        float mm = ray.convergence * 1000.0f + 0.5f;
+        payload.convergenceMm = mm > 1.0f ? (mm < 65535.0f ? (uint16_t)mm : 65535) : 1;
+    }
+    return WriteFrame(out, cap, FRAME_GAZE_RAY, &payload, sizeof(payload));
+}
+
+// Decodes a FRAME_GAZE_RAY payload. captureNs and hostTime are left to the
+// caller.
+inline bool DecodeGazeRay(const uint8_t *payload, size_t length, GazeRay &ray)
+{
+    GazeRayPayload in;
+    if (length != sizeof(in))
+        return false;
+    std::memcpy(&in, payload, sizeof(in));
+    ray.time = in.time;
+    for (int axis = 0; axis < 3; ++axis)
+        ray.origin[axis] = in.origin[axis] * 0.001f;
+    UnpackDirection(in.direction, ray.direction);
+    ray.flags = in.flags;
+    ray.convergence = (in.flags & GAZE_CONVERGENCE) ? in.convergenceMm * 0.001f : 0.0f;
+    return true;
+}
+
+#endif
@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "platform.h"
+#include "shared.cpp"
+#include "framing.h"
+#include "etcodec.h"
+#include "control.h"
+#include "blendshape.h"
+#include "poses.h"
+#include "gaze.h"
+#include "clocksync.h"
+#include "eventloop.h"
+#include "lifecycle.h"
+#include "latency.h"
+#include "recording.h"
+#include "outputstage.cpp"
+
+#ifndef HOSTWORKER_CPP
+#define HOSTWORKER_CPP
+
+// Everything the host knows about one headset connection.
+struct Connection
+{
+    SOCKET sock = INVALID_SOCKET;
+    int stream = -1;
+    int wireVersion = ET_WIRE_LEGACY;
+    bool control = false; // the client agreed to HELLO_CONTROL
+    // Mapping of the headset's XrTime onto MonotonicNs(), from the time sync
+    // pings sent to control clients.
+    ClockSync clock;
+    uint64_t nextSyncNs = 0;
+    int syncsSent = 0;
+    bool reportSync = false; // the operator asked for the next time sync
+    // The round trip of the pings and the share of them not answered before
+    // the next went out, both smoothed by an eighth per ping like TCP's SRTT.
+    // Sent on to clients that agreed to HELLO_LINK_REPORTS.
+    bool linkReports = false;
+    double roundTripNs = 0;
+    double pingLoss = 0;
+    uint64_t lastPingNs = 0;
+    bool pingAnswered = true;
+    // Frames the socket has not taken yet, oldest first; outboxSent bytes of
+    // the first are already out. Write interest is on while it is not empty.
+    std::vector<uint8_t> outbox;
+    size_t outboxSent = 0;
+    FrameDecoder decoder;
+    EtDecoder etDecoder;
+    // Face and lip channels, from the FRAME_BLENDSHAPE_DICT of a client that
+    // agreed to HELLO_BLENDSHAPES; channelCount stays 0 until it arrives.
+    BlendshapeDictionary blendshapes;
+    // Filled from FRAME_TIMING when the client agreed to HELLO_TIMING.
+    LatencyHistogram captureToSend;
+    LatencyHistogram wire;
+    TransitFloor transit;
+};
+
+// Serves a share of the connections on one thread. The accept loop hands new
+// sockets over with Adopt(); from then on only this worker touches them.
+// Once stop is requested the worker reads what its connections still have
+// buffered, publishes it and returns.
+class HostWorker
+{
+public:
+    // recorder may be null; otherwise every decoded sample is also recorded.
+    HostWorker(int workerId, OutputStage &outputStage, Recorder *sampleRecorder, const StopToken &stopToken)
+        : id(workerId), output(outputStage), recorder(sampleRecorder), stop(stopToken) {}
+
+    void Start()
+    {
+        running = true;
+        poller.Add(stop.WakeSocket(), nullptr);
+        thread = std::thread(&HostWorker::Run, this);
+    }
+
+    void Adopt(SOCKET sock)
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        inbox.push_back(sock);
+        ++connectionCount; // counted now so a burst of accepts spreads over workers
+    }
+
+    // Queues a control request for this worker's connection on stream, or for
+    // all of them when stream is -1. Clients that did not agree to
+    // HELLO_CONTROL are skipped.
+    void Control(int stream, const ControlPayload &request)
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        controls.push_back(PendingControl{stream, request});
+    }
+
+    // Joins the worker and closes its connections, including any handed over
+    // too late to be served.
+    void Stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+        for (auto &entry : connections)
+            Close(*entry.second);
+        connections.clear();
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        for (SOCKET sock : inbox)
+            CloseSocket(sock);
+        inbox.clear();
+        connectionCount = 0;
+    }
+
+    size_t ConnectionCount() const { return connectionCount; }
+
+private:
+    struct PendingControl
+    {
+        int stream;
+        ControlPayload request;
+    };
+
+    void Run()
+    {
+        PollEvent events[64];
+        auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (running && !stop.Requested())
+        {
+            TakeInbox();
+            SyncClocks();
+
+            if (std::chrono::steady_clock::now() >= nextReport)
+            {
+                nextReport += std::chrono::seconds(5);
+                Report();
+            }
+
+            int n = poller.Wait(events, 64, 50);
+            for (int i = 0; i < n; ++i)
+            {
+                if (events[i].user == nullptr)
+                    continue; // the stop token; the loop condition sees it
+                Connection &conn = *(Connection *)events[i].user;
+                if (events[i].writable)
+                    Flush(conn);
+                if (!Receive(conn))
+                {
+                    std::cout << "[SERVER] Client disconnected (worker " << id << ", stream " << conn.stream << ").\n";
+                    Close(conn);
+                    connections.erase(conn.sock);
+                    connectionCount = connections.size();
+                }
+            }
+        }
+
+        // Samples already in the socket buffers still go out before the sinks stop.
+        for (auto &entry : connections)
+            Receive(*entry.second);
+    }
+
+    void TakeInbox()
+    {
+        std::vector<SOCKET> adopted;
+        std::vector<PendingControl> requests;
+        {
+            std::lock_guard<std::mutex> lock(inboxMutex);
+            adopted.swap(inbox);
+            requests.swap(controls);
+        }
+        for (const PendingControl &pending : requests)
+            SendControl(pending.stream, pending.request);
+
+        for (SOCKET sock : adopted)
+        {
+            // Control frames are a few bytes each; without this, one sent right
+            // after another waits for the headset's delayed ack.
+            int noDelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+            std::unique_ptr<Connection> conn(new Connection());
+            conn->sock = sock;
+            conn->stream = output.AddStream();
+            if (conn->stream < 0)
+            {
+                // Its samples would have nowhere to go.
+                std::cout << "[SERVER] All output streams in use, connection refused (worker " << id << ").\n";
+                CloseSocket(sock);
+                continue;
+            }
+            if (!poller.Add(sock, conn.get()))
+            {
+                Close(*conn);
+                continue;
+            }
+            std::cout << "[SERVER] Client connected (worker " << id << ", stream " << conn->stream << ").\n";
+            connections[sock] = std::move(conn);
+        }
+        connectionCount = connections.size();
+    }
+
+    // Drains what the socket has right now. Returns false once the peer is gone.
+    bool Receive(Connection &conn)
+    {
+        while (true)
+        {
+            size_t space;
+            char *dst = (char *)conn.decoder.WritePtr(space);
+            int bytesReceived = recv(conn.sock, dst, (int)space, 0);
+            if (bytesReceived == 0)
+                return false;
+            if (bytesReceived < 0)
+                return NetWouldBlock();
+            conn.decoder.Commit(bytesReceived);
+            uint64_t now = MonotonicNs();
+
+            // One recv may carry any number of whole frames, plus the start of the next.
+            FrameHeader hdr;
+            const uint8_t *payload;
+            while (conn.decoder.Next(hdr, payload))
+                HandleFrame(conn, hdr, payload, now);
+        }
+    }
+
+    // One line per connection that reported timing since the last report, and
+    // one per synced clock.
+    void Report()
+    {
+        for (auto &entry : connections)
+        {
+            Connection &conn = *entry.second;
+            if (conn.clock.Synced())
+                PrintClock(conn);
+            if (conn.captureToSend.Count() == 0)
+                continue;
+            char captureLine[128], wireLine[128];
+            FormatLatency(captureLine, sizeof(captureLine), "capture->send", conn.captureToSend);
+            FormatLatency(wireLine, sizeof(wireLine), "wire over min", conn.wire);
+            std::cout << "[SERVER] Stream " << conn.stream << ": " << captureLine << " | " << wireLine << "\n";
+            conn.captureToSend.Reset();
+            conn.wire.Reset();
+        }
+    }
+
+    // Pings every control client for the clock mapping: quickly at first so
+    // samples get host times soon after connecting, then once per interval to
+    // follow drift. Only pings that had a whole interval to be answered count
+    // towards the loss, and link reports go out from then on as well.
+    void SyncClocks()
+    {
+        uint64_t now = MonotonicNs();
+        for (auto &entry : connections)
+        {
+            Connection &conn = *entry.second;
+            if (!conn.control || now < conn.nextSyncNs)
+                continue;
+            if (conn.syncsSent >= CLOCK_SYNC_FIT)
+            {
+                conn.pingLoss += ((conn.pingAnswered ? 0.0 : 1.0) - conn.pingLoss) / 8;
+                if (conn.linkReports && conn.roundTripNs > 0)
+                    SendLinkReport(conn);
+            }
+            ControlPayload request{};
+            request.command = CONTROL_TIME_SYNC;
+            conn.lastPingNs = now;
+            conn.pingAnswered = false;
+            SendControlTo(conn, request);
+            ++conn.syncsSent;
+            conn.nextSyncNs = now + (conn.syncsSent < CLOCK_SYNC_FIT ? SYNC_BURST_INTERVAL_NS : SYNC_INTERVAL_NS);
+        }
+    }
+
+    void SendLinkReport(Connection &conn)
+    {
+        ControlPayload report{};
+        report.command = CONTROL_LINK_REPORT;
+        report.value = (uint32_t)std::min(conn.roundTripNs / 1000.0, 4294967295.0);
+        report.loss = (uint16_t)std::lround(conn.pingLoss * 1000.0);
+        SendControlTo(conn, report);
+    }
+
+    void SendControl(int stream, const ControlPayload &request)
+    {
+        for (auto &entry : connections)
+        {
+            Connection &conn = *entry.second;
+            if (stream >= 0 && conn.stream != stream)
+                continue;
+            if (!conn.control)
+            {
+                if (stream >= 0)
+                    std::cout << "[SERVER] Stream " << conn.stream << " does not take control requests\n";
+                continue;
+            }
+            if (request.command == CONTROL_TIME_SYNC)
+                conn.reportSync = true;
+            SendControlTo(conn, request);
+        }
+    }
+
+    void SendControlTo(Connection &conn, ControlPayload request)
+    {
+        request.hostTime = MonotonicNs();
+        uint8_t frame[sizeof(FrameHeader) + sizeof(ControlPayload)];
+        size_t length = WriteFrame(frame, sizeof(frame), FRAME_CONTROL, &request, sizeof(request));
+        // A full outbox means the headset is not reading; the operator can retry.
+        if (!Queue(conn, frame, length))
+            std::cout << "[SERVER] Stream " << conn.stream << ": control request not sent\n";
+    }
+
+    // Appends a whole frame to the outbox and sends what the socket takes.
+    // Returns false when the frame was dropped because the outbox is full; a
+    // frame already started always goes out whole, so the headset never sees
+    // a torn one.
+    bool Queue(Connection &conn, const uint8_t *frame, size_t length)
+    {
+        if (conn.outbox.size() - conn.outboxSent + length > OUTBOX_CAPACITY)
+            return false;
+        conn.outbox.insert(conn.outbox.end(), frame, frame + length);
+        Flush(conn);
+        return true;
+    }
+
+    void Flush(Connection &conn)
+    {
+        bool waiting = conn.outboxSent < conn.outbox.size();
+        while (conn.outboxSent < conn.outbox.size())
+        {
+            int n = send(conn.sock, (const char *)conn.outbox.data() + conn.outboxSent,
+                         (int)(conn.outbox.size() - conn.outboxSent), 0);
+            if (n <= 0)
+            {
+                if (n < 0 && NetWouldBlock())
+                    break;
+                // The connection is gone; Receive() notices and closes it.
+                conn.outboxSent = conn.outbox.size();
+                break;
+            }
+            conn.outboxSent += n;
+        }
+        if (conn.outboxSent == conn.outbox.size())
+        {
+            conn.outbox.clear();
+            conn.outboxSent = 0;
+        }
+        bool pending = !conn.outbox.empty();
+        if (pending != waiting)
+            poller.WantWrite(conn.sock, &conn, pending);
+    }
+
+    void PrintClock(const Connection &conn)
+    {
+        std::cout << "[SERVER] Stream " << conn.stream << ": headset clock " << conn.clock.OffsetNs() / 1e6
+                  << " ms ahead of the host, drift " << conn.clock.DriftPpm() << " ppm, best round trip "
+                  << conn.clock.BestDelayNs() / 1e6 << " ms over " << conn.clock.ExchangeCount() << " pings";
+        if (conn.syncsSent > CLOCK_SYNC_FIT)
+            std::cout << ", smoothed round trip " << conn.roundTripNs / 1e6 << " ms, " << conn.pingLoss * 100.0
+                      << "% pings late";
+        std::cout << "\n";
+    }
+
+    void HandleControlAck(Connection &conn, const ControlPayload &ack, uint64_t receivedNs)
+    {
+        if (ack.command == CONTROL_TIME_SYNC && ack.status == CONTROL_OK)
+        {
+            // For a time sync, value is how long the headset held the request.
+            if (!conn.clock.Add(ack.hostTime, ack.clientTime, ack.value, receivedNs))
+                return;
+            // An answer to an older ping arrives too late to count.
+            if (ack.hostTime >= conn.lastPingNs)
+                conn.pingAnswered = true;
+            double delay = (double)(receivedNs - ack.hostTime - ack.value);
+            conn.roundTripNs = conn.roundTripNs == 0 ? delay : conn.roundTripNs + (delay - conn.roundTripNs) / 8;
+            if (conn.reportSync)
+                PrintClock(conn);
+            conn.reportSync = false;
+            return;
+        }
+
+        std::cout << "[SERVER] Stream " << conn.stream << ": ";
+        if (ack.status != CONTROL_OK)
+        {
+            std::cout << "control command " << (int)ack.command << " not supported\n";
+            return;
+        }
+        switch (ack.command)
+        {
+        case CONTROL_SET_RATE:
+            std::cout << "sampling at " << ack.value << " Hz\n";
+            break;
+        case CONTROL_SET_CHANNELS:
+            std::cout << "sending channels 0x" << std::hex << ack.value << std::dec << "\n";
+            break;
+        case CONTROL_RECALIBRATE:
+            std::cout << "restarting its eye tracker\n";
+            break;
+        default:
+            std::cout << "acknowledged control command " << (int)ack.command << "\n";
+            break;
+        }
+    }
+
+    void Close(Connection &conn)
+    {
+        if (conn.decoder.bytesSkipped > 0)
+        {
+            std::cout << "[SERVER] Resynced stream: skipped " << conn.decoder.bytesSkipped << " bytes, "
+                      << conn.decoder.checksumErrors << " checksum errors\n";
+        }
+        poller.Remove(conn.sock);
+        CloseSocket(conn.sock);
+        output.RemoveStream(conn.stream);
+    }
+
+    void HandleFrame(Connection &conn, const FrameHeader &hdr, const uint8_t *payload, uint64_t receivedNs)
+    {
+        switch (hdr.type)
+        {
+        case FRAME_HELLO:
+        {
+            if (hdr.length < sizeof(HelloPayload))
+                return;
+            HelloPayload hello;
+            std::memcpy(&hello, payload, sizeof(hello));
+
+            HelloPayload ack{};
+            ack.version = hello.version < ET_WIRE_V2 ? hello.version : ET_WIRE_V2;
+            ack.flags = hello.flags & (HELLO_DELTA | HELLO_TIMING | HELLO_CONTROL | HELLO_BLENDSHAPES | HELLO_POSES |
+                                       HELLO_GAZE | HELLO_LINK_REPORTS);
+            conn.wireVersion = ack.version;
+            conn.control = (ack.flags & HELLO_CONTROL) != 0;
+            conn.linkReports = conn.control && (ack.flags & HELLO_LINK_REPORTS) != 0;
+            conn.etDecoder.Reset();
+            conn.blendshapes.channelCount = 0;
+
+            uint8_t frame[sizeof(FrameHeader) + sizeof(HelloPayload)];
+            size_t length = WriteFrame(frame, sizeof(frame), FRAME_HELLO_ACK, &ack, sizeof(ack));
+            if (!Queue(conn, frame, length))
+                std::cout << "[SERVER] Stream " << conn.stream << ": hello not answered\n";
+            std::cout << "[SERVER] Client speaks wire v" << (int)ack.version
+                      << ((ack.flags & HELLO_DELTA) ? " with delta encoding" : "")
+                      << ((ack.flags & HELLO_TIMING) ? " with timing" : "")
+                      << ((ack.flags & HELLO_CONTROL) ? " with control" : "")
+                      << ((ack.flags & HELLO_BLENDSHAPES) ? " with face tracking" : "")
+                      << ((ack.flags & HELLO_POSES) ? " with body tracking" : "")
+                      << ((ack.flags & HELLO_GAZE) ? " with gaze ray" : "")
+                      << (conn.linkReports ? " with link reports\n" : "\n");
+            return;
+        }
+        case FRAME_CONTROL_ACK:
+        {
+            if (hdr.length < sizeof(ControlPayload))
+                return;
+            ControlPayload ack;
+            std::memcpy(&ack, payload, sizeof(ack));
+            HandleControlAck(conn, ack, receivedNs);
+            return;
+        }
+        case FRAME_BLENDSHAPE_DICT:
+        {
+            if (!ReadBlendshapeDictionary(payload, hdr.length, conn.blendshapes))
+            {
+                conn.blendshapes.channelCount = 0;
+                std::cout << "[SERVER] Stream " << conn.stream << ": invalid face channel dictionary\n";
+                return;
+            }
+            std::cout << "[SERVER] Stream " << conn.stream << ": " << conn.blendshapes.channelCount
+                      << " face channels, " << 8 * BlendshapeValueSize(conn.blendshapes.encoding) << "-bit\n";
+            output.BlendshapeChannels(conn.stream, conn.blendshapes);
+            return;
+        }
+        case FRAME_BLENDSHAPES:
+        {
+            BlendshapeFrame frame;
+            if (!DecodeBlendshapes(payload, hdr.length, conn.blendshapes, frame))
+                return;
+            frame.captureNs = 0;
+            frame.hostTime = conn.clock.ToHostTime(frame.time);
+            output.PublishBlendshapes(conn.stream, frame, receivedNs);
+            return;
+        }
+        case FRAME_POSES:
+        {
+            PoseFrame frame{};
+            if (!DecodePoses(payload, hdr.length, frame))
+                return;
+            frame.hostTime = conn.clock.ToHostTime(frame.time);
+            output.PublishPoses(conn.stream, frame, receivedNs);
+            return;
+        }
+        case FRAME_GAZE_RAY:
+        {
+            GazeRay ray;
+            if (!DecodeGazeRay(payload, hdr.length, ray))
+                return;
+            ray.captureNs = 0;
+            ray.hostTime = conn.clock.ToHostTime(ray.time);
+            output.PublishGazeRay(conn.stream, ray, receivedNs);
+            return;
+        }
+        case FRAME_TIMING:
+        {
+            if (hdr.length != sizeof(EtTimingPayload))
+                return;
+            EtTimingPayload timing;
+            std::memcpy(&timing, payload, sizeof(timing));
+            conn.captureToSend.Record(timing.captureToSendNs);
+            conn.wire.Record(conn.transit.Above(timing.sendTime, receivedNs));
+            return;
+        }
+        case FRAME_LEGACY_MESSAGE:
+        {
+            if (hdr.length != sizeof(Message))
+                return;
+            Message msg;
+            std::memcpy(&msg, payload, sizeof(msg));
+            EtSample sample{0, ET_TRACKING_BOTH_EYES, 0, msg.etData, 0};
+            if (recorder)
+                recorder->Record(conn.stream, sample, receivedNs);
+            output.Publish(conn.stream, sample, receivedNs);
+            return;
+        }
+        case FRAME_ET_V2_KEY:
+        case FRAME_ET_V2_DELTA:
+        {
+            EtSample sample;
+            if (!conn.etDecoder.Decode(hdr.type, payload, hdr.length, sample))
+                return;
+            sample.hostTime = conn.clock.ToHostTime(sample.time);
+            if (recorder)
+                recorder->Record(conn.stream, sample, receivedNs);
+            output.Publish(conn.stream, sample, receivedNs);
+            return;
+        }
+        default:
+            return;
+        }
+    }
+
+    static const uint64_t SYNC_BURST_INTERVAL_NS = 100000000ULL;
+    static const uint64_t SYNC_INTERVAL_NS = 1000000000ULL;
+    static const size_t OUTBOX_CAPACITY = 16384; // hundreds of control frames
+
+    int id;
+    OutputStage &output;
+    Recorder *recorder;
+    const StopToken &stop;
+    Poller poller;
+    std::map<SOCKET, std::unique_ptr<Connection>> connections;
+    std::atomic<size_t> connectionCount{0};
+    std::mutex inboxMutex;
+    std::vector<SOCKET> inbox;            // guarded by inboxMutex
+    std::vector<PendingControl> controls; // guarded by inboxMutex
+    std::thread thread;
+    std::atomic<bool> running{false};
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Latency bookkeeping shared by the headset and the host. Every stage of a
+// sample's trip is timed on the monotonic clock of the machine that sees both
+// ends of the stage:
+//   capture -> send   headset, EtSample::captureNs until the frame hits the socket
+//   wire              host receive time minus the headset's send time
+//   receive -> OSC    host, recv() until the OSC bundle is sent
+
+inline uint64_t MonotonicNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// HDR-style histogram: exact below 64 ns, above that 32 buckets per power of
+// two, so every recorded value is kept to within about 3%. Fixed size, no
+// allocation, not thread safe; each recording thread owns its histograms.
+class LatencyHistogram
+{
+public:
+    void Record(int64_t ns)
+    {
+        uint64_t value = ns > 0 ? (uint64_t)ns : 0;
+        if (value > MAX_VALUE)
+            value = MAX_VALUE;
+        ++counts[Index(value)];
+        ++count;
+        if (value > max)
+            max = value;
+    }
+
+    // Smallest value that at least fraction q of the recordings do not exceed.
+    uint64_t Percentile(double q) const
+    {
+        if (count == 0)
+            return 0;
+        uint64_t target = (uint64_t)(q * count + 0.5);
+        if (target < 1)
+            target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen >= target)
+            {
+                uint64_t upper = ValueAt(i + 1) - 1;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    uint64_t Count() const { return count; }
+    uint64_t Max() const { return max; }
+
+    void Reset()
+    {
+        std::memset(counts, 0, sizeof(counts));
+        count = 0;
+        max = 0;
+    }
+
+private:
+    static const int SUB_BITS = 5;
+    static const uint64_t SUB = 1 << SUB_BITS;
+    static const uint64_t MAX_VALUE = (1ULL << 40) - 1; // ~18 minutes
+    static const int BUCKETS = (int)(SUB * (40 - SUB_BITS) + SUB);
+
+    static int Index(uint64_t value)
+    {
+        if (value < 2 * SUB)
+            return (int)value;
+        int msb = 63;
+        while (!(value >> msb))
+            --msb;
+        int shift = msb - SUB_BITS;
+        return (int)(SUB * shift + (value >> shift));
+    }
+
+    static uint64_t ValueAt(int index)
+    {
+        if (index < (int)(2 * SUB))
+            return (uint64_t)index;
+        int shift = index / (int)SUB - 1;
+        return (SUB + index % SUB) << shift;
+    }
+
+    uint32_t counts[BUCKETS] = {};
+    uint64_t count = 0;
+    uint64_t max = 0;
+};
+
+// Writes "label p50=0.41 p99=1.20 p999=3.05 max=4.00ms n=450" into out.
+inline void FormatLatency(char *out, size_t cap, const char *label, const LatencyHistogram &h)
+{
+    std::snprintf(out, cap, "%s p50=%.2f p99=%.2f p999=%.2f max=%.2fms n=%llu", label,
+                  h.Percentile(0.50) / 1e6, h.Percentile(0.99) / 1e6, h.Percentile(0.999) / 1e6,
+                  h.Max() / 1e6, (unsigned long long)h.Count());
+}
+
+// The headset and host clocks are not synchronised, so a one-way transit time
+// (recv - send) carries an unknown offset. Reporting it relative to the fastest
+// transit seen so far cancels the offset and leaves what queueing, Wi-Fi
+// retries and scheduling add on top of the best case.
+class TransitFloor
+{
+public:
+    int64_t Above(uint64_t sendTime, uint64_t recvTime)
+    {
+        int64_t transit = (int64_t)(recvTime - sendTime);
+        if (!seen || transit < floor)
+            floor = transit;
+        seen = true;
+        return transit - floor;
+    }
+
+private:
+    bool seen = false;
+    int64_t floor = 0;
+};
+
+#endif
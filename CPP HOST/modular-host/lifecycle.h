@@ -0,0 +1,175 @@
+#include <atomic>
+#include <cstring>
+#include "platform.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/select.h>
+#endif
+
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+// Orderly shutdown of the host. One StopToken is shared by every loop that
+// runs until the host stops: the accept loop, the workers, the UDP receiver
+// and the discovery responder. Request() raises it from anywhere, a signal
+// handler included, and wakes all of them at once: besides setting a flag it
+// makes a loopback socket readable, which each loop waits on next to its own
+// sockets. Loops that block in a receive of their own (the UDP host) register
+// their address with WakeAlso() and get an empty datagram instead.
+
+#define STOP_MAX_WAKE_TARGETS 4
+
+class StopToken
+{
+public:
+    ~StopToken() { Close(); }
+
+    // Creates the wake socket; NetStartup() must have been called. Harmless
+    // when already open.
+    bool Open()
+    {
+        if (wakeSocket != INVALID_SOCKET)
+            return true;
+        SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET)
+            return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+            getsockname(sock, (sockaddr *)&addr, &length) == SOCKET_ERROR)
+        {
+            CloseSocket(sock);
+            return false;
+        }
+        SetNonBlocking(sock);
+        wakeAddress = addr;
+        wakeSocket = sock;
+        if (Requested())
+            Wake();
+        return true;
+    }
+
+    void Close()
+    {
+        if (wakeSocket == INVALID_SOCKET)
+            return;
+        CloseSocket(wakeSocket);
+        wakeSocket = INVALID_SOCKET;
+    }
+
+    // Async-signal-safe: an atomic store and a few sendto() calls.
+    void Request()
+    {
+        if (!requested.exchange(true))
+            Wake();
+    }
+
+    bool Requested() const { return requested.load(std::memory_order_acquire); }
+
+    // Readable from the first Request() on, and never drained.
+    SOCKET WakeSocket() const { return wakeSocket; }
+
+    // Also sends an empty datagram to addr on Request(). Call before the
+    // signal handlers are installed.
+    void WakeAlso(const sockaddr_in &addr)
+    {
+        if (wakeTargetCount < STOP_MAX_WAKE_TARGETS)
+            wakeTargets[wakeTargetCount++] = addr;
+    }
+
+    // Sleeps until Request() or timeoutMs passes (forever when negative).
+    // Returns Requested().
+    bool Wait(int timeoutMs) const
+    {
+        while (!Requested())
+        {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(wakeSocket, &readable);
+            timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            int ready = select((int)wakeSocket + 1, &readable, nullptr, nullptr, timeoutMs < 0 ? nullptr : &timeout);
+            if (ready == 0)
+                break;
+        }
+        return Requested();
+    }
+
+private:
+    void Wake()
+    {
+        char byte = 0;
+        if (wakeSocket == INVALID_SOCKET)
+            return;
+        sendto(wakeSocket, &byte, 1, 0, (const sockaddr *)&wakeAddress, sizeof(wakeAddress));
+        for (int i = 0; i < wakeTargetCount; ++i)
+            sendto(wakeSocket, &byte, 0, 0, (const sockaddr *)&wakeTargets[i], sizeof(wakeTargets[i]));
+    }
+
+    std::atomic<bool> requested{false};
+    SOCKET wakeSocket = INVALID_SOCKET;
+    sockaddr_in wakeAddress{};
+    sockaddr_in wakeTargets[STOP_MAX_WAKE_TARGETS];
+    int wakeTargetCount = 0;
+};
+
+// The token SIGINT and SIGTERM (Ctrl+C and closing the console on Windows)
+// request.
+inline StopToken &HostStop()
+{
+    static StopToken token;
+    return token;
+}
+
+#ifdef _WIN32
+inline BOOL WINAPI OnConsoleStop(DWORD)
+{
+    HostStop().Request();
+    return TRUE;
+}
+#else
+inline void OnStopSignal(int)
+{
+    HostStop().Request();
+}
+#endif
+
+// Call first thing in main. Installs the handlers and, on POSIX, holds the
+// signals back on this thread and every thread it starts, until
+// DeliverStopSignals(). Without SA_RESTART, a signal then interrupts whatever
+// the main thread is blocked in.
+inline void CatchStopSignals()
+{
+#ifdef _WIN32
+    SetConsoleCtrlHandler(OnConsoleStop, TRUE);
+#else
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = OnStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+#endif
+}
+
+// Call on the main thread once every other thread is started, so the stop
+// signals land on it.
+inline void DeliverStopSignals()
+{
+#ifndef _WIN32
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+#endif
+}
+
+#endif
@@ -0,0 +1,692 @@
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "platform.h"
+#include "shared.cpp"
+#include "framing.h"
+#include "etcodec.h"
+#include "datagram.h"
+#include "latency.h"
+#include "eventloop.h"
+
+// Synthetic headsets for load-testing the host (Linux). Each simulated headset
+// opens its own connection, negotiates like TcpClientV2.h and streams modelled
+// eye movement. When run on the host machine it also listens for the host's OSC
+// output, matches every bundle to the sample that produced it, and reports the
+// end-to-end send -> OSC latency together with the host's CPU use. Matching
+// needs the host to forward values unchanged, so run it with "resample latest",
+// its filter off and the default OSC map; bundles sent while a blink holds the
+// gaze (see filters.h) count as unmatched.
+//
+//   EtLoadGen [host <ip>] [port <n>] [clients <n>] [rate <hz>] [seconds <n>] [threads <n>]
+//             [legacy|v2|delta] [udp] [osc-namespace] [no-osc] [host-pid <pid>]
+//
+//   legacy          the original Message struct, no hello
+//   v2 / delta      wire v2 key records only / with delta records (default: delta)
+//   udp             datagrams instead of TCP; always v2 key records
+//   osc-namespace   the host was started with osc-namespace (one port, /headset/<n>)
+//   no-osc          do not listen for OSC (host on another machine, or a real consumer on 9000)
+//   host-pid <pid>  sample the host process' CPU time from /proc
+
+#define OSC_BASE_PORT 9000
+#define MATCH_HISTORY 64
+#define MAX_BACKLOG 4096
+
+struct LoadGenConfig
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 54000;
+    int clients = 10;
+    int rateHz = 90;
+    int seconds = 30;
+    int threads = 0;
+    int wire = 3; // 1 legacy, 2 v2 keys, 3 v2 deltas
+    bool udp = false;
+    bool oscNamespace = false;
+    bool listenOsc = true;
+    int hostPid = 0;
+};
+
+// Plausible eye movement: fixations broken by saccades, blinks every few
+// seconds, slow pupil drift, and a little tremor on top of everything.
+class EyeModel
+{
+public:
+    explicit EyeModel(uint32_t seed) : rng(seed)
+    {
+        gazeX = targetX = fromX = Uniform(0.35, 0.65);
+        gazeY = targetY = fromY = Uniform(0.40, 0.60);
+        nextSaccade = Uniform(0.1, 0.4);
+        nextBlink = Uniform(0.5, 4.0);
+        pupilPhase = Uniform(0.0, 6.28);
+    }
+
+    EtData Next(double t)
+    {
+        // Saccades: 30-60 ms eased moves to a new fixation point.
+        if (t >= nextSaccade)
+        {
+            fromX = gazeX;
+            fromY = gazeY;
+            targetX = Clamp(gazeX + Uniform(-0.15, 0.15), 0.25, 0.75);
+            targetY = Clamp(gazeY + Uniform(-0.10, 0.10), 0.30, 0.70);
+            saccadeStart = t;
+            saccadeLength = Uniform(0.03, 0.06);
+            nextSaccade = t + saccadeLength + Uniform(0.2, 0.4);
+        }
+        double s = saccadeLength > 0 ? Clamp((t - saccadeStart) / saccadeLength, 0.0, 1.0) : 1.0;
+        s = s * s * (3 - 2 * s);
+        gazeX = fromX + (targetX - fromX) * s;
+        gazeY = fromY + (targetY - fromY) * s;
+
+        // Blinks: fast close, slower reopen.
+        if (t >= nextBlink)
+        {
+            blinkStart = t;
+            blinkLength = Uniform(0.15, 0.3);
+            nextBlink = t + blinkLength + -std::log(Uniform(0.01, 1.0)) * 4.0;
+        }
+        double closed = 0.0;
+        double b = (t - blinkStart) / blinkLength;
+        if (b >= 0 && b < 1)
+            closed = b < 0.33 ? b / 0.33 : 1.0 - (b - 0.33) / 0.67;
+        double openness = (0.9 + 0.03 * std::sin(t * 0.7)) * (1.0 - closed);
+
+        double pupil = 3.6 + 0.8 * std::sin(t * 0.3 + pupilPhase) + Noise(0.03);
+
+        EtData d;
+        d.leftEyeOpenness = (float)Clamp(openness + Noise(0.005), 0.0, 1.0);
+        d.rightEyeOpenness = (float)Clamp(openness + Noise(0.005), 0.0, 1.0);
+        d.leftEyePupilDilation = (float)(pupil + Noise(0.02));
+        d.rightEyePupilDilation = (float)(pupil + Noise(0.02));
+        d.leftEyeMiddleCanthusUvX = (float)(gazeX - 0.02 + Noise(0.002));
+        d.leftEyeMiddleCanthusUvY = (float)(gazeY + Noise(0.002));
+        d.rightEyeMiddleCanthusUvX = (float)(gazeX + 0.02 + Noise(0.002));
+        d.rightEyeMiddleCanthusUvY = (float)(gazeY + Noise(0.002));
+        return d;
+    }
+
+private:
+    double Uniform(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); }
+    double Noise(double sigma) { return std::normal_distribution<double>(0.0, sigma)(rng); }
+    static double Clamp(double v, double lo, double hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+    std::mt19937 rng;
+    double gazeX, gazeY, fromX, fromY, targetX, targetY;
+    double saccadeStart = 0, saccadeLength = 0, nextSaccade;
+    double blinkStart = -1, blinkLength = 1, nextBlink;
+    double pupilPhase;
+};
+
+// The six values the host puts into its OSC bundle, as the host will see them.
+struct OscValues
+{
+    float v[6];
+
+    bool operator==(const OscValues &o) const { return std::memcmp(v, o.v, sizeof(v)) == 0; }
+};
+
+struct SimHeadset
+{
+    SOCKET sock = INVALID_SOCKET;
+    int wireVersion = ET_WIRE_LEGACY;
+    bool timing = false;
+    EtEncoder encoder;
+    std::unique_ptr<EyeModel> model;
+    int messageId = 0;
+    uint32_t sequence = 0;
+    std::vector<uint8_t> backlog; // bytes a full socket did not take yet
+
+    // Recent samples, for matching OSC bundles back to their send time.
+    std::mutex historyMutex;
+    OscValues history[MATCH_HISTORY];
+    uint64_t historySentNs[MATCH_HISTORY] = {};
+    uint32_t historyNext = 0;
+
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+class LoadGen
+{
+public:
+    explicit LoadGen(const LoadGenConfig &loadConfig) : config(loadConfig) {}
+
+    bool Connect()
+    {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (!ParseIPv4(config.host.c_str(), addr.sin_addr))
+        {
+            std::cerr << "[LOADGEN] Invalid address " << config.host << "\n";
+            return false;
+        }
+
+        for (int i = 0; i < config.clients; ++i)
+        {
+            std::unique_ptr<SimHeadset> headset(new SimHeadset());
+            headset->model.reset(new EyeModel(1234u + i));
+            headset->sock = socket(AF_INET, config.udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+            if (headset->sock == INVALID_SOCKET || connect(headset->sock, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+            {
+                std::cerr << "[LOADGEN] Connection " << i << " failed: " << std::strerror(NetLastError()) << "\n";
+                return false;
+            }
+
+            if (config.udp)
+            {
+                headset->wireVersion = ET_WIRE_V2;
+            }
+            else if (config.wire >= ET_WIRE_V2)
+            {
+                Negotiate(*headset);
+            }
+            SetNonBlocking(headset->sock);
+            headsets.push_back(std::move(headset));
+        }
+
+        const char *wire = headsets[0]->wireVersion == ET_WIRE_LEGACY ? "legacy" : (config.wire == 3 && !config.udp ? "v2+delta" : "v2");
+        std::cout << "[LOADGEN] " << headsets.size() << " headsets connected to " << config.host << ":" << config.port
+                  << " over " << (config.udp ? "UDP" : "TCP") << ", wire " << wire << ", " << config.rateHz << " Hz each\n";
+        return true;
+    }
+
+    void Run()
+    {
+        int threadCount = config.threads > 0 ? config.threads : (int)std::thread::hardware_concurrency();
+        if (threadCount < 1)
+            threadCount = 1;
+        if (threadCount > (int)headsets.size())
+            threadCount = (int)headsets.size();
+
+        running = true;
+        std::thread oscThread;
+        if (config.listenOsc && OpenOscPorts())
+            oscThread = std::thread(&LoadGen::OscLoop, this);
+
+        std::vector<std::thread> senders;
+        for (int t = 0; t < threadCount; ++t)
+            senders.emplace_back(&LoadGen::SendLoop, this, t, threadCount);
+
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(config.seconds);
+        auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        auto lastReport = std::chrono::steady_clock::now();
+        CpuClock cpu(config.hostPid);
+        while (std::chrono::steady_clock::now() < end)
+        {
+            std::this_thread::sleep_until(nextReport < end ? nextReport : end);
+            auto now = std::chrono::steady_clock::now();
+            Report(cpu, std::chrono::duration<double>(now - lastReport).count());
+            lastReport = now;
+            nextReport += std::chrono::seconds(5);
+        }
+
+        running = false;
+        for (auto &sender : senders)
+            sender.join();
+        if (oscThread.joinable())
+            oscThread.join();
+        for (auto &headset : headsets)
+            CloseSocket(headset->sock);
+        for (auto &port : oscSockets)
+            CloseSocket(port.sock);
+    }
+
+private:
+    // Host and loadgen CPU time, as a share of one core since the last Sample().
+    class CpuClock
+    {
+    public:
+        explicit CpuClock(int pid) : hostPid(pid) { Sample(hostSeconds, selfSeconds, wall); }
+
+        void Sample(double &hostShare, double &selfShare)
+        {
+            double host, self, now;
+            Sample(host, self, now);
+            double elapsed = now - wall;
+            hostShare = elapsed > 0 ? (host - hostSeconds) / elapsed : 0;
+            selfShare = elapsed > 0 ? (self - selfSeconds) / elapsed : 0;
+            hostSeconds = host;
+            selfSeconds = self;
+            wall = now;
+        }
+
+        bool HasHost() const { return hostPid > 0; }
+
+    private:
+        void Sample(double &host, double &self, double &now)
+        {
+            now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            self = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+            host = 0;
+            if (hostPid <= 0)
+                return;
+            char path[64], line[1024];
+            std::snprintf(path, sizeof(path), "/proc/%d/stat", hostPid);
+            FILE *f = std::fopen(path, "r");
+            if (!f)
+                return;
+            size_t n = std::fread(line, 1, sizeof(line) - 1, f);
+            std::fclose(f);
+            line[n] = '\0';
+            // utime and stime are fields 14 and 15; the command name may hold spaces.
+            const char *fields = std::strrchr(line, ')');
+            unsigned long long utime = 0, stime = 0;
+            if (fields && std::sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) == 2)
+                host = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+        }
+
+        int hostPid;
+        double hostSeconds = 0, selfSeconds = 0, wall = 0;
+    };
+
+    struct OscPort
+    {
+        SOCKET sock;
+        uint16_t port;
+    };
+
+    // Same exchange as TcpClient::Negotiate, blocking, before the socket goes non-blocking.
+    void Negotiate(SimHeadset &headset)
+    {
+        uint8_t flags = HELLO_TIMING | (config.wire >= 3 ? HELLO_DELTA : 0);
+        HelloPayload hello{ET_WIRE_V2, flags};
+        uint8_t frame[sizeof(FrameHeader) + sizeof(HelloPayload)];
+        size_t length = WriteFrame(frame, sizeof(frame), FRAME_HELLO, &hello, sizeof(hello));
+        send(headset.sock, (const char *)frame, (int)length, 0);
+
+        timeval timeout{0, 500 * 1000};
+        setsockopt(headset.sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        FrameDecoder decoder;
+        FrameHeader hdr;
+        const uint8_t *payload;
+        while (true)
+        {
+            size_t space;
+            uint8_t *dst = decoder.WritePtr(space);
+            int received = recv(headset.sock, (char *)dst, (int)space, 0);
+            if (received <= 0)
+                return; // no answer: stay on the legacy wire like the headset does
+            decoder.Commit(received);
+            while (decoder.Next(hdr, payload))
+            {
+                if (hdr.type != FRAME_HELLO_ACK || hdr.length < sizeof(HelloPayload))
+                    continue;
+                HelloPayload ack;
+                std::memcpy(&ack, payload, sizeof(ack));
+                headset.wireVersion = ack.version;
+                headset.timing = (ack.flags & HELLO_TIMING) != 0;
+                headset.encoder = EtEncoder((ack.flags & HELLO_DELTA) != 0);
+                return;
+            }
+        }
+    }
+
+    void SendLoop(int thread, int threadCount)
+    {
+        auto period = std::chrono::nanoseconds(1000000000LL / (config.rateHz > 0 ? config.rateHz : 90));
+        // Spread the threads over the period so the host does not see lockstep bursts.
+        auto next = std::chrono::steady_clock::now() + period * thread / threadCount;
+        uint64_t startNs = MonotonicNs();
+        while (running)
+        {
+            std::this_thread::sleep_until(next);
+            next += period;
+            for (size_t i = thread; i < headsets.size(); i += threadCount)
+                SendSample(*headsets[i], startNs);
+        }
+    }
+
+    void SendSample(SimHeadset &headset, uint64_t startNs)
+    {
+        uint64_t now = MonotonicNs();
+        EtSample sample{};
+        sample.time = now;
+        sample.trackingState = 3;
+        sample.captureNs = now;
+        sample.data = headset.model->Next((now - startNs) / 1e9);
+
+        uint8_t out[2 * (sizeof(DatagramHeader) + sizeof(FrameHeader) + sizeof(Message))];
+        size_t length = 0;
+        if (config.udp)
+        {
+            DatagramHeader dh{DATAGRAM_MAGIC, 1, headset.sequence++, now};
+            std::memcpy(out, &dh, sizeof(dh));
+            EtEncoder keys(false);
+            length = sizeof(dh) + keys.Encode(sample, out + sizeof(dh), sizeof(out) - sizeof(dh));
+        }
+        else if (headset.wireVersion >= ET_WIRE_V2)
+        {
+            if (headset.timing)
+            {
+                EtTimingPayload timing{now, 0};
+                length += WriteFrame(out, sizeof(out), FRAME_TIMING, &timing, sizeof(timing));
+            }
+            length += headset.encoder.Encode(sample, out + length, sizeof(out) - length);
+        }
+        else
+        {
+            Message msg{};
+            msg.id = headset.messageId++;
+            msg.etData = sample.data;
+            std::snprintf(msg.text, sizeof(msg.text), "Hello %d", msg.id);
+            length = WriteFrame(out, sizeof(out), FRAME_LEGACY_MESSAGE, &msg, sizeof(msg));
+        }
+
+        if (!Write(headset, out, length))
+            return;
+
+        std::lock_guard<std::mutex> lock(headset.historyMutex);
+        uint32_t slot = headset.historyNext++ % MATCH_HISTORY;
+        headset.history[slot] = Expected(sample.data, headset.wireVersion >= ET_WIRE_V2);
+        headset.historySentNs[slot] = now;
+    }
+
+    // Sends what the socket takes and keeps a TCP remainder so framing stays
+    // intact. Returns false when the sample was dropped instead.
+    bool Write(SimHeadset &headset, const uint8_t *data, size_t length)
+    {
+        if (config.udp)
+        {
+            if (send(headset.sock, (const char *)data, (int)length, 0) < 0)
+            {
+                ++headset.dropped;
+                return false;
+            }
+            ++headset.sent;
+            return true;
+        }
+
+        size_t written = 0;
+        if (!headset.backlog.empty())
+        {
+            int n = send(headset.sock, (const char *)headset.backlog.data(), (int)headset.backlog.size(), MSG_NOSIGNAL);
+            if (n > 0)
+                headset.backlog.erase(headset.backlog.begin(), headset.backlog.begin() + n);
+        }
+        if (headset.backlog.empty())
+        {
+            int n = send(headset.sock, (const char *)data, (int)length, MSG_NOSIGNAL);
+            if (n < 0 && !NetWouldBlock())
+            {
+                ++headset.dropped;
+                return false;
+            }
+            written = n > 0 ? (size_t)n : 0;
+        }
+
+        if (written < length)
+        {
+            ++headset.stalls;
+            if (headset.backlog.size() + (length - written) > MAX_BACKLOG)
+            {
+                ++headset.dropped;
+                return false;
+            }
+            headset.backlog.insert(headset.backlog.end(), data + written, data + length);
+        }
+        ++headset.sent;
+        return true;
+    }
+
+    static OscValues Expected(const EtData &d, bool quantized)
+    {
+        const float raw[6] = {d.leftEyeOpenness, d.rightEyeOpenness,
+                              d.leftEyeMiddleCanthusUvX, d.leftEyeMiddleCanthusUvY,
+                              d.rightEyeMiddleCanthusUvX, d.rightEyeMiddleCanthusUvY};
+        const int channel[6] = {0, 1, 4, 5, 6, 7};
+        OscValues values;
+        for (int i = 0; i < 6; ++i)
+            values.v[i] = quantized ? DequantizeChannel(QuantizeChannel(raw[i], channel[i]), channel[i]) : raw[i];
+        // The default OSC map sends how closed the eyes are.
+        values.v[0] = 1.0f - values.v[0];
+        values.v[1] = 1.0f - values.v[1];
+        return values;
+    }
+
+    bool OpenOscPorts()
+    {
+        int count = config.oscNamespace ? 1 : config.clients;
+        for (int i = 0; i < count; ++i)
+        {
+            SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons((uint16_t)(OSC_BASE_PORT + i));
+            ParseIPv4("127.0.0.1", addr.sin_addr);
+            if (sock == INVALID_SOCKET || bind(sock, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+            {
+                std::cerr << "[LOADGEN] Cannot listen on OSC port " << OSC_BASE_PORT + i << ", not measuring OSC latency\n";
+                if (sock != INVALID_SOCKET)
+                    CloseSocket(sock);
+                for (auto &port : oscSockets)
+                    CloseSocket(port.sock);
+                oscSockets.clear();
+                return false;
+            }
+            SetNonBlocking(sock);
+            oscSockets.push_back(OscPort{sock, (uint16_t)(OSC_BASE_PORT + i)});
+        }
+        return true;
+    }
+
+    void OscLoop()
+    {
+        Poller poller;
+        for (auto &port : oscSockets)
+            poller.Add(port.sock, &port);
+
+        PollEvent events[64];
+        uint8_t buffer[2048];
+        while (running)
+        {
+            int n = poller.Wait(events, 64, 50);
+            for (int i = 0; i < n; ++i)
+            {
+                OscPort &port = *(OscPort *)events[i].user;
+                int received;
+                while ((received = recv(port.sock, (char *)buffer, sizeof(buffer), 0)) > 0)
+                    HandleBundle(port.port, buffer, (size_t)received, MonotonicNs());
+            }
+        }
+    }
+
+    static uint32_t ReadBe32(const uint8_t *p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+
+    // Pulls the floats out of a host bundle and finds the sample they came from.
+    void HandleBundle(uint16_t port, const uint8_t *data, size_t length, uint64_t now)
+    {
+        if (length < 16 || std::memcmp(data, "#bundle", 8) != 0)
+            return;
+
+        OscValues values;
+        int count = 0;
+        int stream = port - OSC_BASE_PORT;
+        size_t at = 16;
+        while (at + 4 <= length && count < 6)
+        {
+            size_t size = ReadBe32(data + at);
+            const uint8_t *msg = data + at + 4;
+            at += 4 + size;
+            if (at > length)
+                return;
+
+            const char *address = (const char *)msg;
+            size_t addressLen = strnlen(address, size);
+            if (config.oscNamespace && std::strncmp(address, "/headset/", 9) == 0)
+                stream = std::atoi(address + 9);
+            size_t tagsAt = (addressLen + 4) & ~(size_t)3;
+            if (tagsAt >= size)
+                return;
+            const char *tags = (const char *)msg + tagsAt;
+            size_t tagLen = strnlen(tags, size - tagsAt);
+            size_t argsAt = tagsAt + ((tagLen + 4) & ~(size_t)3);
+            for (size_t t = 1; t < tagLen && count < 6 && argsAt + 4 <= size; ++t, argsAt += 4)
+            {
+                uint32_t bits = ReadBe32(msg + argsAt);
+                std::memcpy(&values.v[count++], &bits, sizeof(float));
+            }
+        }
+        if (count != 6)
+            return;
+
+        ++bundles;
+        SimHeadset *headset = Owner(stream, values);
+        if (!headset)
+        {
+            ++unmatched;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(headset->historyMutex);
+        for (uint32_t back = 1; back <= MATCH_HISTORY && back <= headset->historyNext; ++back)
+        {
+            uint32_t slot = (headset->historyNext - back) % MATCH_HISTORY;
+            if (headset->history[slot] == values)
+            {
+                std::lock_guard<std::mutex> oscLock(oscMutex);
+                sendToOsc.Record((int64_t)(now - headset->historySentNs[slot]));
+                return;
+            }
+        }
+        ++unmatched;
+    }
+
+    // The host numbers streams in the order its workers pick connections up, so
+    // the first bundle of each stream is matched against every headset.
+    SimHeadset *Owner(int stream, const OscValues &values)
+    {
+        auto found = owners.find(stream);
+        if (found != owners.end())
+            return found->second;
+
+        for (auto &headset : headsets)
+        {
+            std::lock_guard<std::mutex> lock(headset->historyMutex);
+            for (uint32_t slot = 0; slot < MATCH_HISTORY && slot < headset->historyNext; ++slot)
+            {
+                if (headset->history[slot] == values)
+                {
+                    owners[stream] = headset.get();
+                    return headset.get();
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void Report(CpuClock &cpu, double seconds)
+    {
+        uint64_t sent = 0, stalls = 0, dropped = 0;
+        for (auto &headset : headsets)
+        {
+            sent += headset->sent.exchange(0);
+            stalls += headset->stalls.exchange(0);
+            dropped += headset->dropped.exchange(0);
+        }
+        double hostShare, selfShare;
+        cpu.Sample(hostShare, selfShare);
+        size_t streams = headsets.size() ? headsets.size() : 1;
+
+        std::printf("[LOADGEN] sent %.0f samples/s (%.1f per stream), %llu stalls, %llu dropped, loadgen CPU %.1f%%\n",
+                    sent / seconds, sent / seconds / streams, (unsigned long long)stalls, (unsigned long long)dropped, selfShare * 100);
+        if (!oscSockets.empty())
+        {
+            char latency[128];
+            {
+                std::lock_guard<std::mutex> lock(oscMutex);
+                FormatLatency(latency, sizeof(latency), "send->OSC", sendToOsc);
+                sendToOsc.Reset();
+            }
+            double bundleRate = bundles.exchange(0) / seconds;
+            std::printf("[LOADGEN] host OSC %.0f bundles/s (%.1f per stream), %llu unmatched, %s\n",
+                        bundleRate, bundleRate / streams, (unsigned long long)unmatched.exchange(0), latency);
+        }
+        if (cpu.HasHost())
+            std::printf("[LOADGEN] host CPU %.1f%% of a core, %.3f%% per stream\n", hostShare * 100, hostShare * 100 / streams);
+        std::fflush(stdout);
+    }
+
+    LoadGenConfig config;
+    std::vector<std::unique_ptr<SimHeadset>> headsets;
+    std::vector<OscPort> oscSockets;
+    std::atomic<bool> running{false};
+
+    // OSC thread only, except sendToOsc which Report() reads under oscMutex.
+    std::mutex oscMutex;
+    LatencyHistogram sendToOsc;
+    std::map<int, SimHeadset *> owners;
+    std::atomic<uint64_t> bundles{0};
+    std::atomic<uint64_t> unmatched{0};
+};
+
+int main(int argc, char **argv)
+{
+    LoadGenConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "host") == 0 && hasValue)
+            config.host = argv[++i];
+        else if (std::strcmp(argv[i], "port") == 0 && hasValue)
+            config.port = (uint16_t)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "clients") == 0 && hasValue)
+            config.clients = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "rate") == 0 && hasValue)
+            config.rateHz = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "seconds") == 0 && hasValue)
+            config.seconds = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "threads") == 0 && hasValue)
+            config.threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "host-pid") == 0 && hasValue)
+            config.hostPid = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "legacy") == 0)
+            config.wire = 1;
+        else if (std::strcmp(argv[i], "v2") == 0)
+            config.wire = 2;
+        else if (std::strcmp(argv[i], "delta") == 0)
+            config.wire = 3;
+        else if (std::strcmp(argv[i], "udp") == 0)
+            config.udp = true;
+        else if (std::strcmp(argv[i], "osc-namespace") == 0)
+            config.oscNamespace = true;
+        else if (std::strcmp(argv[i], "no-osc") == 0)
+            config.listenOsc = false;
+        else
+        {
+            std::cerr << "[LOADGEN] Unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    if (config.clients < 1 || config.rateHz < 1)
+    {
+        std::cerr << "[LOADGEN] Need at least one client and a positive rate\n";
+        return 1;
+    }
+
+    NetStartup();
+    LoadGen loadGen(config);
+    if (!loadGen.Connect())
+        return 1;
+    loadGen.Run();
+    NetCleanup();
+    return 0;
+}
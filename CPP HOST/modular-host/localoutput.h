@@ -0,0 +1,329 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "platform.h"
+#include "shared.cpp"
+#include "seqlock.h"
+#include "poses.h"
+#include "gaze.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef LOCALOUTPUT_H
+#define LOCALOUTPUT_H
+
+// What the host offers consumers on the same machine besides OSC, and all a
+// consumer needs to read it; include this header and nothing else.
+//
+// Shared memory ("TcpHost shm <name>"): one region holding, per stream, the
+// latest sample and a ring of the last LOCAL_OUTPUT_HISTORY samples, each
+// behind a SeqLock. Readers map it read-only with LocalOutputReader and never
+// make a system call per sample; the host never waits for them, and they never
+// wait for long on the host: a value a crashed host left half-written reads
+// as missing after LOCAL_READ_ATTEMPTS tries.
+//
+// Unix domain socket ("TcpHost ipc <path>", not on Windows): consumers bind a
+// datagram socket of their own and send a LocalSubscribe to <path>; from then
+// on every sample arrives as one LocalRecord. A consumer that stops reading
+// loses records instead of slowing the host. Repeating the subscribe every few
+// seconds is harmless and picks up a restarted host.
+//
+// Samples are the host's output after the filter stage, at the rate they
+// arrive. The OSC resampling (resampler.h) does not apply here; the history
+// has what a consumer needs to resample or predict on its own clock.
+//
+// Body and motion-tracker poses (poses.h) only go to shared memory: the latest
+// frame of each source per stream, with no history. At 24 joints a frame is
+// too large for a LocalRecord, and an avatar only ever wants the newest one.
+// The combined gaze ray (gaze.h) is kept the same way.
+
+#define LOCAL_OUTPUT_MAGIC 0x4554534Du // "ETSM"
+#define LOCAL_OUTPUT_VERSION 4
+#define LOCAL_OUTPUT_STREAMS 512      // the host's MAX_OUTPUT_STREAMS
+#define LOCAL_OUTPUT_HISTORY 64       // power of two
+#define LOCAL_READ_ATTEMPTS 1000      // a host write takes well under a microsecond
+
+struct LocalSample
+{
+    uint64_t index;      // position in the stream slot's sample sequence
+    uint64_t sampleTime; // headset XrTime the reading was taken for, 0 for legacy headsets
+    uint64_t hostTime;   // sampleTime on the host's steady_clock, 0 until the host synced to the headset
+    uint64_t receivedNs; // host steady_clock when the sample arrived
+    EtData data;
+};
+
+struct LocalPoses
+{
+    uint64_t receivedNs; // host steady_clock when the frame arrived, 0 while the slot holds none
+    PoseFrame frame;
+};
+
+struct LocalGaze
+{
+    uint64_t receivedNs; // host steady_clock when the ray arrived, 0 while the slot holds none
+    GazeRay ray;
+};
+
+struct alignas(64) LocalStream
+{
+    std::atomic<uint32_t> active;       // 1 while a headset owns the slot
+    std::atomic<uint32_t> reserved;
+    std::atomic<uint64_t> firstIndex;   // index of the current headset's first sample
+    std::atomic<uint64_t> count;        // samples written to the slot so far, over all headsets
+    SeqLock<LocalSample> latest;
+    SeqLock<LocalSample> history[LOCAL_OUTPUT_HISTORY]; // sample i at i % LOCAL_OUTPUT_HISTORY
+    SeqLock<LocalPoses> poses[POSE_SOURCE_COUNT];       // at PoseSourceSlot(source)
+    SeqLock<LocalGaze> gaze;
+};
+
+struct LocalOutputRegion
+{
+    std::atomic<uint32_t> magic; // written last; a reader seeing it may use the rest
+    uint32_t version;
+    uint32_t streamCount;
+    uint32_t historyLength;
+    std::atomic<uint32_t> closed; // set when the host exits; reopen to follow the next one
+    uint32_t reserved[3];
+    LocalStream streams[LOCAL_OUTPUT_STREAMS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the region is shared between processes");
+
+// A named block of memory shared with other processes: shm_open on POSIX
+// (under /<name>), a paging-file backed mapping on Windows (Local\<name>).
+class SharedMapping
+{
+public:
+    ~SharedMapping() { Close(); }
+
+    // Host side: replaces any region left under name and maps it read-write.
+    bool Create(const char *name, size_t regionSize)
+    {
+        return Map(name, regionSize, true);
+    }
+
+    // Consumer side: maps an existing region read-only.
+    bool Open(const char *name, size_t regionSize)
+    {
+        return Map(name, regionSize, false);
+    }
+
+    void Close()
+    {
+        if (data == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(handle);
+        handle = nullptr;
+#else
+        munmap(data, size);
+        if (owner)
+            shm_unlink(path.c_str());
+#endif
+        data = nullptr;
+    }
+
+    void *Data() const { return data; }
+
+private:
+    bool Map(const char *name, size_t regionSize, bool create)
+    {
+        Close();
+        size = regionSize;
+        owner = create;
+#ifdef _WIN32
+        path = std::string("Local\\") + name;
+        if (create)
+            handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+                                        (DWORD)size, path.c_str());
+        else
+            handle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+        if (handle == nullptr)
+            return false;
+        data = MapViewOfFile(handle, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+        if (data == nullptr)
+        {
+            CloseHandle(handle);
+            handle = nullptr;
+            return false;
+        }
+#else
+        path = std::string("/") + name;
+        int fd;
+        if (create)
+        {
+            // Start from a fresh object: readers still mapping a previous host's
+            // region keep that one, and none sees this one half-built.
+            shm_unlink(path.c_str());
+            fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if (fd >= 0 && ftruncate(fd, (off_t)size) != 0)
+            {
+                close(fd);
+                shm_unlink(path.c_str());
+                fd = -1;
+            }
+        }
+        else
+        {
+            fd = shm_open(path.c_str(), O_RDONLY, 0);
+        }
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        void *mapped = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && (size_t)info.st_size >= size)
+            mapped = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            if (create)
+                shm_unlink(path.c_str());
+            return false;
+        }
+        data = mapped;
+#endif
+        return true;
+    }
+
+    void *data = nullptr;
+    size_t size = 0;
+    bool owner = false;
+    std::string path;
+#ifdef _WIN32
+    HANDLE handle = nullptr;
+#endif
+};
+
+// Reads a region the host publishes with "shm <name>". Safe to use from any
+// number of threads and processes at once.
+class LocalOutputReader
+{
+public:
+    // Fails when no host publishes under name, or it runs another layout.
+    bool Open(const char *name)
+    {
+        region = nullptr;
+        if (!mapping.Open(name, sizeof(LocalOutputRegion)))
+            return false;
+        auto *mapped = (const LocalOutputRegion *)mapping.Data();
+        if (mapped->magic.load(std::memory_order_acquire) != LOCAL_OUTPUT_MAGIC ||
+            mapped->version != LOCAL_OUTPUT_VERSION || mapped->streamCount != LOCAL_OUTPUT_STREAMS ||
+            mapped->historyLength != LOCAL_OUTPUT_HISTORY)
+        {
+            mapping.Close();
+            return false;
+        }
+        region = mapped;
+        return true;
+    }
+
+    // True once the host that made the region has exited.
+    bool Closed() const
+    {
+        return region == nullptr || region->closed.load(std::memory_order_acquire) != 0;
+    }
+
+    // Copies the newest sample of a stream. False when no headset owns the
+    // stream or it has not sent anything yet.
+    bool Latest(int stream, LocalSample &out) const
+    {
+        if (region == nullptr || stream < 0 || stream >= LOCAL_OUTPUT_STREAMS)
+            return false;
+        const LocalStream &s = region->streams[stream];
+        if (!s.active.load(std::memory_order_acquire))
+            return false;
+        uint64_t first = s.firstIndex.load(std::memory_order_acquire);
+        return ReadSlot(s.latest, out) && out.index >= first;
+    }
+
+    // Copies up to max of the newest samples of a stream, oldest first, and
+    // returns how many. Samples overwritten during the copy are left out.
+    int History(int stream, LocalSample *out, int max) const
+    {
+        if (region == nullptr || stream < 0 || stream >= LOCAL_OUTPUT_STREAMS || max <= 0)
+            return 0;
+        const LocalStream &s = region->streams[stream];
+        if (!s.active.load(std::memory_order_acquire))
+            return 0;
+        uint64_t first = s.firstIndex.load(std::memory_order_acquire);
+        uint64_t end = s.count.load(std::memory_order_acquire);
+        uint64_t begin = end - first > (uint64_t)max ? end - (uint64_t)max : first;
+        if (end - begin > LOCAL_OUTPUT_HISTORY)
+            begin = end - LOCAL_OUTPUT_HISTORY;
+
+        int copied = 0;
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            if (ReadSlot(s.history[i % LOCAL_OUTPUT_HISTORY], out[copied]) && out[copied].index == i)
+                ++copied;
+        }
+        return copied;
+    }
+
+    // Copies the newest pose frame a stream sent from source (PoseSource).
+    // False when no headset owns the stream or it has not sent that source.
+    bool LatestPoses(int stream, uint8_t source, LocalPoses &out) const
+    {
+        int slot = PoseSourceSlot(source);
+        if (region == nullptr || stream < 0 || stream >= LOCAL_OUTPUT_STREAMS || slot < 0)
+            return false;
+        const LocalStream &s = region->streams[stream];
+        if (!s.active.load(std::memory_order_acquire))
+            return false;
+        return ReadSlot(s.poses[slot], out) && out.receivedNs != 0;
+    }
+
+    // Copies the newest gaze ray of a stream. False when no headset owns the
+    // stream or it has not sent one.
+    bool LatestGaze(int stream, LocalGaze &out) const
+    {
+        if (region == nullptr || stream < 0 || stream >= LOCAL_OUTPUT_STREAMS)
+            return false;
+        const LocalStream &s = region->streams[stream];
+        if (!s.active.load(std::memory_order_acquire))
+            return false;
+        return ReadSlot(s.gaze, out) && out.receivedNs != 0;
+    }
+
+private:
+    // False once the host closed the region, or when a write stays in progress
+    // past LOCAL_READ_ATTEMPTS tries, as it does for good if the host died in it.
+    template <typename T>
+    bool ReadSlot(const SeqLock<T> &lock, T &out) const
+    {
+        return !Closed() && lock.TryRead(out, LOCAL_READ_ATTEMPTS) != 0;
+    }
+
+    SharedMapping mapping;
+    const LocalOutputRegion *region = nullptr;
+};
+
+// Unix domain socket messages.
+#define LOCAL_SOCKET_MAGIC 0x4C45 // "EL" on the wire
+#define LOCAL_SUBSCRIBE 1
+#define LOCAL_UNSUBSCRIBE 2
+
+// Consumer -> host, sent from the consumer's bound socket.
+struct LocalSubscribe
+{
+    uint16_t magic;
+    uint8_t version; // LOCAL_OUTPUT_VERSION
+    uint8_t kind;    // LOCAL_SUBSCRIBE or LOCAL_UNSUBSCRIBE
+};
+
+// Host -> consumer, one datagram per sample.
+struct LocalRecord
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t stream;
+    LocalSample sample;
+};
+
+#endif
@@ -1 +1,2 @@
-g++ -std=c++17 -Wall -o TcpHost.exe osclesstcp.cpp shared.cpp oscserver.cpp -lws2_32
\ No newline at end of file
+g++ -std=c++17 -O3 -Wall -o TcpHost.exe osclesstcp.cpp shared.cpp oscserver.cpp outputstage.cpp sharedmemorysink.cpp socketsink.cpp hostworker.cpp udphost.cpp -lws2_32
+g++ -std=c++17 -O3 -Wall -o EtReplay.exe replay.cpp -lws2_32
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#ifndef OSCENCODER_H
+#define OSCENCODER_H
+
+// OSC 1.0 encoding without per-sample string work. An OscMessageTemplate holds
+// the padded address and type-tag string of one message, built once. The
+// OscBundleWriter then only copies that prefix and appends big-endian
+// arguments, packing several messages into one #bundle datagram.
+
+#define OSC_MAX_PREFIX 128
+#define OSC_MAX_PACKET 1472 // fits a single Ethernet-MTU UDP datagram
+
+inline size_t OscPadded(size_t len) { return (len + 4) & ~(size_t)3; } // includes the NUL
+
+class OscMessageTemplate
+{
+public:
+    // typeTags lists the argument types without the leading comma:
+    // 'f' float32, 'i' int32, 'b' blob, 'T'/'F' bool (no payload).
+    OscMessageTemplate(const char *address, const char *typeTags)
+    {
+        size_t addressLen = std::strlen(address);
+        size_t tagLen = std::strlen(typeTags) + 1;
+        if (OscPadded(addressLen) + OscPadded(tagLen) > OSC_MAX_PREFIX)
+        {
+            addressLen = 0;
+            tagLen = 1;
+            typeTags = "";
+        }
+
+        std::memset(prefix, 0, sizeof(prefix));
+        std::memcpy(prefix, address, addressLen);
+        tagOffset = OscPadded(addressLen);
+        prefix[tagOffset] = ',';
+        std::memcpy(prefix + tagOffset + 1, typeTags, tagLen - 1);
+        length = tagOffset + OscPadded(tagLen);
+        argCount = tagLen - 1;
+    }
+
+    uint8_t prefix[OSC_MAX_PREFIX];
+    size_t length;
+    size_t tagOffset; // position of ',' inside prefix
+    size_t argCount;
+};
+
+// Seconds since 1900 in 32.32 fixed point. 1 means "immediately".
+inline uint64_t OscTimeTagNow()
+{
+    using namespace std::chrono;
+    const uint64_t ntpEpochOffset = 2208988800ULL;
+    uint64_t ns = (uint64_t)duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+    uint64_t seconds = ns / 1000000000ULL + ntpEpochOffset;
+    uint64_t fraction = ((ns % 1000000000ULL) << 32) / 1000000000ULL;
+    return (seconds << 32) | fraction;
+}
+
+class OscBundleWriter
+{
+public:
+    void Begin(uint64_t timeTag)
+    {
+        static const char header[8] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', '\0'};
+        size = 0;
+        overflow = false;
+        Put(header, sizeof(header));
+        PutU32((uint32_t)(timeTag >> 32));
+        PutU32((uint32_t)timeTag);
+    }
+
+    void BeginMessage(const OscMessageTemplate &tmpl)
+    {
+        sizeOffset = size;
+        PutU32(0); // element size, patched in EndMessage
+        tagOffset = size + tmpl.tagOffset;
+        argIndex = 0;
+        Put(tmpl.prefix, tmpl.length);
+    }
+
+    void Float(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        PutU32(bits);
+        ++argIndex;
+    }
+
+    void Int(int32_t value)
+    {
+        PutU32((uint32_t)value);
+        ++argIndex;
+    }
+
+    // Bools live entirely in the type tag, so the template's 'T'/'F' is patched.
+    void Bool(bool value)
+    {
+        if (!overflow)
+            buffer[tagOffset + 1 + argIndex] = value ? 'T' : 'F';
+        ++argIndex;
+    }
+
+    void Blob(const void *data, uint32_t len)
+    {
+        static const uint8_t zeros[4] = {};
+        PutU32(len);
+        Put(data, len);
+        Put(zeros, (4 - (len & 3)) & 3);
+        ++argIndex;
+    }
+
+    void EndMessage()
+    {
+        if (overflow)
+            return;
+        uint32_t elementSize = (uint32_t)(size - sizeOffset - 4);
+        for (int i = 0; i < 4; ++i)
+            buffer[sizeOffset + i] = (uint8_t)(elementSize >> (24 - 8 * i));
+    }
+
+    const uint8_t *Data() const { return buffer; }
+    size_t Size() const { return overflow ? 0 : size; }
+    // Bytes a message may still take: 4 for its size, the template, 4 per argument.
+    size_t Space() const { return overflow ? 0 : sizeof(buffer) - size; }
+
+private:
+    void Put(const void *data, size_t len)
+    {
+        if (overflow || size + len > sizeof(buffer))
+        {
+            overflow = true;
+            return;
+        }
+        std::memcpy(buffer + size, data, len);
+        size += len;
+    }
+
+    void PutU32(uint32_t value)
+    {
+        uint8_t be[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+        Put(be, 4);
+    }
+
+    uint8_t buffer[OSC_MAX_PACKET];
+    size_t size = 0;
+    size_t sizeOffset = 0;
+    size_t tagOffset = 0;
+    size_t argIndex = 0;
+    bool overflow = false;
+};
+
+#endif
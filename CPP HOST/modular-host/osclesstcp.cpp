@@ -1,28 +1,44 @@
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include <chrono>
 #include <iostream>
 #include <thread>
+#include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <vector>
+#include "platform.h"
 #include "shared.cpp"
-
-#pragma comment(lib, "ws2_32.lib")
+#include "framing.h"
+#include "etcodec.h"
+#include "control.h"
+#include "outputstage.cpp"
+#include "hostworker.cpp"
+#include "udphost.cpp"
+#include "recording.h"
+#include "discoveryresponder.cpp"
+#include "lifecycle.h"
 
 #define PORT 9000
 #define BUFFER_SIZE 1024
 
+// Accepts headset connections and spreads them over a small pool of
+// HostWorkers, each multiplexing its share with epoll (WSAPoll on Windows).
+// Everything runs until stop is requested; Stop() then drains and joins.
 class TcpHost
 {
 public:
-    TcpHost() : listenSocket(INVALID_SOCKET), clientSocket(INVALID_SOCKET) {}
-
+    explicit TcpHost(StopToken &stopToken) : listenSocket(INVALID_SOCKET), stop(stopToken) {}
 
-    bool Start(uint16_t port = 54000)
+    bool Start(uint16_t port = 54000, int workerCount = 0)
     {
-        WSADATA wsaData;
-        int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-        if (result != 0)
+        if (!NetStartup())
+        {
+            std::cerr << "[SERVER] Network startup failed: " << NetLastError() << "\n";
+            return false;
+        }
+        if (!stop.Open())
         {
-            std::cerr << "[SERVER] WSAStartup failed: " << result << "\n";
+            std::cerr << "[SERVER] Cannot create the stop socket\n";
+            NetCleanup();
             return false;
         }
 
@@ -30,7 +46,8 @@ public:
         if (listenSocket == INVALID_SOCKET)
         {
             std::cerr << "[SERVER] Socket creation failed\n";
-            WSACleanup();
+            stop.Close();
+            NetCleanup();
             return false;
         }
 
@@ -39,115 +56,286 @@ public:
         serverAddr.sin_addr.s_addr = INADDR_ANY; // Listen on all interfaces
         serverAddr.sin_port = htons(port);
 
+        SetReusePort(listenSocket);
         if (bind(listenSocket, (sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
         {
             std::cerr << "[SERVER] Bind failed\n";
-            closesocket(listenSocket);
-            WSACleanup();
+            CloseSocket(listenSocket);
+            stop.Close();
+            NetCleanup();
             return false;
         }
 
         if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
         {
             std::cerr << "[SERVER] Listen failed\n";
-            closesocket(listenSocket);
-            WSACleanup();
+            CloseSocket(listenSocket);
+            stop.Close();
+            NetCleanup();
             return false;
         }
+        SetNonBlocking(listenSocket);
 
-        std::cout << "[SERVER] Listening on port " << port << "...\n";
+        if (workerCount <= 0)
+        {
+            workerCount = (int)std::thread::hardware_concurrency();
+            workerCount = workerCount < 1 ? 1 : (workerCount > 4 ? 4 : workerCount);
+        }
+        for (int i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back(new HostWorker(i, output, recorder, stop));
+            workers.back()->Start();
+        }
+
+        std::cout << "[SERVER] Listening on port " << port << " with " << workerCount << " workers...\n";
         return true;
     }
 
+    // Accepts until stop is requested; a failing listen socket requests it.
     void AcceptClient()
     {
-        while (true)
+        SOCKET wake = stop.WakeSocket();
+        int highest = (int)(wake > listenSocket ? wake : listenSocket);
+        while (!stop.Requested())
         {
-            clientSocket = accept(listenSocket, nullptr, nullptr);
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(listenSocket, &readable);
+            FD_SET(wake, &readable);
+            if (select(highest + 1, &readable, nullptr, nullptr, nullptr) < 0 && !NetWouldBlock())
+                break;
+            if (!FD_ISSET(listenSocket, &readable))
+                continue;
+
+            SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
             if (clientSocket == INVALID_SOCKET)
             {
+                if (NetWouldBlock())
+                    continue; // the client gave up before we got to it
                 std::cerr << "[SERVER] Accept failed\n";
-                closesocket(listenSocket);
-                WSACleanup();
-                return;
+                break;
             }
-            std::cout << "[SERVER] Client connected!\n";
+            SetNonBlocking(clientSocket);
 
-            std::thread(&TcpHost::HandleClient, this).detach();
+            // Hand the connection to the least busy worker.
+            HostWorker *target = workers[0].get();
+            for (auto &worker : workers)
+            {
+                if (worker->ConnectionCount() < target->ConnectionCount())
+                    target = worker.get();
+            }
+            target->Adopt(clientSocket);
         }
+        stop.Request();
+    }
+
+    // Also writes every decoded sample to recorder; call before Start().
+    void RecordTo(Recorder *sampleRecorder)
+    {
+        recorder = sampleRecorder;
     }
 
+    bool StartOutput(const OutputOptions &options = OutputOptions())
+    {
+        return output.Start(options);
+    }
+
+    // Sends a control request to the headset on stream, or to every headset
+    // when stream is -1. The answers show up in the log.
+    void Control(int stream, const ControlPayload &request)
+    {
+        for (auto &worker : workers)
+            worker->Control(stream, request);
+    }
+
+    // Call once AcceptClient() has returned. Lets the workers drain what they
+    // have received, then stops the sinks, so nothing is published after a
+    // sink stopped.
     void Stop()
     {
-        if (clientSocket != INVALID_SOCKET)
-        {
-            closesocket(clientSocket);
-        }
+        auto started = std::chrono::steady_clock::now();
+        stop.Request();
         if (listenSocket != INVALID_SOCKET)
         {
-            closesocket(listenSocket);
+            CloseSocket(listenSocket);
+            listenSocket = INVALID_SOCKET;
         }
+        for (auto &worker : workers)
+            worker->Stop();
+        output.Stop();
+        stop.Close();
 
-        WSACleanup();
-        std::cout << "[SERVER] Stopped.\n";
+        NetCleanup();
+        std::cout << "[SERVER] Stopped in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count()
+                  << " ms.\n";
     }
 
 private:
-    void HandleClient()
-    {
-        Message msg{};
-        while (true)
-        {
-            int bytesReceived = recv(clientSocket, (char *)&msg, sizeof(msg), 0);
-            if (bytesReceived <= 0)
-            {
-                std::cout << "[SERVER] Client disconnected.\n";
-                break;
-            }
+    SOCKET listenSocket;
+    StopToken &stop;
+    OutputStage output;
+    Recorder *recorder = nullptr;
+    std::vector<std::unique_ptr<HostWorker>> workers;
+};
 
-            if (msg.etData.leftEyeMiddleCanthusUvX == 0 && msg.etData.leftEyeMiddleCanthusUvY == 0 && msg.etData.leftEyeOpenness == 0 && msg.etData.leftEyePupilDilation == 0
-                && msg.etData.rightEyeMiddleCanthusUvX == 0 && msg.etData.rightEyeMiddleCanthusUvY == 0 && msg.etData.rightEyeOpenness == 0 && msg.etData.rightEyePupilDilation == 0)
-                continue;
+// One operator command from stdin, see main. Returns false when line is not one.
+//   rate <stream|all> <hz>
+//   channels <stream|all> <mask|left|right|all>
+//   sync <stream|all>
+//   recalibrate <stream|all>
+static bool ParseControl(const std::string &line, int &stream, ControlPayload &request)
+{
+    char command[16] = "", target[16] = "", value[16] = "";
+    int words = std::sscanf(line.c_str(), "%15s %15s %15s", command, target, value);
+    if (words < 2)
+        return false;
+    stream = std::strcmp(target, "all") == 0 ? -1 : std::atoi(target);
 
-            SendOscData(msg.etData);
+    request = ControlPayload{};
+    if (std::strcmp(command, "rate") == 0 && words == 3)
+    {
+        request.command = CONTROL_SET_RATE;
+        request.value = (uint32_t)std::atoi(value);
+    }
+    else if (std::strcmp(command, "channels") == 0 && words == 3)
+    {
+        request.command = CONTROL_SET_CHANNELS;
+        if (std::strcmp(value, "left") == 0)
+            request.value = CONTROL_LEFT_CHANNELS;
+        else if (std::strcmp(value, "right") == 0)
+            request.value = CONTROL_RIGHT_CHANNELS;
+        else if (std::strcmp(value, "all") == 0)
+            request.value = CONTROL_ALL_CHANNELS;
+        else
+            request.value = (uint32_t)std::strtoul(value, nullptr, 0) & CONTROL_ALL_CHANNELS;
+    }
+    else if (std::strcmp(command, "sync") == 0)
+        request.command = CONTROL_TIME_SYNC;
+    else if (std::strcmp(command, "recalibrate") == 0)
+        request.command = CONTROL_RECALIBRATE;
+    else
+        return false;
+    return true;
+}
 
-            // std::cout << "[SERVER] Received: ID=" << msg.id
-            //         //   << " Value=" << msg.value
-            //         //   << " Text=" << msg.text
-            //           << " Left: " << msg.etData.leftEyeMiddleCanthusUvX << ":" << msg.etData.leftEyeMiddleCanthusUvY << ":" << msg.etData.leftEyeOpenness << ":" << msg.etData.leftEyePupilDilation
-            //           << " Right: " << msg.etData.rightEyeMiddleCanthusUvX << ":" << msg.etData.rightEyeMiddleCanthusUvY << ":" << msg.etData.rightEyeOpenness << ":" << msg.etData.rightEyePupilDilation
-            //           << "\n";
+// Example main for testing.
+//   udp             receive over UDP instead of TCP
+//   busy-poll       with udp: busy-poll the socket for 50us (Linux only)
+//   port <n>        receive headsets on port n (default 54000)
+//   record <file>   also write every received sample to <file> (see recording.h)
+//   no-discovery    do not answer discovery probes (see discovery.h)
+//   plus, while a TCP host runs, the stdin commands of ParseControl, sent to
+//   headsets that take control requests (see control.h), and "quit"
+// Ctrl+C, SIGTERM and "quit" all stop the host the same way (see lifecycle.h):
+// received samples are drained to the outputs, the recording is sealed and
+// every thread is joined.
+//   plus the output options of ParseOutputOption (outputstage.cpp): no-osc, shm, ipc,
+//   filter, median, no-blink-hold, osc-namespace, osc-host, osc-port, osc-rate,
+//   resample, resample-delay
+int main(int argc, char **argv)
+{
+    CatchStopSignals();
+    StopToken &stop = HostStop();
 
-            // std::cout << msg.etData.leftEyeMiddleCanthusUvX << "," << msg.etData.leftEyeMiddleCanthusUvY << "," << msg.etData.leftEyeOpenness << "," << msg.etData.leftEyePupilDilation << ","
-            //           << msg.etData.rightEyeMiddleCanthusUvX << "," << msg.etData.rightEyeMiddleCanthusUvY << "," << msg.etData.rightEyeOpenness << "," << msg.etData.rightEyePupilDilation
-            //           << "\n";
+    bool udp = false;
+    int busyPollUs = 0;
+    uint16_t port = 54000;
+    bool discovery = true;
+    const char *recordPath = nullptr;
+    OutputOptions outputOptions;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "udp") == 0)
+            udp = true;
+        else if (std::strcmp(argv[i], "busy-poll") == 0)
+            busyPollUs = 50;
+        else if (std::strcmp(argv[i], "port") == 0 && i + 1 < argc)
+            port = (uint16_t)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "no-discovery") == 0)
+            discovery = false;
+        else if (ParseOutputOption(argc, argv, i, outputOptions))
+            continue;
+        else if (std::strcmp(argv[i], "record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+    }
+
+    Recorder recorder;
+    if (recordPath)
+    {
+        if (!recorder.Open(recordPath))
+        {
+            std::cerr << "[SERVER] Cannot open recording " << recordPath << "\n";
+            return 1;
         }
-        closesocket(clientSocket);
+        std::cout << "[SERVER] Recording to " << recordPath << "\n";
     }
 
-    SOCKET listenSocket;
-    SOCKET clientSocket;
-    SOCKET oscSocket;
-    sockaddr_in target;
-};
+    DiscoveryResponder responder(stop);
+    if (udp)
+    {
+        UdpHost server(stop);
+        if (recordPath)
+            server.RecordTo(&recorder);
+        if (!server.Start(port, busyPollUs))
+            return 1;
+        if (!server.StartOutput(outputOptions))
+        {
+            server.Stop();
+            return 1;
+        }
+        if (discovery)
+            responder.Start(port, true);
 
-// Example main for testing
-int main()
-{
-    TcpHost server;
-    if (!server.Start())
+        DeliverStopSignals();
+        server.Receive();
+        responder.Stop();
+        server.Stop();
+        recorder.Close();
+        return 0;
+    }
+
+    TcpHost server(stop);
+    if (recordPath)
+        server.RecordTo(&recorder);
+    if (!server.Start(port))
+        return 1;
+    if (!server.StartOutput(outputOptions))
+    {
+        server.Stop(); // joins the workers
         return 1;
+    }
+    if (discovery)
+        responder.Start(port, false);
 
-    server.StartOscSocket();
-    server.AcceptClient();
+    // Accepting gets its own thread so stdin stays free for operator commands.
+    std::thread acceptThread(&TcpHost::AcceptClient, &server);
+    DeliverStopSignals();
 
-    // Keep running until user stops it
     std::string cmd;
-    while (cmd != "quit")
+    while (!stop.Requested())
     {
-        std::getline(std::cin, cmd);
+        if (!std::getline(std::cin, cmd))
+        {
+            // A stop signal interrupted the read, or there is no console (e.g.
+            // started in the background): serve until stopped.
+            stop.Wait(-1);
+            break;
+        }
+        int stream;
+        ControlPayload request;
+        if (cmd == "quit")
+            stop.Request();
+        else if (ParseControl(cmd, stream, request))
+            server.Control(stream, request);
+        else if (!cmd.empty())
+            std::cout << "[SERVER] Commands: rate <stream|all> <hz>, channels <stream|all> <mask|left|right|all>,\n"
+                         "[SERVER]           sync <stream|all>, recalibrate <stream|all>, quit\n";
     }
 
+    acceptThread.join();
+    responder.Stop();
     server.Stop();
+    recorder.Close();
     return 0;
-}
\ No newline at end of file
+}
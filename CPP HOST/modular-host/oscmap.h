@@ -0,0 +1,264 @@
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "shared.cpp"
+#include "oscencoder.h"
+
+#ifndef OSCMAP_H
+#define OSCMAP_H
+
+// Which OSC messages the OSC sink sends, and how each argument is derived
+// from the eye channels. A table is text, one argument per line:
+//
+//   <address> <channel> [invert] [scale <f>] [offset <f>] [clamp <lo> <hi>]
+//                       [curve linear|smoothstep|pow <g>]
+//
+// Lines naming the same address add arguments to one message, in order. The
+// channels are left-openness, right-openness, left-pupil, right-pupil,
+// left-uv-x, left-uv-y, right-uv-x and right-uv-y. Whatever order the
+// modifiers are written in, they apply as invert (1 - v), scale, offset,
+// clamp, curve; "pow" keeps the sign, so it also shapes -1..1 ranges. '#'
+// starts a comment.
+//
+// Load compiles the table into one flat array of OscMapOps, with invert,
+// scale and offset folded into a single multiply-add, so evaluating a sample
+// is a loop over that array with no allocation.
+
+#define OSC_MAP_MAX_ARGS 64
+#define OSC_MAP_MAX_ADDRESS 96 // leaves room for the /headset/<n> prefix
+#define OSC_MAP_PREFIX_ROOM 12 // strlen("/headset/511")
+
+// What the host sent before tables existed, with the closed amount inverted:
+// the headset reports how open each eye is.
+static const char *const DEFAULT_OSC_MAP =
+    "/tracking/eye/EyesClosedAmount left-openness invert\n"
+    "/tracking/eye/EyesClosedAmount right-openness invert\n"
+    "/tracking/eye/LeftRightVec left-uv-x\n"
+    "/tracking/eye/LeftRightVec left-uv-y\n"
+    "/tracking/eye/LeftRightVec right-uv-x\n"
+    "/tracking/eye/LeftRightVec right-uv-y\n";
+
+enum class OscCurve : uint8_t
+{
+    Linear,
+    Smoothstep,
+    Power,
+};
+
+struct OscMapOp
+{
+    uint8_t channel; // float index into EtData
+    OscCurve curve;
+    float scale;
+    float offset;
+    float low;
+    float high;
+    float exponent;
+};
+
+struct OscMapMessage
+{
+    std::string address;
+    uint32_t firstOp;
+    uint32_t opCount;
+};
+
+class OscMap
+{
+public:
+    OscMap() { Parse(DEFAULT_OSC_MAP, "built-in map"); }
+
+    // Replaces the table with the one in path. On an error the table is left
+    // as it was and the reason is printed.
+    bool Load(const char *path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cerr << "[OSC] Cannot read OSC map " << path << "\n";
+            return false;
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        return Parse(text.str(), path);
+    }
+
+    bool Parse(const std::string &text, const char *source)
+    {
+        std::vector<OscMapMessage> parsedMessages;
+        std::vector<std::vector<OscMapOp>> perMessage;
+        std::istringstream lines(text);
+        std::string line;
+        for (int number = 1; std::getline(lines, line); ++number)
+        {
+            size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            std::istringstream words(line);
+            std::string address, channel;
+            if (!(words >> address))
+                continue;
+
+            OscMapOp op;
+            std::string error;
+            if (address[0] != '/' || address.size() > OSC_MAP_MAX_ADDRESS)
+                error = "bad address " + address;
+            else if (!(words >> channel) || !ParseChannel(channel, op.channel))
+                error = "unknown channel " + channel;
+            else
+                error = ParseModifiers(words, op);
+            if (error.empty() && ArgumentCount(perMessage) >= OSC_MAP_MAX_ARGS)
+                error = "more than " + std::to_string(OSC_MAP_MAX_ARGS) + " arguments";
+            if (!error.empty())
+            {
+                std::cerr << "[OSC] " << source << " line " << number << ": " << error << "\n";
+                return false;
+            }
+
+            size_t message = 0;
+            while (message < parsedMessages.size() && parsedMessages[message].address != address)
+                ++message;
+            if (message == parsedMessages.size())
+            {
+                parsedMessages.push_back(OscMapMessage{address, 0, 0});
+                perMessage.emplace_back();
+            }
+            perMessage[message].push_back(op);
+        }
+        if (parsedMessages.empty())
+        {
+            std::cerr << "[OSC] " << source << " maps nothing\n";
+            return false;
+        }
+
+        // Everything goes out as one bundle, which must fit a datagram.
+        size_t bundleSize = 16;
+        for (size_t m = 0; m < parsedMessages.size(); ++m)
+            bundleSize += 4 + OscPadded(parsedMessages[m].address.size() + OSC_MAP_PREFIX_ROOM) +
+                          OscPadded(perMessage[m].size() + 1) + 4 * perMessage[m].size();
+        if (bundleSize > OSC_MAX_PACKET)
+        {
+            std::cerr << "[OSC] " << source << " needs " << bundleSize << " bytes per bundle, more than "
+                      << OSC_MAX_PACKET << "\n";
+            return false;
+        }
+
+        ops.clear();
+        for (size_t m = 0; m < parsedMessages.size(); ++m)
+        {
+            parsedMessages[m].firstOp = (uint32_t)ops.size();
+            parsedMessages[m].opCount = (uint32_t)perMessage[m].size();
+            ops.insert(ops.end(), perMessage[m].begin(), perMessage[m].end());
+        }
+        messages = parsedMessages;
+        return true;
+    }
+
+    // Fills out[i] for every op; out must hold OpCount() floats.
+    void Evaluate(const EtData &data, float *out) const
+    {
+        const float *channels = (const float *)&data;
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            const OscMapOp &op = ops[i];
+            float v = channels[op.channel] * op.scale + op.offset;
+            v = v < op.low ? op.low : (v > op.high ? op.high : v);
+            if (op.curve == OscCurve::Smoothstep)
+                v = v * v * (3.0f - 2.0f * v);
+            else if (op.curve == OscCurve::Power)
+                v = std::copysign(std::pow(std::fabs(v), op.exponent), v);
+            out[i] = v;
+        }
+    }
+
+    const std::vector<OscMapMessage> &Messages() const { return messages; }
+    size_t OpCount() const { return ops.size(); }
+
+private:
+    static bool ParseChannel(const std::string &name, uint8_t &channel)
+    {
+        static const char *const names[8] = {"left-openness", "right-openness", "left-pupil", "right-pupil",
+                                             "left-uv-x",     "left-uv-y",      "right-uv-x", "right-uv-y"};
+        for (uint8_t i = 0; i < 8; ++i)
+        {
+            if (name == names[i])
+            {
+                channel = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Reads the modifiers after the channel into op; returns an error or "".
+    static std::string ParseModifiers(std::istringstream &words, OscMapOp &op)
+    {
+        bool invert = false;
+        float scale = 1.0f, offset = 0.0f;
+        op.curve = OscCurve::Linear;
+        op.low = -std::numeric_limits<float>::infinity();
+        op.high = std::numeric_limits<float>::infinity();
+        op.exponent = 1.0f;
+
+        std::string word;
+        while (words >> word)
+        {
+            bool ok = true;
+            if (word == "invert")
+                invert = true;
+            else if (word == "scale")
+                ok = static_cast<bool>(words >> scale);
+            else if (word == "offset")
+                ok = static_cast<bool>(words >> offset);
+            else if (word == "clamp")
+                ok = words >> op.low >> op.high && op.low <= op.high;
+            else if (word == "curve" && words >> word)
+            {
+                if (word == "linear")
+                    op.curve = OscCurve::Linear;
+                else if (word == "smoothstep")
+                    op.curve = OscCurve::Smoothstep;
+                else if (word == "pow")
+                {
+                    op.curve = OscCurve::Power;
+                    ok = words >> op.exponent && op.exponent > 0.0f;
+                }
+                else
+                    return "unknown curve " + word;
+            }
+            else
+                return "unknown modifier " + word;
+            if (!ok)
+                return "bad value for " + word;
+        }
+        // Smoothstep is only defined on 0..1.
+        if (op.curve == OscCurve::Smoothstep)
+        {
+            op.low = op.low > 0.0f ? op.low : 0.0f;
+            op.high = op.high < 1.0f ? op.high : 1.0f;
+        }
+
+        // (invert ? 1 - v : v) * scale + offset as one multiply-add.
+        op.scale = invert ? -scale : scale;
+        op.offset = invert ? scale + offset : offset;
+        return "";
+    }
+
+    static size_t ArgumentCount(const std::vector<std::vector<OscMapOp>> &perMessage)
+    {
+        size_t count = 0;
+        for (const auto &message : perMessage)
+            count += message.size();
+        return count;
+    }
+
+    std::vector<OscMapOp> ops;
+    std::vector<OscMapMessage> messages;
+};
+
+#endif
@@ -1,102 +1,581 @@
-#include <winsock2.h>
-#include <ws2tcpip.h>
 #include <iostream>
 #include <thread>
+#include <cstdlib>
 #include <cstring>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "platform.h"
 #include "shared.cpp"
+#include "seqlock.h"
+#include "oscencoder.h"
+#include "oscmap.h"
+#include "latency.h"
+#include "resampler.h"
+#include "blendshape.h"
+#include "poses.h"
+#include "gaze.h"
+#include "outputsink.h"
 
-#pragma comment(lib, "ws2_32.lib")
+#ifndef OSCSERVER_CPP
+#define OSCSERVER_CPP
 
 #define PORT 9000
-#define BUFFER_SIZE 1024
 
-class OscServer
+// How streams from several headsets are kept apart on the OSC side.
+enum class OscRouting
 {
-public:
-    OscServer() : oscSocket(INVALID_SOCKET) {}
+    PerPort,      // stream n goes to PORT + n with the plain addresses
+    PerNamespace, // every stream goes to PORT, addresses prefixed with /headset/<n>
+};
 
-private:
-    // Helper: pad string to multiple of 4 bytes (OSC requirement)
-    int pad4(char *buffer, const char *str)
+// Where the OSC consumers listen; PORT above is only the default base port.
+struct OscTarget
+{
+    const char *address = "127.0.0.1";
+    uint16_t basePort = PORT;
+};
+
+// Output settings the hosts take from the command line (see ParseOscOption).
+struct OscOptions
+{
+    OscRouting routing = OscRouting::PerPort;
+    OscTarget target;
+    int rateHz = 60;
+    ResampleSettings resample;
+    const char *mapPath = nullptr; // DEFAULT_OSC_MAP when null
+    const char *faceAddress = "/tracking/face"; // face channel <name> goes to <faceAddress>/<name>
+    const char *bodyAddress = "/tracking/body"; // body joint <name> goes to <bodyAddress>/<name>
+    const char *trackerAddress = "/tracking/trackers"; // motion tracker n goes to <trackerAddress>/<n>
+    const char *gazeAddress = "/tracking/gaze"; // the combined gaze ray goes to <gazeAddress>
+};
+
+// Consumes argv[i], and its value, when it is one of the OSC options:
+//   osc-namespace         send every headset to port 9000 under /headset/<n>
+//                         instead of giving headset n port 9000 + n
+//   osc-host <ip>         send OSC to this address instead of 127.0.0.1
+//   osc-port <n>          use n instead of 9000 as the OSC base port
+//   osc-rate <hz>         output ticks per second (default 60)
+//   osc-map <file>        what to send, as a table described in oscmap.h
+//   osc-face <address>    send face channel <name> to <address>/<name> (default /tracking/face)
+//   osc-body <address>    send body joint <name> to <address>/<name> (default /tracking/body)
+//   osc-trackers <address> send motion tracker n to <address>/<n> (default /tracking/trackers)
+//   osc-gaze <address>    send the combined gaze ray to <address> (default /tracking/gaze)
+//   resample <mode>       latest, linear (default) or hermite, see resampler.h
+//   resample-delay <ms>   evaluate that far behind the tick to interpolate more, predict less
+inline bool ParseOscOption(int argc, char **argv, int &i, OscOptions &options)
+{
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "osc-namespace") == 0)
+        options.routing = OscRouting::PerNamespace;
+    else if (std::strcmp(argv[i], "osc-host") == 0 && hasValue)
+        options.target.address = argv[++i];
+    else if (std::strcmp(argv[i], "osc-port") == 0 && hasValue)
+        options.target.basePort = (uint16_t)std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "osc-rate") == 0 && hasValue)
+        options.rateHz = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "osc-map") == 0 && hasValue)
+        options.mapPath = argv[++i];
+    else if (std::strcmp(argv[i], "osc-face") == 0 && hasValue)
+        options.faceAddress = argv[++i];
+    else if (std::strcmp(argv[i], "osc-body") == 0 && hasValue)
+        options.bodyAddress = argv[++i];
+    else if (std::strcmp(argv[i], "osc-trackers") == 0 && hasValue)
+        options.trackerAddress = argv[++i];
+    else if (std::strcmp(argv[i], "osc-gaze") == 0 && hasValue)
+        options.gazeAddress = argv[++i];
+    else if (std::strcmp(argv[i], "resample") == 0 && hasValue)
     {
-        int len = std::strlen(str) + 1;
-        int paddedLen = ((len + 3) / 4) * 4;
-        std::memcpy(buffer, str, len);
-        for (int i = len; i < paddedLen; ++i)
-            buffer[i] = '\0';
-        return paddedLen;
+        if (!ParseResampling(argv[++i], options.resample.mode))
+            std::cerr << "[OSC] Unknown resampling " << argv[i] << ", using linear\n";
     }
+    else if (std::strcmp(argv[i], "resample-delay") == 0 && hasValue)
+        options.resample.delayNs = (int64_t)(std::atof(argv[++i]) * 1e6);
+    else
+        return false;
+    return true;
+}
 
-    // Helper: append float in network byte order (big-endian)
-    int appendFloat(char *buffer, float value)
+// The OSC output sink, one OSC stream per headset. Receivers append each
+// filtered sample to the stream's short history (Publish); a dedicated thread
+// resamples every stream at the output rate (see resampler.h), and sends only
+// when some channel moved by more than the change threshold. What is sent
+// comes from an OscMap. Face and lip tracking is not resampled: each tick
+// sends the newest blendshape frame, one message per channel named in the
+// headset's dictionary, and only the channels that moved; as many bundles as
+// that takes. Poses likewise: each new frame of a source goes out as one
+// message per tracked joint, position then rotation quaternion (x y z w). A
+// new gaze ray goes out as one message: origin, direction, convergence
+// distance (0 when unknown).
+class OscServer : public OutputSink
+{
+public:
+    OscServer() : oscSocket(INVALID_SOCKET), streams(new Stream[MAX_OUTPUT_STREAMS])
     {
-        uint32_t net;
-        std::memcpy(&net, &value, sizeof(float));
-        net = htonl(net); // simple big-endian conversion
-        std::memcpy(buffer, &net, sizeof(float));
-        return sizeof(float);
+        targetAddress.s_addr = htonl(INADDR_LOOPBACK);
+    }
+
+    // Points every stream added afterwards at target. Returns false and keeps
+    // the previous target when the address does not parse.
+    bool SetTarget(const OscTarget &target)
+    {
+        in_addr parsed;
+        if (!ParseIPv4(target.address, parsed))
+        {
+            std::cerr << "[OSC] Invalid target address " << target.address << "\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        targetAddress = parsed;
+        basePort = target.basePort;
+        return true;
     }
 
-    // Send OSC message
-    void sendOSC(SOCKET sock, sockaddr_in &addr, const char *address, float *values, int count)
+    // Returns false when the options name a bad target address or OSC map.
+    bool StartOscSocket(const OscOptions &options, float changeThreshold = 0.001f)
     {
-        char buffer[BUFFER_SIZE];
-        int offset = 0;
+        if (!SetTarget(options.target))
+            return false;
+        if (options.mapPath)
+        {
+            if (!map.Load(options.mapPath))
+                return false;
+            std::cout << "[OSC] Sending " << map.Messages().size() << " messages with " << map.OpCount()
+                      << " arguments from " << options.mapPath << "\n";
+        }
+
+        oscSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (oscSocket == INVALID_SOCKET)
+        {
+            std::cerr << "[OSC] Socket error\n";
+            return false;
+        }
 
-        offset += pad4(buffer + offset, address);
+        routing = options.routing;
+        faceAddress = options.faceAddress;
+        bodyAddress = options.bodyAddress;
+        trackerAddress = options.trackerAddress;
+        gazeAddress = options.gazeAddress;
+        resample = options.resample;
+        period = std::chrono::nanoseconds(1000000000LL / (options.rateHz > 0 ? options.rateHz : 60));
+        threshold = changeThreshold;
+        running = true;
+        outputThread = std::thread(&OscServer::OutputLoop, this);
+        return true;
+    }
 
-        // Type tag string
-        char types[32] = ",";
-        for (int i = 0; i < count; ++i)
-            types[i + 1] = 'f';
-        types[count + 1] = '\0';
-        offset += pad4(buffer + offset, types);
+    void StreamAdded(int id) override
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        Stream &stream = streams[id];
+        char *prefix = stream.prefix;
+        prefix[0] = '\0';
+        stream.target = sockaddr_in{};
+        stream.target.sin_family = AF_INET;
+        stream.target.sin_addr = targetAddress;
+        if (routing == OscRouting::PerPort)
+        {
+            stream.target.sin_port = htons((uint16_t)(basePort + id));
+        }
+        else
+        {
+            stream.target.sin_port = htons(basePort);
+            std::snprintf(prefix, sizeof(stream.prefix), "/headset/%d", id);
+        }
 
-        for (int i = 0; i < count; ++i)
-            offset += appendFloat(buffer + offset, values[i]);
+        stream.messages.clear();
+        for (const OscMapMessage &message : map.Messages())
+        {
+            std::string tags(message.opCount, 'f');
+            stream.messages.emplace_back((prefix + message.address).c_str(), tags.c_str());
+        }
+        stream.lastVersion = stream.latest.Version(); // ignore the previous owner's last sample
+        stream.settled = true;
+        stream.writer.Reset();
+        stream.sentAny = false;
+        stream.faceMessages.clear();
+        stream.faceVersion = stream.face.Version();
+        for (int source = 0; source < POSE_SOURCE_COUNT; ++source)
+        {
+            stream.poseMessages[source].clear();
+            stream.poseVersion[source] = stream.poses[source].Version();
+        }
+        for (int joint = 0; joint < POSE_BODY_JOINTS; ++joint)
+        {
+            std::string address = prefix + bodyAddress + "/" + kPoseBodyJointNames[joint];
+            stream.poseMessages[PoseSourceSlot(POSE_SOURCE_BODY)].emplace_back(address.c_str(), "fffffff");
+        }
+        for (int tracker = 0; tracker < POSE_MAX_TRACKERS; ++tracker)
+        {
+            std::string address = prefix + trackerAddress + "/" + std::to_string(tracker);
+            stream.poseMessages[PoseSourceSlot(POSE_SOURCE_TRACKERS)].emplace_back(address.c_str(), "fffffff");
+        }
+        stream.gazeMessage = OscMessageTemplate((prefix + gazeAddress).c_str(), "fffffff");
+        stream.gazeVersion = stream.gaze.Version();
+        stream.active = true;
+        if (id >= streamCount)
+            streamCount = id + 1;
+    }
 
-        sendto(sock, buffer, offset, 0, (sockaddr *)&addr, sizeof(addr));
+    void StreamRemoved(int id) override
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        streams[id].active = false;
     }
 
-public:
-    void StartOscSocket()
+    // Builds the stream's face messages, <prefix><faceAddress>/<name> per channel.
+    void BlendshapeChannels(int id, const BlendshapeDictionary &dictionary) override
     {
-        oscSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (oscSocket == INVALID_SOCKET)
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        Stream &stream = streams[id];
+        stream.faceMessages.clear();
+        for (int i = 0; i < dictionary.channelCount; ++i)
         {
-            std::cerr << "[OSC] Socket error\n";
+            std::string address = stream.prefix + faceAddress + "/" + dictionary.names[i];
+            stream.faceMessages.emplace_back(address.c_str(), "f");
+        }
+        stream.faceSentAny = false;
+    }
+
+    void PublishBlendshapes(int id, const BlendshapeFrame &frame, uint64_t /*receivedNs*/) override
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
             return;
+        streams[id].face.Write(frame);
+    }
+
+    void PublishPoses(int id, const PoseFrame &frame, uint64_t /*receivedNs*/) override
+    {
+        int slot = PoseSourceSlot(frame.source);
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS || slot < 0)
+            return;
+        streams[id].poses[slot].Write(frame);
+    }
+
+    void PublishGazeRay(int id, const GazeRay &ray, uint64_t /*receivedNs*/) override
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        streams[id].gaze.Write(ray);
+    }
+
+    // Appends a sample to its stream's history; never blocks on the OSC socket.
+    void Publish(int id, const EtData &data, uint64_t sampleTime, uint64_t hostTime, uint64_t receivedNs) override
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        Stream &stream = streams[id];
+        stream.latest.Write(stream.writer.Push(data, sampleTime, hostTime, receivedNs));
+    }
+
+    // Sends one last tick, so samples drained from the receivers still go
+    // out, and joins the output thread.
+    void Stop() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            running = false;
         }
+        stopWake.notify_one();
+        if (outputThread.joinable())
+            outputThread.join();
 
-        target = sockaddr_in{};
-        target.sin_family = AF_INET;
-        target.sin_port = htons(PORT);
-        InetPtonA(AF_INET, "127.0.0.1", &target.sin_addr);
+        if (oscSocket != INVALID_SOCKET)
+        {
+            CloseSocket(oscSocket);
+            oscSocket = INVALID_SOCKET;
+        }
     }
 
-    void SendOscData(EtData etData) {
-        while (true)
+private:
+    struct Stream
+    {
+        SeqLock<SampleHistory> latest;
+        HistoryWriter writer; // owned by the stream's receive thread
+        SeqLock<BlendshapeFrame> face;
+        SeqLock<PoseFrame> poses[POSE_SOURCE_COUNT]; // at PoseSourceSlot(source)
+        SeqLock<GazeRay> gaze;
+        // Everything below is guarded by streamsMutex.
+        bool active = false;
+        bool sentAny = false;
+        bool settled = true; // no new sample and past the extrapolation limit
+        uint32_t lastVersion = 0;
+        EtData last{};
+        sockaddr_in target{};
+        std::vector<OscMessageTemplate> messages; // one per map message, with the stream's prefix
+        char prefix[32] = "";                     // "/headset/<n>" with OscRouting::PerNamespace
+        std::vector<OscMessageTemplate> faceMessages; // one per face channel; none before the dictionary
+        uint32_t faceVersion = 0;
+        bool faceSentAny = false;
+        float faceLast[BLENDSHAPE_MAX_CHANNELS];
+        std::vector<OscMessageTemplate> poseMessages[POSE_SOURCE_COUNT]; // one per joint of the source
+        uint32_t poseVersion[POSE_SOURCE_COUNT] = {};
+        OscMessageTemplate gazeMessage{"", ""};
+        uint32_t gazeVersion = 0;
+    };
+
+    void OutputLoop()
+    {
+        uint64_t bundles = 0, suppressed = 0, interpolated = 0, faceBundles = 0, poseBundles = 0, gazeBundles = 0;
+        auto next = std::chrono::steady_clock::now();
+        auto nextReport = next + std::chrono::seconds(5);
+
+        bool last = false;
+        while (!last)
         {
-            float eyesClosed[2] = {etData.leftEyeOpenness, etData.rightEyeOpenness};
-            float vec[4] = {etData.leftEyeMiddleCanthusUvX, etData.leftEyeMiddleCanthusUvY,
-                            etData.rightEyeMiddleCanthusUvX, etData.rightEyeMiddleCanthusUvY};
+            next += period;
+            {
+                std::unique_lock<std::mutex> lock(stopMutex);
+                last = stopWake.wait_until(lock, next, [this] { return !running; });
+            }
+            if (last)
+                next = std::chrono::steady_clock::now();
+            // Evaluate at the scheduled tick, not the wake-up, so the output keeps a steady clock.
+            uint64_t tickNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch()).count();
+
+            if (next >= nextReport)
+            {
+                char latency[128], horizon[128];
+                FormatLatency(latency, sizeof(latency), "receive->OSC", receiveToOsc);
+                FormatLatency(horizon, sizeof(horizon), "prediction", predictionHorizon);
+                std::cout << "[OSC] " << bundles / 5.0 << " bundles/s, " << suppressed << " unchanged samples suppressed, "
+                          << latency << "\n";
+                if (resample.mode != Resampling::Latest)
+                    std::cout << "[OSC] " << horizon << ", " << interpolated << " interpolated\n";
+                if (faceBundles > 0)
+                    std::cout << "[OSC] " << faceBundles / 5.0 << " face bundles/s\n";
+                if (poseBundles > 0)
+                    std::cout << "[OSC] " << poseBundles / 5.0 << " pose bundles/s\n";
+                if (gazeBundles > 0)
+                    std::cout << "[OSC] " << gazeBundles / 5.0 << " gaze bundles/s\n";
+                bundles = suppressed = interpolated = faceBundles = poseBundles = gazeBundles = 0;
+                receiveToOsc.Reset();
+                predictionHorizon.Reset();
+                nextReport += std::chrono::seconds(5);
+            }
+
+            std::lock_guard<std::mutex> lock(streamsMutex);
+            for (int id = 0; id < streamCount; ++id)
+            {
+                Stream &stream = streams[id];
+                if (!stream.active)
+                    continue;
+                faceBundles += EmitFace(stream);
+                for (int source = 0; source < POSE_SOURCE_COUNT; ++source)
+                    poseBundles += EmitPoses(stream, source);
+                gazeBundles += EmitGaze(stream);
+
+                SampleHistory history;
+                uint32_t version = stream.latest.Read(history);
+                bool fresh = version != stream.lastVersion;
+                if ((!fresh && (resample.mode == Resampling::Latest || stream.settled)) || history.count == 0)
+                    continue;
+                stream.lastVersion = version;
+
+                EtData data;
+                int64_t horizonNs;
+                Resample(history, tickNs - resample.delayNs, resample, data, horizonNs);
+                stream.settled = horizonNs >= resample.maxExtrapolationNs;
+                if (resample.mode != Resampling::Latest)
+                {
+                    if (horizonNs > 0)
+                        predictionHorizon.Record(horizonNs < resample.maxExtrapolationNs ? horizonNs : resample.maxExtrapolationNs);
+                    else
+                        ++interpolated;
+                }
+
+                if (stream.sentAny && !Changed(stream.last, data))
+                {
+                    ++suppressed;
+                    continue;
+                }
 
-            sendOSC(oscSocket, target, "/tracking/eye/EyesClosedAmount", eyesClosed, 2);
-            sendOSC(oscSocket, target, "/tracking/eye/LeftRightVec", vec, 4);
+                Emit(stream, data);
+                if (fresh)
+                    receiveToOsc.Record((int64_t)(MonotonicNs() - history.receivedNs));
+                stream.last = data;
+                stream.sentAny = true;
+                ++bundles;
+            }
         }
+    }
 
+    bool Changed(const EtData &a, const EtData &b) const
+    {
+        const float *pa = (const float *)&a;
+        const float *pb = (const float *)&b;
+        for (size_t i = 0; i < sizeof(EtData) / sizeof(float); ++i)
+        {
+            if (std::fabs(pa[i] - pb[i]) > threshold)
+                return true;
+        }
+        return false;
     }
 
-    void Stop() {
-    if (oscSocket != INVALID_SOCKET) 
+    // One #bundle datagram carries the whole eye state.
+    void Emit(const Stream &stream, const EtData &etData)
+    {
+        map.Evaluate(etData, values);
+        bundle.Begin(OscTimeTagNow());
+        const std::vector<OscMapMessage> &messages = map.Messages();
+        for (size_t m = 0; m < messages.size(); ++m)
         {
-            closesocket(oscSocket);
-        }   
+            bundle.BeginMessage(stream.messages[m]);
+            for (uint32_t i = 0; i < messages[m].opCount; ++i)
+                bundle.Float(values[messages[m].firstOp + i]);
+            bundle.EndMessage();
+        }
+
+        SendBundle(stream);
     }
 
+    // Sends the channels of the stream's newest blendshape frame that moved by
+    // more than the threshold since they were last sent. Returns the number of
+    // bundles that took.
+    int EmitFace(Stream &stream)
+    {
+        if (stream.faceMessages.empty() || stream.face.Version() == stream.faceVersion)
+            return 0;
+        BlendshapeFrame frame;
+        stream.faceVersion = stream.face.Read(frame);
+        size_t count = frame.channelCount < stream.faceMessages.size() ? frame.channelCount : stream.faceMessages.size();
+
+        int sent = 0;
+        size_t inBundle = 0;
+        bundle.Begin(OscTimeTagNow());
+        for (size_t i = 0; i < count; ++i)
+        {
+            float weight = frame.weights[i];
+            if (stream.faceSentAny && std::fabs(weight - stream.faceLast[i]) <= threshold)
+                continue;
+            sent += BeginSplitMessage(stream, stream.faceMessages[i], inBundle);
+            bundle.Float(weight);
+            bundle.EndMessage();
+            stream.faceLast[i] = weight;
+        }
+        sent += EndSplit(stream, inBundle);
+        stream.faceSentAny = true;
+        return sent;
+    }
+
+    // Sends every tracked joint of the stream's newest frame from the source
+    // in slot, when there is one the stream has not sent. Returns the number
+    // of bundles that took.
+    int EmitPoses(Stream &stream, int slot)
+    {
+        const std::vector<OscMessageTemplate> &messages = stream.poseMessages[slot];
+        if (messages.empty() || stream.poses[slot].Version() == stream.poseVersion[slot])
+            return 0;
+        PoseFrame frame;
+        stream.poseVersion[slot] = stream.poses[slot].Read(frame);
+        size_t count = frame.jointCount < messages.size() ? frame.jointCount : messages.size();
+
+        int sent = 0;
+        size_t inBundle = 0;
+        bundle.Begin(OscTimeTagNow());
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!(frame.trackedMask & (1u << i)))
+                continue;
+            const Pose &pose = frame.joints[i];
+            sent += BeginSplitMessage(stream, messages[i], inBundle);
+            for (float value : pose.position)
+                bundle.Float(value);
+            for (float value : pose.rotation)
+                bundle.Float(value);
+            bundle.EndMessage();
+        }
+        return sent + EndSplit(stream, inBundle);
+    }
+
+    // Sends the stream's newest gaze ray, when there is one it has not sent.
+    // Returns the number of bundles that took.
+    int EmitGaze(Stream &stream)
+    {
+        if (stream.gaze.Version() == stream.gazeVersion)
+            return 0;
+        GazeRay ray;
+        stream.gazeVersion = stream.gaze.Read(ray);
+        bundle.Begin(OscTimeTagNow());
+        bundle.BeginMessage(stream.gazeMessage);
+        for (float value : ray.origin)
+            bundle.Float(value);
+        for (float value : ray.direction)
+            bundle.Float(value);
+        bundle.Float(ray.convergence);
+        bundle.EndMessage();
+        SendBundle(stream);
+        return 1;
+    }
+
+    // Begins message in the bundle under way, after sending the bundle and
+    // starting the next when the message and its float arguments would not
+    // fit. Returns the number of bundles sent. inBundle counts the messages in
+    // the bundle under way.
+    int BeginSplitMessage(const Stream &stream, const OscMessageTemplate &message, size_t &inBundle)
+    {
+        int sent = 0;
+        if (inBundle > 0 && bundle.Space() < 4 + message.length + 4 * message.argCount)
+        {
+            SendBundle(stream);
+            sent = 1;
+            inBundle = 0;
+            bundle.Begin(OscTimeTagNow());
+        }
+        bundle.BeginMessage(message);
+        ++inBundle;
+        return sent;
+    }
+
+    // Sends the bundle under way unless it is empty; returns the bundles sent.
+    int EndSplit(const Stream &stream, size_t inBundle)
+    {
+        if (inBundle == 0)
+            return 0;
+        SendBundle(stream);
+        return 1;
+    }
+
+    void SendBundle(const Stream &stream)
+    {
+        sendto(oscSocket, (const char *)bundle.Data(), (int)bundle.Size(), 0, (sockaddr *)&stream.target, sizeof(stream.target));
+    }
 
-private:
     SOCKET oscSocket;
-    sockaddr_in target;
+    OscRouting routing = OscRouting::PerPort;
+    OscBundleWriter bundle;
+    OscMap map;                         // fixed once started
+    float values[OSC_MAP_MAX_ARGS];     // output thread only
+    LatencyHistogram receiveToOsc;      // output thread only
+    LatencyHistogram predictionHorizon; // output thread only
+
+    std::unique_ptr<Stream[]> streams;
+    ResampleSettings resample;
+    std::string faceAddress = "/tracking/face"; // fixed once started, like the three below
+    std::string bodyAddress = "/tracking/body";
+    std::string trackerAddress = "/tracking/trackers";
+    std::string gazeAddress = "/tracking/gaze";
+    int streamCount = 0; // one past the highest slot ever used
+    in_addr targetAddress{}; // guarded by streamsMutex, like basePort
+    uint16_t basePort = PORT;
+    std::mutex streamsMutex;
+    std::thread outputThread;
+    std::atomic<bool> running{false};
+    std::mutex stopMutex; // with stopWake, cuts the tick short on Stop()
+    std::condition_variable stopWake;
+    std::chrono::nanoseconds period{16666667};
+    float threshold = 0.001f;
+};
 
-};
\ No newline at end of file
+#endif
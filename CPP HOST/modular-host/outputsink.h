@@ -0,0 +1,48 @@
+#include <cstdint>
+#include "shared.cpp"
+#include "blendshape.h"
+#include "poses.h"
+#include "gaze.h"
+
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#define MAX_OUTPUT_STREAMS 512
+
+// One way of handing eye data to consumers (OscServer, SharedMemorySink,
+// SocketSink). OutputStage owns the stream slots and the filters and passes
+// every filtered sample to each sink it was started with.
+class OutputSink
+{
+public:
+    virtual ~OutputSink() {}
+
+    // A headset took slot id; called before its first Publish.
+    virtual void StreamAdded(int id) = 0;
+    virtual void StreamRemoved(int id) = 0;
+
+    // Called on the stream's receive thread, so it must not block. sampleTime
+    // is the headset's XrTime (0 for legacy frames), hostTime the same instant
+    // on the host's clock (0 until the clocks are synced), receivedNs the
+    // MonotonicNs() at which the sample came off the network.
+    virtual void Publish(int id, const EtData &data, uint64_t sampleTime, uint64_t hostTime,
+                         uint64_t receivedNs) = 0;
+
+    // Face and lip tracking, for sinks that take it; the others ignore both.
+    // BlendshapeChannels names the channels of stream id before its first
+    // PublishBlendshapes, and again whenever the headset sends a new
+    // dictionary. Both are called on the stream's receive thread.
+    virtual void BlendshapeChannels(int /*id*/, const BlendshapeDictionary & /*dictionary*/) {}
+    virtual void PublishBlendshapes(int /*id*/, const BlendshapeFrame & /*frame*/, uint64_t /*receivedNs*/) {}
+
+    // Body joints and motion trackers, one source per frame (frame.source),
+    // likewise only for sinks that take them.
+    virtual void PublishPoses(int /*id*/, const PoseFrame & /*frame*/, uint64_t /*receivedNs*/) {}
+
+    // The headset's combined gaze ray, again only for sinks that take it.
+    virtual void PublishGazeRay(int /*id*/, const GazeRay & /*ray*/, uint64_t /*receivedNs*/) {}
+
+    virtual void Stop() = 0;
+};
+
+#endif
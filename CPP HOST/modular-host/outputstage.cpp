@@ -0,0 +1,191 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "shared.cpp"
+#include "filters.h"
+#include "outputsink.h"
+#include "oscserver.cpp"
+#include "sharedmemorysink.cpp"
+#include "socketsink.cpp"
+
+#ifndef OUTPUTSTAGE_CPP
+#define OUTPUTSTAGE_CPP
+
+// Which sinks the host feeds, and the filtering they all share.
+struct OutputOptions
+{
+    bool osc = true;
+    OscOptions oscOptions;
+    const char *sharedMemoryName = nullptr; // no shared memory when null
+    const char *socketPath = nullptr;       // no Unix domain socket when null
+    FilterSettings filter;
+};
+
+// Consumes argv[i], and its value, when it is one of the output options
+// shared by TcpHost and EtReplay:
+//   no-osc                do not send OSC
+//   shm <name>            also publish into shared memory <name> (see localoutput.h)
+//   ipc <path>            also serve subscribers on Unix domain socket <path>
+//   filter <name>         smooth every channel: one-euro, kalman or none (default)
+//   median <n>            reject outliers with a median of the last n samples (odd, up to 7)
+//   no-blink-hold         keep forwarding pupil and gaze while the eye is closed
+//                         (see filters.h)
+//   and the OSC options of ParseOscOption (oscserver.cpp)
+inline bool ParseOutputOption(int argc, char **argv, int &i, OutputOptions &options)
+{
+    bool hasValue = i + 1 < argc;
+    if (std::strcmp(argv[i], "no-osc") == 0)
+        options.osc = false;
+    else if (std::strcmp(argv[i], "shm") == 0 && hasValue)
+        options.sharedMemoryName = argv[++i];
+    else if (std::strcmp(argv[i], "ipc") == 0 && hasValue)
+        options.socketPath = argv[++i];
+    else if (std::strcmp(argv[i], "filter") == 0 && hasValue)
+    {
+        if (!ParseSmoothing(argv[++i], options.filter.smoothing))
+            std::cerr << "[OUTPUT] Unknown filter " << argv[i] << ", not filtering\n";
+    }
+    else if (std::strcmp(argv[i], "median") == 0 && hasValue)
+        options.filter.medianWindow = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "no-blink-hold") == 0)
+        options.filter.holdOnBlink = false;
+    else
+        return ParseOscOption(argc, argv, i, options.oscOptions);
+    return true;
+}
+
+// Hands every headset's samples to the output sinks. Receivers claim a
+// stream slot per headset (AddStream) and pass each decoded sample to
+// Publish, which filters it once and gives the result to every sink on the
+// receiving thread.
+class OutputStage
+{
+public:
+    OutputStage() : active(new bool[MAX_OUTPUT_STREAMS]()), filters(MAX_OUTPUT_STREAMS) {}
+
+    // Returns false when a requested sink cannot start. NetStartup() must have
+    // been called.
+    bool Start(const OutputOptions &options)
+    {
+        filters.Configure(options.filter);
+        if (options.osc)
+        {
+            std::unique_ptr<OscServer> osc(new OscServer());
+            if (!osc->StartOscSocket(options.oscOptions))
+                return false;
+            sinks.push_back(std::move(osc));
+        }
+        if (options.sharedMemoryName)
+        {
+            std::unique_ptr<SharedMemorySink> shm(new SharedMemorySink());
+            if (!shm->Start(options.sharedMemoryName))
+                return false;
+            sinks.push_back(std::move(shm));
+        }
+        if (options.socketPath)
+        {
+            std::unique_ptr<SocketSink> ipc(new SocketSink());
+            if (!ipc->Start(options.socketPath))
+                return false;
+            sinks.push_back(std::move(ipc));
+        }
+        if (sinks.empty())
+            std::cout << "[OUTPUT] No output selected, samples are only received\n";
+        return true;
+    }
+
+    // Claims a stream slot for a new headset. Returns -1 when all are taken.
+    int AddStream()
+    {
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        for (int id = 0; id < MAX_OUTPUT_STREAMS; ++id)
+        {
+            if (active[id])
+                continue;
+            active[id] = true;
+            filters.Reset(id);
+            for (auto &sink : sinks)
+                sink->StreamAdded(id);
+            return id;
+        }
+        return -1;
+    }
+
+    void RemoveStream(int id)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        for (auto &sink : sinks)
+            sink->StreamRemoved(id);
+        active[id] = false;
+    }
+
+    // Filters a sample and passes it to every sink. receivedNs is the
+    // MonotonicNs() at which the sample came off the network. Each stream
+    // must only be published from one thread.
+    void Publish(int id, const EtSample &sample, uint64_t receivedNs)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        EtData filtered;
+        if (!filters.Apply(id, sample, receivedNs, filtered))
+            return;
+        for (auto &sink : sinks)
+            sink->Publish(id, filtered, sample.time, sample.hostTime, receivedNs);
+    }
+
+    // Face and lip tracking goes to the sinks as it arrives: the eye filters
+    // are tuned for gaze and lids, and a blendshape rig smooths on its own.
+    void BlendshapeChannels(int id, const BlendshapeDictionary &dictionary)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        for (auto &sink : sinks)
+            sink->BlendshapeChannels(id, dictionary);
+    }
+
+    void PublishBlendshapes(int id, const BlendshapeFrame &frame, uint64_t receivedNs)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        for (auto &sink : sinks)
+            sink->PublishBlendshapes(id, frame, receivedNs);
+    }
+
+    // Poses too: each sink gets the one decoded frame by reference.
+    void PublishPoses(int id, const PoseFrame &frame, uint64_t receivedNs)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        for (auto &sink : sinks)
+            sink->PublishPoses(id, frame, receivedNs);
+    }
+
+    // The gaze ray is derived from the raw eye gaze on the headset, so the eye
+    // filters do not apply to it either.
+    void PublishGazeRay(int id, const GazeRay &ray, uint64_t receivedNs)
+    {
+        if (id < 0 || id >= MAX_OUTPUT_STREAMS)
+            return;
+        for (auto &sink : sinks)
+            sink->PublishGazeRay(id, ray, receivedNs);
+    }
+
+    void Stop()
+    {
+        for (auto &sink : sinks)
+            sink->Stop();
+    }
+
+private:
+    std::unique_ptr<bool[]> active; // guarded by streamsMutex
+    FilterBank filters;
+    std::vector<std::unique_ptr<OutputSink>> sinks; // fixed once started
+    std::mutex streamsMutex;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// The few socket calls that differ between Winsock and POSIX. Everything else
+// (socket, bind, recv, sendto, ...) is spelled the same on both, so the host
+// code uses those directly and goes through here only for the rest.
+
+#ifndef _WIN32
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#endif
+
+// Call once before the first socket is created; pair with NetCleanup().
+inline bool NetStartup()
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    // A headset vanishing mid-send must not kill the host.
+    std::signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+}
+
+inline void NetCleanup()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+inline void CloseSocket(SOCKET sock)
+{
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+}
+
+inline int NetLastError()
+{
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+// True when a failed call on a non-blocking socket only means "try again later".
+inline bool NetWouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+inline bool ParseIPv4(const char *text, in_addr &out)
+{
+#ifdef _WIN32
+    return InetPtonA(AF_INET, text, &out) == 1;
+#else
+    return inet_pton(AF_INET, text, &out) == 1;
+#endif
+}
+
+inline bool SetNonBlocking(SOCKET sock)
+{
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// Makes blocking receives on sock give up after ms; the failure then passes
+// NetTimedOut().
+inline bool SetReceiveTimeout(SOCKET sock, int ms)
+{
+#ifdef _WIN32
+    DWORD timeout = (DWORD)ms;
+#else
+    timeval timeout{ms / 1000, (ms % 1000) * 1000};
+#endif
+    return setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout)) == 0;
+}
+
+// Whether the last failed receive ran into the SetReceiveTimeout() limit.
+inline bool NetTimedOut()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAETIMEDOUT;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// On POSIX, lets a restarted host bind its port while the old connections
+// sit in TIME_WAIT, and on Linux also sets SO_REUSEPORT, so several host
+// processes can share one port and the kernel spreads headsets across them.
+// Winsock's SO_REUSEADDR means something else: any process could bind the
+// port over a running host and take its traffic. There the port is claimed
+// with SO_EXCLUSIVEADDRUSE instead, so one host owns it.
+inline void SetReusePort(SOCKET sock)
+{
+    int on = 1;
+#ifdef _WIN32
+    setsockopt(sock, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, (const char *)&on, sizeof(on));
+#else
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+#endif
+#ifdef SO_REUSEPORT
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (const char *)&on, sizeof(on));
+#endif
+}
+
+// Spins in the driver for up to usec before sleeping in a blocking receive,
+// trading CPU for wake-up latency. Linux only; returns false elsewhere.
+inline bool SetBusyPoll(SOCKET sock, int usec)
+{
+#ifdef SO_BUSY_POLL
+    return setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, (const char *)&usec, sizeof(usec)) == 0;
+#else
+    (void)sock;
+    (void)usec;
+    return false;
+#endif
+}
+
+#endif
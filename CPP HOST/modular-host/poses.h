@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "framing.h"
+
+#ifndef POSES_H
+#define POSES_H
+
+// Body joints and motion trackers as pose frames. A client that offers
+// HELLO_POSES and has it acknowledged sends FRAME_POSES, each one reading of
+// one source:
+//   PoseFrameHeader, then a PackedPose for every joint set in trackedMask, in
+//   joint order
+//
+// The joint sets are fixed, so unlike blendshapes no dictionary goes first:
+// POSE_SOURCE_BODY is XrBodyJointBD order (24 joints), POSE_SOURCE_TRACKERS
+// holds the motion trackers in the order the headset connected them.
+//
+// A pose packs into 10 bytes instead of 28: positions as millimetres in int16
+// (+-32 m of play space), rotations as smallest-three quaternions in 32 bits.
+// The largest component is dropped, since it follows from the other three
+// and the unit length, and the rest, each within +-1/sqrt(2), get 10 bits: at
+// most a quarter of a degree off. A full body at 90 Hz is about 24 KB/s.
+
+#define POSE_MAX_JOINTS 32
+#define POSE_BODY_JOINTS 24  // XR_BODY_JOINT_COUNT_BD
+#define POSE_MAX_TRACKERS 6  // XR_MOTION_TRACKER_MAX_SIZE_PICO
+
+enum PoseSource : uint8_t
+{
+    POSE_SOURCE_BODY = 1,
+    POSE_SOURCE_TRACKERS = 2,
+};
+
+#define POSE_SOURCE_COUNT 2 // PoseSourceSlot() maps the sources to 0..1
+
+// As the host addresses them over OSC, in XrBodyJointBD order.
+static const char *const kPoseBodyJointNames[POSE_BODY_JOINTS] = {
+    "Pelvis",        "LeftHip",       "RightHip",      "Spine1",        "LeftKnee",   "RightKnee",
+    "Spine2",        "LeftAnkle",     "RightAnkle",    "Spine3",        "LeftFoot",   "RightFoot",
+    "Neck",          "LeftCollar",    "RightCollar",   "Head",          "LeftShoulder", "RightShoulder",
+    "LeftElbow",     "RightElbow",    "LeftWrist",     "RightWrist",    "LeftHand",   "RightHand",
+};
+
+#pragma pack(push, 1)
+struct PoseFrameHeader
+{
+    uint64_t time;        // XrTime the poses were located for, ns
+    uint8_t source;       // PoseSource
+    uint8_t jointCount;   // joints in the set, tracked or not
+    uint32_t trackedMask; // bit i: joint i was located, and its PackedPose follows
+};
+
+struct PackedPose
+{
+    int16_t position[3]; // mm
+    uint32_t rotation;   // PackQuaternion
+};
+#pragma pack(pop)
+
+struct Pose
+{
+    float position[3]; // m
+    float rotation[4]; // x, y, z, w
+};
+
+// One reading of one source, decoded. Joints whose trackedMask bit is clear
+// hold nothing meaningful.
+struct PoseFrame
+{
+    uint64_t time;      // headset XrTime, ns
+    uint64_t captureNs; // sender monotonic clock at capture; not sent
+    uint64_t hostTime;  // time on the host's clock once synced (clocksync.h), 0 otherwise; not sent
+    uint8_t source;
+    uint8_t jointCount;
+    uint32_t trackedMask;
+    Pose joints[POSE_MAX_JOINTS];
+};
+
+// Largest framed FRAME_POSES, for senders sizing their buffers.
+#define POSE_MAX_FRAME (sizeof(FrameHeader) + sizeof(PoseFrameHeader) + POSE_MAX_JOINTS * sizeof(PackedPose))
+
+// Index of a source's slot in per-source arrays, or -1 for an unknown source.
+inline int PoseSourceSlot(uint8_t source)
+{
+    return source >= POSE_SOURCE_BODY && source <= POSE_SOURCE_TRACKERS ? source - POSE_SOURCE_BODY : -1;
+}
+
+#define POSE_QUAT_BITS 10
+#define POSE_QUAT_MASK ((1u << POSE_QUAT_BITS) - 1)
+#define POSE_QUAT_HALF 511 // a component c is sent as round(c * sqrt(2) * 511) + 511
+
+// Smallest three: bits 30-31 name the dropped component, the three others
+// follow from bit 29 down, 10 bits each. The mapping is symmetric, so a zero
+// component, and with it the identity, comes back exact.
+inline uint32_t PackQuaternion(const float q[4])
+{
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (std::fabs(q[i]) > std::fabs(q[largest]))
+            largest = i;
+    }
+    // q and -q are the same rotation; make the dropped component positive.
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+    uint32_t packed = (uint32_t)largest << 30;
+    int shift = 20;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float v = std::nearbyint(sign * q[i] * (float)M_SQRT2 * POSE_QUAT_HALF);
+        v = v > -POSE_QUAT_HALF ? (v < POSE_QUAT_HALF ? v : POSE_QUAT_HALF) : -POSE_QUAT_HALF; // also maps NaN
+        uint32_t bits = (uint32_t)(int32_t)(v + POSE_QUAT_HALF);
+        packed |= bits << shift;
+        shift -= POSE_QUAT_BITS;
+    }
+    return packed;
+}
+
+inline void UnpackQuaternion(uint32_t packed, float q[4])
+{
+    int largest = (int)(packed >> 30);
+    int shift = 20;
+    float sum = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        int bits = (int)((packed >> shift) & POSE_QUAT_MASK);
+        q[i] = (float)(bits - POSE_QUAT_HALF) * ((float)M_SQRT1_2 / POSE_QUAT_HALF);
+        sum += q[i] * q[i];
+        shift -= POSE_QUAT_BITS;
+    }
+    q[largest] = sum < 1.0f ? std::sqrt(1.0f - sum) : 0.0f;
+}
+
+inline int16_t PackPosition(float metres)
+{
+    float mm = std::nearbyint(metres * 1000.0f);
+    if (!(mm >= -32768.0f))
+        mm = -32768.0f;
+    if (mm > 32767.0f)
+        mm = 32767.0f;
+    return (int16_t)mm;
+}
+
+// Writes frame as one framed FRAME_POSES. Returns its size, or 0 when it does
+// not fit into cap.
+inline size_t EncodePoses(const PoseFrame &frame, uint8_t *out, size_t cap)
+{
+    uint8_t payload[sizeof(PoseFrameHeader) + POSE_MAX_JOINTS * sizeof(PackedPose)];
+    if (frame.jointCount > POSE_MAX_JOINTS)
+        return 0;
+    uint32_t mask = frame.jointCount < 32 ? frame.trackedMask & ((1u << frame.jointCount) - 1) : frame.trackedMask;
+    PoseFrameHeader hdr{frame.time, frame.source, frame.jointCount, mask};
+    std::memcpy(payload, &hdr, sizeof(hdr));
+
+    size_t length = sizeof(hdr);
+    for (int i = 0; i < frame.jointCount; ++i)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+        const Pose &pose = frame.joints[i];
+        PackedPose packed;
+        for (int axis = 0; axis < 3; ++axis)
+            packed.position[axis] = PackPosition(pose.position[axis]);
+        packed.rotation = PackQuaternion(pose.rotation);
+        std::memcpy(payload + length, &packed, sizeof(packed));
+        length += sizeof(packed);
+    }
+    return WriteFrame(out, cap, FRAME_POSES, payload, (uint16_t)length);
+}
+
+// Decodes a FRAME_POSES payload. Untracked joints are left as they were.
+// captureNs and hostTime are left to the caller.
+inline bool DecodePoses(const uint8_t *payload, size_t length, PoseFrame &frame)
+{
+    PoseFrameHeader hdr;
+    if (length < sizeof(hdr))
+        return false;
+    std::memcpy(&hdr, payload, sizeof(hdr));
+    if (PoseSourceSlot(hdr.source) < 0 || hdr.jointCount > POSE_MAX_JOINTS ||
+        (hdr.jointCount < 32 && (hdr.trackedMask >> hdr.jointCount) != 0))
+        return false;
+    size_t tracked = 0;
+    for (uint32_t mask = hdr.trackedMask; mask != 0; mask &= mask - 1)
+        ++tracked;
+    if (length != sizeof(hdr) + tracked * sizeof(PackedPose))
+        return false;
+
+    frame.time = hdr.time;
+    frame.source = hdr.source;
+    frame.jointCount = hdr.jointCount;
+    frame.trackedMask = hdr.trackedMask;
+    const uint8_t *at = payload + sizeof(hdr);
+    for (int i = 0; i < hdr.jointCount; ++i)
+    {
+        if (!(hdr.trackedMask & (1u << i)))
+            continue;
+        PackedPose packed;
+        std::memcpy(&packed, at, sizeof(packed));
+        at += sizeof(packed);
+        Pose &pose = frame.joints[i];
+        for (int axis = 0; axis < 3; ++axis)
+            pose.position[axis] = packed.position[axis] * 0.001f;
+        UnpackQuaternion(packed.rotation, pose.rotation);
+    }
+    return true;
+}
+
+#endif
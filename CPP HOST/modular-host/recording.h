@@ -0,0 +1,337 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "shared.cpp"
+#ifdef _WIN32
+#include "platform.h" // winsock2.h has to come before windows.h
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+// Session recordings (.etrec). The file is append-only and every struct is a
+// multiple of 8 bytes, so a reader can mmap it and use the records in place:
+//
+//   EtRecFileHeader
+//   { EtRecChunkHeader, RecordedSample[count] } ...
+//   EtRecIndexEntry[chunkCount]    written by Close()
+//   EtRecTrailer                   written by Close()
+//
+// A recording cut short by a crash has no index or trailer; the reader then
+// walks the chunk headers instead and drops a trailing partial chunk.
+
+#define ETREC_MAGIC 0x43455245u       // "EREC"
+#define ETREC_CHUNK_MAGIC 0x4b4e4843u // "CHNK"
+#define ETREC_VERSION 1
+#define ETREC_CHUNK_RECORDS 1024
+
+#pragma pack(push, 1)
+struct EtRecFileHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize; // sizeof(RecordedSample) when written
+    uint64_t createdNs;  // wall clock, ns since 1970
+};
+
+struct EtRecChunkHeader
+{
+    uint32_t magic;
+    uint32_t count;          // RecordedSamples following this header
+    uint64_t firstReceiveNs;
+    uint64_t lastReceiveNs;
+};
+
+struct RecordedSample
+{
+    uint64_t captureTime;   // XrTime from the headset, 0 for legacy frames
+    uint64_t receiveNs;     // host monotonic clock when the frame arrived
+    uint32_t stream;        // host OSC stream the sample belonged to
+    uint32_t trackingState;
+    EtData data;
+};
+
+struct EtRecIndexEntry
+{
+    uint64_t offset; // of the EtRecChunkHeader
+    uint64_t firstReceiveNs;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct EtRecTrailer
+{
+    uint64_t indexOffset;
+    uint32_t chunkCount;
+    uint32_t magic;
+};
+#pragma pack(pop)
+
+// Appends received samples to a recording. Record() may be called from any
+// receive thread; it only copies into the open chunk. A writer thread seals
+// the chunk once it is full or a second old, so a crash loses at most that.
+class Recorder
+{
+public:
+    ~Recorder() { Close(); }
+
+    bool Open(const char *path)
+    {
+        file = std::fopen(path, "wb");
+        if (!file)
+            return false;
+
+        EtRecFileHeader header{ETREC_MAGIC, ETREC_VERSION, (uint16_t)sizeof(RecordedSample), WallClockNs()};
+        std::fwrite(&header, sizeof(header), 1, file);
+        offset = sizeof(header);
+        pending.reserve(ETREC_CHUNK_RECORDS);
+        running = true;
+        writer = std::thread(&Recorder::WriterLoop, this);
+        return true;
+    }
+
+    void Record(uint32_t stream, const EtSample &sample, uint64_t receiveNs)
+    {
+        RecordedSample record{sample.time, receiveNs, stream, (uint32_t)sample.trackingState, sample.data};
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+            return;
+        pending.push_back(record);
+        if (pending.size() >= ETREC_CHUNK_RECORDS)
+            wake.notify_one();
+    }
+
+    // Seals the last chunk and writes the chunk index and trailer.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running)
+                return;
+            running = false;
+        }
+        wake.notify_one();
+        writer.join();
+
+        EtRecTrailer trailer{offset, (uint32_t)index.size(), ETREC_MAGIC};
+        if (!index.empty())
+            std::fwrite(index.data(), sizeof(EtRecIndexEntry), index.size(), file);
+        std::fwrite(&trailer, sizeof(trailer), 1, file);
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    uint64_t RecordsWritten() const { return written; }
+
+private:
+    static uint64_t WallClockNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void WriterLoop()
+    {
+        std::vector<RecordedSample> sealed;
+        sealed.reserve(ETREC_CHUNK_RECORDS);
+        bool more = true;
+        while (more)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::seconds(1),
+                              [this] { return !running || pending.size() >= ETREC_CHUNK_RECORDS; });
+                sealed.swap(pending);
+                more = running;
+            }
+            WriteChunk(sealed);
+            sealed.clear();
+        }
+    }
+
+    void WriteChunk(const std::vector<RecordedSample> &records)
+    {
+        if (records.empty())
+            return;
+
+        EtRecChunkHeader chunk{ETREC_CHUNK_MAGIC, (uint32_t)records.size(), records.front().receiveNs, records.back().receiveNs};
+        std::fwrite(&chunk, sizeof(chunk), 1, file);
+        std::fwrite(records.data(), sizeof(RecordedSample), records.size(), file);
+        std::fflush(file);
+
+        index.push_back(EtRecIndexEntry{offset, chunk.firstReceiveNs, chunk.count, 0});
+        offset += sizeof(chunk) + records.size() * sizeof(RecordedSample);
+        written += records.size();
+    }
+
+    FILE *file = nullptr;
+    uint64_t offset = 0;
+    std::vector<EtRecIndexEntry> index; // writer thread, then Close()
+    uint64_t written = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<RecordedSample> pending; // guarded by mutex
+    bool running = false;                // guarded by mutex
+    std::thread writer;
+};
+
+// Read-only view of a recording, memory-mapped.
+class RecordingReader
+{
+public:
+    ~RecordingReader() { Unmap(); }
+
+    bool Open(const char *path)
+    {
+        if (!Map(path) || size < sizeof(EtRecFileHeader))
+            return false;
+
+        const EtRecFileHeader *header = (const EtRecFileHeader *)data;
+        if (header->magic != ETREC_MAGIC || header->version != ETREC_VERSION
+            || header->recordSize != sizeof(RecordedSample))
+            return false;
+
+        if (!ReadIndex())
+            ScanChunks();
+        return true;
+    }
+
+    size_t ChunkCount() const { return chunks.size(); }
+    const EtRecIndexEntry &Chunk(size_t i) const { return chunks[i]; }
+
+    const RecordedSample *Records(size_t chunk) const
+    {
+        return (const RecordedSample *)(data + chunks[chunk].offset + sizeof(EtRecChunkHeader));
+    }
+
+    // First chunk that may hold samples received at or after receiveNs.
+    size_t FindChunk(uint64_t receiveNs) const
+    {
+        size_t lo = 0, hi = chunks.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (chunks[mid].firstReceiveNs <= receiveNs)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo > 0 ? lo - 1 : 0;
+    }
+
+    // true when the index had to be rebuilt because the recording was not closed.
+    bool Recovered() const { return recovered; }
+
+private:
+    bool ReadIndex()
+    {
+        if (size < sizeof(EtRecFileHeader) + sizeof(EtRecTrailer))
+            return false;
+        const EtRecTrailer *trailer = (const EtRecTrailer *)(data + size - sizeof(EtRecTrailer));
+        if (trailer->magic != ETREC_MAGIC
+            || trailer->indexOffset + (uint64_t)trailer->chunkCount * sizeof(EtRecIndexEntry) + sizeof(EtRecTrailer) != size)
+            return false;
+
+        const EtRecIndexEntry *entries = (const EtRecIndexEntry *)(data + trailer->indexOffset);
+        for (uint32_t i = 0; i < trailer->chunkCount; ++i)
+        {
+            if (entries[i].offset + sizeof(EtRecChunkHeader) + (uint64_t)entries[i].count * sizeof(RecordedSample) > trailer->indexOffset)
+                return false;
+        }
+        chunks.assign(entries, entries + trailer->chunkCount);
+        return true;
+    }
+
+    void ScanChunks()
+    {
+        recovered = true;
+        chunks.clear();
+        uint64_t at = sizeof(EtRecFileHeader);
+        while (at + sizeof(EtRecChunkHeader) <= size)
+        {
+            const EtRecChunkHeader *chunk = (const EtRecChunkHeader *)(data + at);
+            uint64_t end = at + sizeof(EtRecChunkHeader) + (uint64_t)chunk->count * sizeof(RecordedSample);
+            if (chunk->magic != ETREC_CHUNK_MAGIC || end > size)
+                break;
+            chunks.push_back(EtRecIndexEntry{at, chunk->firstReceiveNs, chunk->count, 0});
+            at = end;
+        }
+    }
+
+#ifdef _WIN32
+    bool Map(const char *path)
+    {
+        fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+            return false;
+        size = (size_t)fileSize.QuadPart;
+        mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return false;
+        data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+    }
+
+    void Unmap()
+    {
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+    }
+
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    bool Map(const char *path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)st.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (const uint8_t *)mapped;
+        return true;
+    }
+
+    void Unmap()
+    {
+        if (data)
+            munmap((void *)data, size);
+    }
+#endif
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::vector<EtRecIndexEntry> chunks;
+    bool recovered = false;
+};
+
+#endif
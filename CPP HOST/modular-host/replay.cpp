@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <thread>
+#include "platform.h"
+#include "shared.cpp"
+#include "latency.h"
+#include "outputstage.cpp"
+#include "recording.h"
+
+// Feeds a recording made with "TcpHost record <file>" back through the
+// output stage, so sessions can be replayed and load-tested without a headset.
+//
+//   EtReplay <file> [speed <n>|max] [from <seconds>] [osc-rate <hz>] [osc-namespace]
+//            [osc-host <ip>] [osc-port <n>] [filter <name>] [median <n>] [no-blink-hold]
+//            [resample <mode>] [resample-delay <ms>] [no-osc] [shm <name>] [ipc <path>] [loop]
+//
+//   speed <n>       play at n times real time (default 1); "max" does not wait at all
+//   from <seconds>  start this far into the recording, found through the chunk index
+//   osc-rate <hz>   OSC output rate (default 60); raise it with "speed max" and
+//                   "resample latest" to emit every sample
+//   osc-namespace, osc-host, osc-port, filter, median, no-blink-hold, resample, resample-delay,
+//   no-osc, shm, ipc
+//                   same as for TcpHost; the recording holds the unfiltered samples
+//   loop            start over at the end until killed
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: EtReplay <file> [speed <n>|max] [from <seconds>] [osc-rate <hz>] [osc-namespace] [osc-host <ip>] [osc-port <n>]\n"
+                     "                [filter <name>] [median <n>] [no-blink-hold] [resample <mode>] [resample-delay <ms>]\n"
+                     "                [no-osc] [shm <name>] [ipc <path>] [loop]\n";
+        return 1;
+    }
+
+    double speed = 1.0;
+    bool maxSpeed = false;
+    double fromSeconds = 0.0;
+    bool loop = false;
+    OutputOptions outputOptions;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "speed") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if (std::strcmp(argv[i], "max") == 0)
+                maxSpeed = true;
+            else
+                speed = std::atof(argv[i]);
+        }
+        else if (std::strcmp(argv[i], "from") == 0 && i + 1 < argc)
+            fromSeconds = std::atof(argv[++i]);
+        else if (ParseOutputOption(argc, argv, i, outputOptions))
+            continue;
+        else if (std::strcmp(argv[i], "loop") == 0)
+            loop = true;
+    }
+    if (!(speed > 0.0))
+        speed = 1.0;
+
+    RecordingReader reader;
+    if (!reader.Open(argv[1]))
+    {
+        std::cerr << "[REPLAY] Cannot read recording " << argv[1] << "\n";
+        return 1;
+    }
+    if (reader.ChunkCount() == 0)
+    {
+        std::cerr << "[REPLAY] Recording is empty\n";
+        return 1;
+    }
+    if (reader.Recovered())
+        std::cout << "[REPLAY] Recording was not closed; rebuilt the index from " << reader.ChunkCount() << " chunks\n";
+
+    if (!NetStartup())
+    {
+        std::cerr << "[REPLAY] Network startup failed: " << NetLastError() << "\n";
+        return 1;
+    }
+
+    OutputStage output;
+    if (!output.Start(outputOptions))
+        return 1;
+
+    uint64_t start = reader.Chunk(0).firstReceiveNs + (uint64_t)(fromSeconds * 1e9);
+    size_t firstChunk = reader.FindChunk(start);
+    std::map<uint32_t, int> streams; // recorded stream -> replay stream
+
+    do
+    {
+        auto wallStart = std::chrono::steady_clock::now();
+        uint64_t replayed = 0;
+        for (size_t c = firstChunk; c < reader.ChunkCount(); ++c)
+        {
+            const RecordedSample *records = reader.Records(c);
+            for (uint32_t i = 0; i < reader.Chunk(c).count; ++i)
+            {
+                const RecordedSample &record = records[i];
+                // Receive threads append concurrently, so a record can be a hair
+                // older than the one before it.
+                int64_t at = (int64_t)(record.receiveNs - start);
+                if (at < 0)
+                {
+                    if (fromSeconds > 0.0)
+                        continue;
+                    at = 0;
+                }
+                if (!maxSpeed)
+                    std::this_thread::sleep_until(wallStart + std::chrono::nanoseconds((int64_t)(at / speed)));
+
+                auto found = streams.find(record.stream);
+                if (found == streams.end())
+                    found = streams.emplace(record.stream, output.AddStream()).first;
+                // Filter on the recorded timeline, whatever the replay speed. Legacy
+                // frames have no capture time and were once recorded without state.
+                EtSample sample{record.captureTime != 0 ? record.captureTime : record.receiveNs,
+                                record.captureTime != 0 ? record.trackingState : ET_TRACKING_BOTH_EYES, 0, record.data,
+                                0};
+                output.Publish(found->second, sample, MonotonicNs());
+                ++replayed;
+            }
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        std::cout << "[REPLAY] " << replayed << " samples from " << streams.size() << " headsets in " << elapsed << " s ("
+                  << (elapsed > 0 ? replayed / elapsed : 0.0) << " samples/s)\n";
+    } while (loop);
+
+    // Give the output thread a tick to emit the final samples.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    output.Stop();
+    NetCleanup();
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <cstdint>
+#include <cstring>
+#include "shared.cpp"
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+// Turns a headset's irregular sample arrivals into values at the OSC output's
+// fixed ticks. Each stream keeps its last few samples stamped on the host
+// clock; a tick evaluates them at (tick - delay), interpolating inside the
+// history and extrapolating past its newest sample. The distance past the
+// newest sample is the prediction horizon the output reports.
+//
+// Timestamps are the headset's capture times on the host clock. Once the host
+// has synced to the headset's clock (clocksync.h) that is the sample's
+// hostTime; until then the capture time is shifted by the smallest receive -
+// capture offset seen. Either keeps the capture spacing and drops the network
+// and scheduling jitter of the arrival times. Legacy frames carry no capture
+// time and use the arrival time as is.
+
+#define RESAMPLE_HISTORY 4
+
+enum class Resampling
+{
+    Latest,  // no resampling: send each new sample once, as before
+    Linear,  // piecewise linear on every channel
+    Hermite, // cubic Hermite on the canthus UVs, linear on the rest
+};
+
+// "latest", "linear" or "hermite", as given on the command line.
+inline bool ParseResampling(const char *name, Resampling &out)
+{
+    if (std::strcmp(name, "latest") == 0)
+        out = Resampling::Latest;
+    else if (std::strcmp(name, "linear") == 0)
+        out = Resampling::Linear;
+    else if (std::strcmp(name, "hermite") == 0)
+        out = Resampling::Hermite;
+    else
+        return false;
+    return true;
+}
+
+struct ResampleSettings
+{
+    Resampling mode = Resampling::Linear;
+    int64_t delayNs = 0;                     // evaluate this far behind the tick; more delay, less extrapolation
+    int64_t maxExtrapolationNs = 50000000;   // hold the value beyond this horizon
+};
+
+// The last RESAMPLE_HISTORY samples of a stream, oldest first. Trivially
+// copyable so it can be published through a SeqLock as one value.
+struct SampleHistory
+{
+    EtData data[RESAMPLE_HISTORY];
+    uint64_t hostNs[RESAMPLE_HISTORY]; // sample time on the host clock
+    uint64_t receivedNs;               // arrival of the newest sample
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// Producer side: stamps each sample of one stream and appends it.
+class HistoryWriter
+{
+public:
+    void Reset()
+    {
+        history = SampleHistory{};
+        offsetSeen = false;
+    }
+
+    const SampleHistory &Push(const EtData &data, uint64_t sampleTime, uint64_t hostTime, uint64_t receivedNs)
+    {
+        uint64_t hostNs = receivedNs;
+        if (hostTime != 0)
+            hostNs = hostTime;
+        else if (sampleTime != 0)
+        {
+            int64_t offset = (int64_t)(receivedNs - sampleTime);
+            // Creep upwards a little per sample so the floor follows clock drift
+            // (about 90 ppm at 90 Hz); start over when the headset's clock jumps.
+            if (!offsetSeen || offset < floor || offset - floor > MAX_OFFSET_JUMP_NS)
+            {
+                if (offsetSeen && offset - floor > MAX_OFFSET_JUMP_NS)
+                    history.count = 0;
+                floor = offset;
+                offsetSeen = true;
+            }
+            else
+            {
+                floor += OFFSET_CREEP_NS;
+                if (offset < floor)
+                    floor = offset;
+            }
+            hostNs = sampleTime + floor;
+        }
+
+        if (history.count > 0 && hostNs <= history.hostNs[history.count - 1])
+            history.count = 0; // out of order or a new session; the old points no longer fit
+
+        if (history.count == RESAMPLE_HISTORY)
+        {
+            std::memmove(history.data, history.data + 1, (RESAMPLE_HISTORY - 1) * sizeof(EtData));
+            std::memmove(history.hostNs, history.hostNs + 1, (RESAMPLE_HISTORY - 1) * sizeof(uint64_t));
+            --history.count;
+        }
+        history.data[history.count] = data;
+        history.hostNs[history.count] = hostNs;
+        history.receivedNs = receivedNs;
+        ++history.count;
+        return history;
+    }
+
+private:
+    static const int64_t OFFSET_CREEP_NS = 1000;
+    static const int64_t MAX_OFFSET_JUMP_NS = 1000000000;
+
+    SampleHistory history{};
+    int64_t floor = 0;
+    bool offsetSeen = false;
+};
+
+// Evaluates history at atNs into out. horizonNs is how far atNs lies past the
+// newest sample (negative when interpolating), before clamping to the limit.
+inline void Resample(const SampleHistory &h, uint64_t atNs, const ResampleSettings &settings, EtData &out,
+                     int64_t &horizonNs)
+{
+    const int n = (int)h.count;
+    horizonNs = (int64_t)(atNs - h.hostNs[n - 1]);
+    if (n == 1 || settings.mode == Resampling::Latest)
+    {
+        out = h.data[n - 1];
+        return;
+    }
+
+    float y[RESAMPLE_HISTORY][8];
+    std::memcpy(y, h.data, sizeof(float) * 8 * n);
+    float result[8];
+
+    // Segment k..k+1 holding atNs; past the newest sample, extrapolate along the last one.
+    int k = n - 2;
+    int64_t span = (int64_t)(h.hostNs[k + 1] - h.hostNs[k]);
+    int64_t into;
+    if (horizonNs > 0)
+    {
+        into = span + (horizonNs < settings.maxExtrapolationNs ? horizonNs : settings.maxExtrapolationNs);
+    }
+    else
+    {
+        while (k > 0 && atNs < h.hostNs[k])
+            --k;
+        span = (int64_t)(h.hostNs[k + 1] - h.hostNs[k]);
+        into = atNs < h.hostNs[k] ? 0 : (int64_t)(atNs - h.hostNs[k]);
+    }
+    float u = (float)((double)into / (double)span);
+
+    for (int i = 0; i < 8; ++i)
+        result[i] = y[k][i] + u * (y[k + 1][i] - y[k][i]);
+
+    if (settings.mode == Resampling::Hermite)
+    {
+        // Catmull-Rom tangents from the neighbouring samples, one-sided at the ends,
+        // in units per segment. Past the newest sample the cubic would swing out, so
+        // the value continues along the slope of the last two segments instead,
+        // which is steadier than the last one alone.
+        int prev = k > 0 ? k - 1 : k;
+        int next = k + 2 < n ? k + 2 : k + 1;
+        float scale0 = (float)((double)span / (double)(h.hostNs[k + 1] - h.hostNs[prev]));
+        float scale1 = (float)((double)span / (double)(h.hostNs[next] - h.hostNs[k]));
+        float u2 = u * u, u3 = u2 * u;
+        float h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u, h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+        for (int i = 4; i < 8; ++i)
+        {
+            float m0 = (y[k + 1][i] - y[prev][i]) * scale0;
+            float m1 = (y[next][i] - y[k][i]) * scale1;
+            if (u > 1.0f)
+                result[i] = y[k + 1][i] + (u - 1.0f) * m0;
+            else
+                result[i] = h00 * y[k][i] + h10 * m0 + h01 * y[k + 1][i] + h11 * m1;
+        }
+    }
+
+    // Openness is a fraction; extrapolating through a blink must not leave 0..1.
+    for (int i = 0; i < 2; ++i)
+        result[i] = result[i] < 0.0f ? 0.0f : (result[i] > 1.0f ? 1.0f : result[i]);
+    std::memcpy(&out, result, sizeof(out));
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+// Single-writer sequence lock holding the latest value of T. The writer never
+// waits; readers retry while a write is in progress, or with TryRead only a
+// bounded number of times, for writers that may die mid-write. The value is
+// copied in 32-bit atomic words so concurrent reads are not a data race.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+public:
+    void Write(const T &value)
+    {
+        uint32_t words[WORDS] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i)
+            data[i].store(words[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Copies the latest value into out and returns its version (0 = never written).
+    uint32_t Read(T &out) const
+    {
+        uint32_t version;
+        while (!TryCopy(out, version))
+            ;
+        return version;
+    }
+
+    // Like Read, but gives up after attempts tries that each met a write in
+    // progress and returns 0 with out untouched.
+    uint32_t TryRead(T &out, int attempts) const
+    {
+        uint32_t version;
+        for (int i = 0; i < attempts; ++i)
+            if (TryCopy(out, version))
+                return version;
+        return 0;
+    }
+
+    uint32_t Version() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    bool TryCopy(T &out, uint32_t &version) const
+    {
+        uint32_t words[WORDS];
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        for (size_t i = 0; i < WORDS; ++i)
+            words[i] = data[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = sequence.load(std::memory_order_relaxed);
+        if ((before & 1) || before != after)
+            return false;
+        std::memcpy(&out, words, sizeof(T));
+        version = before / 2;
+        return true;
+    }
+
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> data[WORDS] = {};
+};
+
+#endif
@@ -27,4 +27,21 @@ struct Message
 };
 #pragma pack(pop)
 
+// EtSample::trackingState bits, as XR_EYE_TRACKER_TRACKING_STATE_*_EYE_BIT_PICO.
+// Legacy frames carry no state and are taken to have both eyes tracked.
+#define ET_TRACKING_LEFT_EYE 0x1
+#define ET_TRACKING_RIGHT_EYE 0x2
+#define ET_TRACKING_BOTH_EYES (ET_TRACKING_LEFT_EYE | ET_TRACKING_RIGHT_EYE)
+
+// One eye-tracker reading with the metadata the v2 wire format carries.
+struct EtSample
+{
+    uint64_t time;          // XrTime the reading was taken for, ns
+    uint64_t trackingState; // XrEyeTrackerTrackingStateFlagsPICO
+    uint64_t captureNs;     // sender monotonic clock at capture; not sent as such
+    EtData data;
+    uint64_t hostTime;      // time on the host's monotonic clock, once the host has synced
+                            // to the headset's clock (clocksync.h); 0 otherwise, not sent
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <iostream>
+#include <new>
+#include "shared.cpp"
+#include "outputsink.h"
+#include "localoutput.h"
+
+#ifndef SHAREDMEMORYSINK_CPP
+#define SHAREDMEMORYSINK_CPP
+
+// Publishes every stream into a shared memory region laid out as in
+// localoutput.h. Publish is a handful of stores: no system call, no lock, and
+// readers in other processes never hold the writer up.
+class SharedMemorySink : public OutputSink
+{
+public:
+    ~SharedMemorySink() override { Stop(); }
+
+    bool Start(const char *name)
+    {
+        if (!mapping.Create(name, sizeof(LocalOutputRegion)))
+        {
+            std::cerr << "[SHM] Cannot create shared memory " << name << "\n";
+            return false;
+        }
+        region = new (mapping.Data()) LocalOutputRegion();
+        region->version = LOCAL_OUTPUT_VERSION;
+        region->streamCount = LOCAL_OUTPUT_STREAMS;
+        region->historyLength = LOCAL_OUTPUT_HISTORY;
+        region->magic.store(LOCAL_OUTPUT_MAGIC, std::memory_order_release);
+        std::cout << "[SHM] Publishing to shared memory " << name << "\n";
+        return true;
+    }
+
+    void StreamAdded(int id) override
+    {
+        if (region == nullptr || id < 0 || id >= LOCAL_OUTPUT_STREAMS)
+            return;
+        LocalStream &stream = region->streams[id];
+        stream.firstIndex.store(stream.count.load(std::memory_order_relaxed), std::memory_order_release);
+        // The previous headset's poses and gaze must not pass for this one's.
+        LocalPoses none{};
+        for (auto &poses : stream.poses)
+            poses.Write(none);
+        stream.gaze.Write(LocalGaze{});
+        stream.active.store(1, std::memory_order_release);
+    }
+
+    void StreamRemoved(int id) override
+    {
+        if (region == nullptr || id < 0 || id >= LOCAL_OUTPUT_STREAMS)
+            return;
+        region->streams[id].active.store(0, std::memory_order_release);
+    }
+
+    void Publish(int id, const EtData &data, uint64_t sampleTime, uint64_t hostTime, uint64_t receivedNs) override
+    {
+        if (region == nullptr || id < 0 || id >= LOCAL_OUTPUT_STREAMS)
+            return;
+        LocalStream &stream = region->streams[id];
+        uint64_t index = stream.count.load(std::memory_order_relaxed);
+        LocalSample sample{index, sampleTime, hostTime, receivedNs, data};
+        // Ring slot first, so a reader that sees the new count finds the sample.
+        stream.history[index % LOCAL_OUTPUT_HISTORY].Write(sample);
+        stream.count.store(index + 1, std::memory_order_release);
+        stream.latest.Write(sample);
+    }
+
+    void PublishPoses(int id, const PoseFrame &frame, uint64_t receivedNs) override
+    {
+        int slot = PoseSourceSlot(frame.source);
+        if (region == nullptr || id < 0 || id >= LOCAL_OUTPUT_STREAMS || slot < 0)
+            return;
+        LocalPoses poses;
+        poses.receivedNs = receivedNs;
+        poses.frame = frame;
+        region->streams[id].poses[slot].Write(poses);
+    }
+
+    void PublishGazeRay(int id, const GazeRay &ray, uint64_t receivedNs) override
+    {
+        if (region == nullptr || id < 0 || id >= LOCAL_OUTPUT_STREAMS)
+            return;
+        region->streams[id].gaze.Write(LocalGaze{receivedNs, ray});
+    }
+
+    void Stop() override
+    {
+        if (region == nullptr)
+            return;
+        region->closed.store(1, std::memory_order_release);
+        region = nullptr;
+        mapping.Close();
+    }
+
+private:
+    SharedMapping mapping;
+    LocalOutputRegion *region = nullptr;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "platform.h"
+#include "shared.cpp"
+#include "seqlock.h"
+#include "outputsink.h"
+#include "localoutput.h"
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+#ifndef SOCKETSINK_CPP
+#define SOCKETSINK_CPP
+
+// Sends every sample as a LocalRecord datagram to the consumers subscribed
+// on a Unix domain socket (see localoutput.h). POSIX only: Windows has no
+// datagram AF_UNIX sockets.
+class SocketSink : public OutputSink
+{
+public:
+    ~SocketSink() override { Stop(); }
+
+#ifdef _WIN32
+    bool Start(const char *)
+    {
+        std::cerr << "[IPC] Unix domain sockets are not available on Windows, use shm\n";
+        return false;
+    }
+
+    void StreamAdded(int) override {}
+    void StreamRemoved(int) override {}
+    void Publish(int, const EtData &, uint64_t, uint64_t, uint64_t) override {}
+    void Stop() override {}
+#else
+    bool Start(const char *socketPath)
+    {
+        sockaddr_un addr{};
+        if (std::strlen(socketPath) >= sizeof(addr.sun_path))
+        {
+            std::cerr << "[IPC] Socket path too long: " << socketPath << "\n";
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, socketPath);
+
+        sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (sock == INVALID_SOCKET)
+        {
+            std::cerr << "[IPC] Socket creation failed\n";
+            return false;
+        }
+        unlink(socketPath); // left behind by a host that did not exit cleanly
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+        {
+            std::cerr << "[IPC] Bind to " << socketPath << " failed\n";
+            CloseSocket(sock);
+            sock = INVALID_SOCKET;
+            return false;
+        }
+        path = socketPath;
+
+        running = true;
+        thread = std::thread(&SocketSink::Loop, this);
+        std::cout << "[IPC] Accepting subscribers on " << socketPath << "\n";
+        return true;
+    }
+
+    void StreamAdded(int) override {}
+    void StreamRemoved(int) override {}
+
+    void Publish(int id, const EtData &data, uint64_t sampleTime, uint64_t hostTime, uint64_t receivedNs) override
+    {
+        if (sock == INVALID_SOCKET || subscriberCount.load(std::memory_order_acquire) == 0)
+            return;
+
+        LocalRecord record{};
+        record.magic = LOCAL_SOCKET_MAGIC;
+        record.version = LOCAL_OUTPUT_VERSION;
+        record.stream = (uint32_t)id;
+        record.sample = LocalSample{0, sampleTime, hostTime, receivedNs, data};
+
+        for (Subscriber &subscriber : subscribers)
+        {
+            Peer peer;
+            if (subscriber.peer.Read(peer) == 0 || !peer.active)
+                continue;
+            if (sendto(sock, (const char *)&record, sizeof(record), MSG_DONTWAIT, (const sockaddr *)&peer.addr,
+                       peer.addrLen) == SOCKET_ERROR &&
+                !NetWouldBlock())
+                subscriber.gone.store(true, std::memory_order_relaxed); // the listener drops it
+        }
+    }
+
+    void Stop() override
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+        if (sock != INVALID_SOCKET)
+        {
+            CloseSocket(sock);
+            sock = INVALID_SOCKET;
+            unlink(path.c_str());
+        }
+    }
+
+private:
+    static const int MAX_SUBSCRIBERS = 16;
+
+    struct Peer
+    {
+        sockaddr_un addr;
+        socklen_t addrLen;
+        bool active;
+    };
+
+    // Written only by the listener thread; receive threads read it.
+    struct Subscriber
+    {
+        SeqLock<Peer> peer;
+        std::atomic<bool> gone{false};
+    };
+
+    void Loop()
+    {
+        while (running)
+        {
+            DropGone();
+
+            // Wake up now and then to notice Stop().
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+            timeval timeout{0, 200 * 1000};
+            if (select((int)sock + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+                continue;
+
+            LocalSubscribe request;
+            Peer from{};
+            from.addrLen = sizeof(from.addr);
+            int received = recvfrom(sock, (char *)&request, sizeof(request), 0, (sockaddr *)&from.addr, &from.addrLen);
+            if (received < (int)sizeof(request) || request.magic != LOCAL_SOCKET_MAGIC ||
+                from.addrLen <= sizeof(sa_family_t))
+                continue; // unbound senders cannot be answered
+
+            from.active = true;
+            int slot = Find(from);
+            if (request.kind == LOCAL_SUBSCRIBE && slot < 0)
+            {
+                slot = Find(Peer{});
+                if (slot < 0)
+                {
+                    std::cerr << "[IPC] Too many subscribers, ignoring " << from.addr.sun_path << "\n";
+                    continue;
+                }
+                subscribers[slot].gone.store(false, std::memory_order_relaxed);
+                subscribers[slot].peer.Write(from);
+                subscriberCount.fetch_add(1, std::memory_order_release);
+                std::cout << "[IPC] Subscribed " << from.addr.sun_path << "\n";
+            }
+            else if (request.kind == LOCAL_UNSUBSCRIBE && slot >= 0)
+            {
+                Remove(slot);
+            }
+        }
+    }
+
+    // Slot holding peer; an inactive Peer finds a free slot.
+    int Find(const Peer &peer) const
+    {
+        for (int i = 0; i < MAX_SUBSCRIBERS; ++i)
+        {
+            Peer current;
+            subscribers[i].peer.Read(current);
+            if (current.active != peer.active)
+                continue;
+            if (!peer.active ||
+                (current.addrLen == peer.addrLen && std::memcmp(&current.addr, &peer.addr, peer.addrLen) == 0))
+                return i;
+        }
+        return -1;
+    }
+
+    void DropGone()
+    {
+        for (int i = 0; i < MAX_SUBSCRIBERS; ++i)
+        {
+            if (subscribers[i].gone.load(std::memory_order_relaxed))
+                Remove(i);
+        }
+    }
+
+    void Remove(int slot)
+    {
+        Peer peer;
+        subscribers[slot].peer.Read(peer);
+        subscribers[slot].gone.store(false, std::memory_order_relaxed);
+        if (!peer.active)
+            return;
+        std::cout << "[IPC] Unsubscribed " << peer.addr.sun_path << "\n";
+        subscribers[slot].peer.Write(Peer{});
+        subscriberCount.fetch_sub(1, std::memory_order_release);
+    }
+
+    SOCKET sock = INVALID_SOCKET;
+    std::string path;
+    Subscriber subscribers[MAX_SUBSCRIBERS];
+    std::atomic<int> subscriberCount{0};
+    std::atomic<bool> running{false};
+    std::thread thread;
+#endif
+};
+
+#endif
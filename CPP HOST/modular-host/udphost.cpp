@@ -0,0 +1,330 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include "platform.h"
+#include "shared.cpp"
+#include "framing.h"
+#include "etcodec.h"
+#include "datagram.h"
+#include "latency.h"
+#include "recording.h"
+#include "outputstage.cpp"
+#include "lifecycle.h"
+
+#ifndef UDPHOST_CPP
+#define UDPHOST_CPP
+
+// Receives eye samples over UDP. Each headset is identified by its source
+// address; stale and reordered datagrams are dropped and loss, jitter and
+// one-way latency are printed every few seconds. A source silent for
+// UDP_SOURCE_TIMEOUT_NS gives its output stream back, so headsets that
+// reconnect from a new port or restart do not use up the streams.
+class UdpHost
+{
+public:
+    explicit UdpHost(StopToken &stopToken) : udpSocket(INVALID_SOCKET), stop(stopToken) {}
+
+    // busyPollUs > 0 spins in the driver before each receive sleeps (Linux only).
+    bool Start(uint16_t port = 54000, int busyPollUs = 0)
+    {
+        if (!NetStartup())
+        {
+            std::cerr << "[UDP] Network startup failed: " << NetLastError() << "\n";
+            return false;
+        }
+        if (!stop.Open())
+        {
+            std::cerr << "[UDP] Cannot create the stop socket\n";
+            NetCleanup();
+            return false;
+        }
+
+        udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (udpSocket == INVALID_SOCKET)
+        {
+            std::cerr << "[UDP] Socket creation failed\n";
+            stop.Close();
+            NetCleanup();
+            return false;
+        }
+
+        sockaddr_in serverAddr{};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = INADDR_ANY;
+        serverAddr.sin_port = htons(port);
+
+        SetReusePort(udpSocket);
+        // Wakes Receive() now and then without traffic, to expire silent sources.
+        SetReceiveTimeout(udpSocket, UDP_SWEEP_MS);
+        if (busyPollUs > 0 && !SetBusyPoll(udpSocket, busyPollUs))
+            std::cerr << "[UDP] Busy polling not available\n";
+
+        if (bind(udpSocket, (sockaddr *)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR)
+        {
+            std::cerr << "[UDP] Bind failed\n";
+            CloseSocket(udpSocket);
+            stop.Close();
+            NetCleanup();
+            return false;
+        }
+
+        // Receive() blocks in the socket itself; an empty datagram wakes it on stop.
+        sockaddr_in self = serverAddr;
+        self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        stop.WakeAlso(self);
+
+        std::cout << "[UDP] Listening on port " << port << "...\n";
+        return true;
+    }
+
+    // Also writes every accepted sample to recorder; call before Receive().
+    void RecordTo(Recorder *sampleRecorder)
+    {
+        recorder = sampleRecorder;
+    }
+
+    bool StartOutput(const OutputOptions &options = OutputOptions())
+    {
+        return output.Start(options);
+    }
+
+    // Runs until stop is requested, then takes what is still queued on the
+    // socket.
+    void Receive()
+    {
+        auto nextReport = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!stop.Requested())
+        {
+            int count = ReceiveBatch(true);
+            if (count < 0)
+            {
+                if (!stop.Requested())
+                {
+                    std::cerr << "[UDP] Receive failed\n";
+                    stop.Request();
+                }
+                break;
+            }
+            HandleBatch(count);
+
+            if (std::chrono::steady_clock::now() >= nextReport)
+            {
+                nextReport += std::chrono::seconds(5);
+                Report();
+            }
+            ExpireSources(MonotonicNs());
+        }
+
+        int count;
+        while ((count = ReceiveBatch(false)) > 0)
+            HandleBatch(count);
+    }
+
+    // Call once Receive() has returned.
+    void Stop()
+    {
+        if (udpSocket != INVALID_SOCKET)
+        {
+            CloseSocket(udpSocket);
+            udpSocket = INVALID_SOCKET;
+        }
+        output.Stop();
+        stop.Close();
+
+        NetCleanup();
+        std::cout << "[UDP] Stopped.\n";
+    }
+
+private:
+    struct Source
+    {
+        sockaddr_in addr;
+        int stream = -1;
+        uint64_t lastSeenNs = 0;
+        DatagramStats stats;
+        EtDecoder etDecoder;
+        LatencyHistogram captureToSend;
+        LatencyHistogram wire;
+    };
+
+    static const int UDP_BATCH = 32;
+    static const int UDP_SWEEP_MS = 1000;
+    static const uint64_t UDP_SOURCE_TIMEOUT_NS = 10000000000ULL;
+    static const size_t UDP_MAX_DATAGRAM = sizeof(DatagramHeader) + sizeof(FrameHeader) + FRAME_MAX_PAYLOAD;
+
+    struct Received
+    {
+        sockaddr_in from;
+        uint8_t data[UDP_MAX_DATAGRAM];
+        size_t length;
+    };
+
+    void HandleBatch(int count)
+    {
+        uint64_t now = MonotonicNs();
+        for (int i = 0; i < count; ++i)
+            HandleDatagram(batch[i].from, batch[i].data, batch[i].length, now);
+    }
+
+    // With wait, blocks for at least one datagram, or UDP_SWEEP_MS; otherwise
+    // returns 0 when none is queued. On Linux a single recvmmsg also takes whatever else is
+    // already queued, up to UDP_BATCH. Returns -1 on error, or when a stop
+    // signal interrupted the wait.
+    int ReceiveBatch(bool wait)
+    {
+#ifdef __linux__
+        mmsghdr msgs[UDP_BATCH];
+        iovec iov[UDP_BATCH];
+        std::memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < UDP_BATCH; ++i)
+        {
+            iov[i].iov_base = batch[i].data;
+            iov[i].iov_len = sizeof(batch[i].data);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &batch[i].from;
+            msgs[i].msg_hdr.msg_namelen = sizeof(batch[i].from);
+        }
+
+        int count;
+        do
+        {
+            count = recvmmsg(udpSocket, msgs, UDP_BATCH, wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+        } while (count < 0 && errno == EINTR && !stop.Requested());
+        if (count < 0 && (wait ? NetTimedOut() : NetWouldBlock()))
+            return 0;
+        for (int i = 0; i < count; ++i)
+            batch[i].length = msgs[i].msg_len;
+        return count;
+#else
+        if (!wait)
+            return 0; // the socket is blocking here; drain only on Linux
+        socklen_t fromLen = sizeof(batch[0].from);
+        int bytesReceived = recvfrom(udpSocket, (char *)batch[0].data, sizeof(batch[0].data), 0, (sockaddr *)&batch[0].from, &fromLen);
+        if (bytesReceived == SOCKET_ERROR)
+            return NetTimedOut() ? 0 : -1;
+        batch[0].length = (size_t)bytesReceived;
+        return 1;
+#endif
+    }
+
+    void HandleDatagram(const sockaddr_in &from, const uint8_t *data, size_t length, uint64_t now)
+    {
+        DatagramHeader dh;
+        FrameHeader hdr;
+        if (length < sizeof(dh) + sizeof(hdr))
+            return;
+        std::memcpy(&dh, data, sizeof(dh));
+        std::memcpy(&hdr, data + sizeof(dh), sizeof(hdr));
+        const uint8_t *payload = data + sizeof(dh) + sizeof(hdr);
+        if (dh.magic != DATAGRAM_MAGIC || hdr.magic != FRAME_MAGIC || hdr.version != FRAME_VERSION
+            || sizeof(dh) + sizeof(hdr) + hdr.length != length || FrameChecksum(hdr, payload) != hdr.checksum)
+        {
+            ++malformed;
+            return;
+        }
+
+        uint64_t key = ((uint64_t)from.sin_addr.s_addr << 16) | from.sin_port;
+        auto found = sources.find(key);
+        if (found == sources.end())
+        {
+            found = sources.emplace(key, Source()).first;
+            found->second.addr = from;
+            found->second.stream = output.AddStream();
+            if (found->second.stream < 0)
+                std::cout << "[UDP] " << Describe(from) << ": no free output stream, its samples are dropped\n";
+        }
+        Source &source = found->second;
+        source.lastSeenNs = now;
+        if (!source.stats.Accept(dh.sequence, dh.sendTime, now))
+            return;
+        if (dh.captureAgeUs != 0)
+            source.captureToSend.Record((int64_t)dh.captureAgeUs * 1000);
+        source.wire.Record(source.stats.lastLatencyNs);
+
+        EtSample sample{};
+        if (hdr.type == FRAME_LEGACY_MESSAGE && hdr.length == sizeof(Message))
+        {
+            Message msg;
+            std::memcpy(&msg, payload, sizeof(msg));
+            sample.trackingState = ET_TRACKING_BOTH_EYES;
+            sample.data = msg.etData;
+        }
+        else if (hdr.type == FRAME_ET_V2_KEY)
+        {
+            if (!source.etDecoder.Decode(hdr.type, payload, hdr.length, sample))
+                return;
+        }
+        else
+        {
+            return;
+        }
+
+        if (recorder)
+            recorder->Record(source.stream, sample, now);
+        output.Publish(source.stream, sample, now);
+    }
+
+    // Releases the output stream of every source not heard from for
+    // UDP_SOURCE_TIMEOUT_NS.
+    void ExpireSources(uint64_t now)
+    {
+        for (auto it = sources.begin(); it != sources.end();)
+        {
+            Source &source = it->second;
+            if (now - source.lastSeenNs < UDP_SOURCE_TIMEOUT_NS)
+            {
+                ++it;
+                continue;
+            }
+            std::cout << "[UDP] " << Describe(source.addr) << " (stream " << source.stream << ") silent for "
+                      << UDP_SOURCE_TIMEOUT_NS / 1000000000ULL << " s, stream released\n";
+            if (source.stream >= 0)
+                output.RemoveStream(source.stream);
+            it = sources.erase(it);
+        }
+    }
+
+    static std::string Describe(const sockaddr_in &addr)
+    {
+        char ip[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, (void *)&addr.sin_addr, ip, sizeof(ip));
+        return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+    }
+
+    void Report()
+    {
+        for (auto &entry : sources)
+        {
+            Source &source = entry.second;
+            const DatagramStats &s = source.stats;
+            double lossPct = s.Expected() ? 100.0 * s.Lost() / s.Expected() : 0.0;
+            std::cout << "[UDP] " << Describe(source.addr) << " (stream " << source.stream << ")"
+                      << " received=" << s.received << " lost=" << s.Lost() << " (" << lossPct << "%)"
+                      << " stale=" << s.stale << " jitter=" << s.jitterNs / 1e6 << "ms"
+                      << " latency=+" << s.latencyNs / 1e6 << "ms\n";
+
+            char captureLine[128], wireLine[128];
+            FormatLatency(captureLine, sizeof(captureLine), "capture->send", source.captureToSend);
+            FormatLatency(wireLine, sizeof(wireLine), "wire over min", source.wire);
+            std::cout << "[UDP]   " << captureLine << " | " << wireLine << "\n";
+            source.captureToSend.Reset();
+            source.wire.Reset();
+        }
+        if (malformed > 0)
+            std::cout << "[UDP] malformed datagrams: " << malformed << "\n";
+    }
+
+    SOCKET udpSocket;
+    StopToken &stop;
+    std::unique_ptr<Received[]> batch{new Received[UDP_BATCH]};
+    OutputStage output;
+    Recorder *recorder = nullptr;
+    std::map<uint64_t, Source> sources;
+    uint64_t malformed = 0;
+};
+
+#endif
@@ -90,6 +90,41 @@ namespace PVRSampleFW {
         }
     }
 
+    enum class EyeStreamTransport {
+        Tcp,
+        Udp,
+    };
+
+    inline EyeStreamTransport GetEyeStreamTransport(const std::string& transportStr) {
+        if (EqualsIgnoreCase(transportStr, "Tcp")) {
+            return EyeStreamTransport::Tcp;
+        }
+        if (EqualsIgnoreCase(transportStr, "Udp")) {
+            return EyeStreamTransport::Udp;
+        }
+        throw std::invalid_argument(Fmt("Unknown eye stream transport '%s'", transportStr.c_str()));
+    }
+
+    /// What the eye sender does when its outgoing queue is full because the link stalls.
+    enum class OverflowPolicy {
+        DropOldest,        // discard the oldest queued sample
+        CoalesceLatest,    // discard everything queued, keep only the newest sample
+        BlockWithTimeout,  // wait up to block_timeout_ms for the socket, then drop oldest
+    };
+
+    inline OverflowPolicy GetOverflowPolicy(const std::string& policyStr) {
+        if (EqualsIgnoreCase(policyStr, "DropOldest")) {
+            return OverflowPolicy::DropOldest;
+        }
+        if (EqualsIgnoreCase(policyStr, "CoalesceLatest")) {
+            return OverflowPolicy::CoalesceLatest;
+        }
+        if (EqualsIgnoreCase(policyStr, "BlockWithTimeout")) {
+            return OverflowPolicy::BlockWithTimeout;
+        }
+        throw std::invalid_argument(Fmt("Unknown overflow policy '%s'", policyStr.c_str()));
+    }
+
     struct Configurations {
         std::string graphics_plugin{"OpenGLES"};
 
@@ -109,6 +144,23 @@ namespace PVRSampleFW {
         int perf_setting_gpu_level{3};
         bool use_input_handling{true};
 
+        int eye_sample_rate_hz{90};
+        // 1: send every sample only while the eyes move, else eye_idle_rate_hz,
+        // slowing to eye_keepalive_rate_hz as the host reports a poor link
+        bool eye_adaptive_rate{true};
+        int eye_idle_rate_hz{10};
+        int eye_keepalive_rate_hz{2};
+        std::string eye_stream_transport{"Tcp"};
+        std::string eye_send_overflow_policy{"DropOldest"};
+        int eye_send_block_timeout_ms{5};
+        // empty: find the host through a broadcast probe on eye_discovery_port
+        std::string eye_host_address{""};
+        int eye_host_port{54000};
+        int eye_discovery_port{54001};
+        // reconnect attempts back off exponentially between these bounds
+        int eye_reconnect_min_ms{250};
+        int eye_reconnect_max_ms{10000};
+
         struct ConfigParsed {
             XrFormFactor formfactor{XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY};
 
@@ -129,6 +181,53 @@ namespace PVRSampleFW {
             parsed.targetrefreshrate = std::stof(target_refresh_rate);
         }
 
+        /// Names accepted by SetEyeStreamOption, for loaders that have to ask for each key.
+        static const std::vector<std::string>& EyeStreamOptionNames() {
+            static const std::vector<std::string> names{"eye_sample_rate_hz",        "eye_stream_transport",
+                                                        "eye_send_overflow_policy",  "eye_send_block_timeout_ms",
+                                                        "eye_host_address",          "eye_host_port",
+                                                        "eye_discovery_port",        "eye_reconnect_min_ms",
+                                                        "eye_reconnect_max_ms",      "eye_adaptive_rate",
+                                                        "eye_idle_rate_hz",          "eye_keepalive_rate_hz"};
+            return names;
+        }
+
+        /// Sets one eye stream option by name, as read from a config file or an intent
+        /// extra. Returns false for unknown names; throws std::invalid_argument for bad values,
+        /// leaving the option as it was.
+        bool SetEyeStreamOption(const std::string& name, const std::string& value) {
+            if (name == "eye_stream_transport") {
+                GetEyeStreamTransport(value);
+                eye_stream_transport = value;
+            } else if (name == "eye_send_overflow_policy") {
+                GetOverflowPolicy(value);
+                eye_send_overflow_policy = value;
+            } else if (name == "eye_host_address") {
+                eye_host_address = value;
+            } else if (name == "eye_sample_rate_hz") {
+                eye_sample_rate_hz = std::stoi(value);
+            } else if (name == "eye_adaptive_rate") {
+                eye_adaptive_rate = std::stoi(value) != 0;
+            } else if (name == "eye_idle_rate_hz") {
+                eye_idle_rate_hz = std::stoi(value);
+            } else if (name == "eye_keepalive_rate_hz") {
+                eye_keepalive_rate_hz = std::stoi(value);
+            } else if (name == "eye_send_block_timeout_ms") {
+                eye_send_block_timeout_ms = std::stoi(value);
+            } else if (name == "eye_host_port") {
+                eye_host_port = std::stoi(value);
+            } else if (name == "eye_discovery_port") {
+                eye_discovery_port = std::stoi(value);
+            } else if (name == "eye_reconnect_min_ms") {
+                eye_reconnect_min_ms = std::stoi(value);
+            } else if (name == "eye_reconnect_max_ms") {
+                eye_reconnect_max_ms = std::stoi(value);
+            } else {
+                return false;
+            }
+            return true;
+        }
+
         void SetEnvironmentBlendMode(XrEnvironmentBlendMode envBlm) {
             environment_blend_mode = GetXrEnvironmentBlendModeStr(envBlm);
             parsed.environmentblendmode = envBlm;
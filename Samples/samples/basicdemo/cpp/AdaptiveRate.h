@@ -0,0 +1,166 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#ifndef PICONATIVEOPENXRSAMPLES_ADAPTIVERATE_H
+#define PICONATIVEOPENXRSAMPLES_ADAPTIVERATE_H
+
+#include <atomic>
+#include <cmath>
+#include "LogUtils.h"
+#include "etcodec.h"
+
+/// Picks which eye samples go to the host, so the radio wakes up for movement
+/// rather than for every tick. The tracker is still read at the full sampler
+/// rate, so a saccade or blink shows up within one tick: once a channel moved
+/// further than its threshold from what the host last got, or the tracking
+/// state changed, every sample goes out until kHoldNs after the last change.
+/// While the eyes fixate, only one sample per idle interval does. When movement
+/// starts, the sample before it goes out first, so the host sees where it began
+/// instead of interpolating across the idle gap.
+///
+/// The host's link reports stretch the idle interval towards the keep-alive
+/// one, and on a congested link halve the rate during movement too. At least
+/// one sample per keep-alive interval always goes out.
+///
+/// Configure() before the sampler starts; Admit() and LogStats() on the sampler
+/// thread, SetLink() on the sender thread.
+class AdaptiveRate {
+public:
+    void Configure(bool on, int idleRateHz, int keepAliveRateHz) {
+        enabled = on;
+        keepAliveRateHz = keepAliveRateHz > 0 ? keepAliveRateHz : 1;
+        idleRateHz = idleRateHz > keepAliveRateHz ? idleRateHz : keepAliveRateHz;
+        idleNs = 1000000000LL / idleRateHz;
+        keepAliveNs = 1000000000LL / keepAliveRateHz;
+        hasSent = false;
+        stats = {};
+        if (enabled) {
+            PLOGI("[DEBUGGING] Adaptive rate: every sample while the eyes move, %d Hz at rest, %d Hz keep-alive",
+                  idleRateHz, keepAliveRateHz);
+        }
+    }
+
+    /// The host's latest view of the link; zeros while there is none.
+    void SetLink(uint32_t roundTripUs, uint32_t lossPermille) {
+        float latency = (float) ((int64_t) roundTripUs - kGoodRoundTripUs) / (kBadRoundTripUs - kGoodRoundTripUs);
+        float loss = (float) lossPermille / kBadLossPermille;
+        float pressure = latency > loss ? latency : loss;
+        linkPressure.store(pressure < 0.0f ? 0.0f : (pressure > 1.0f ? 1.0f : pressure), std::memory_order_relaxed);
+        linkRoundTripUs.store(roundTripUs, std::memory_order_relaxed);
+        linkLossPermille.store(lossPermille, std::memory_order_relaxed);
+    }
+
+    /// Decides on one fresh sample, taken periodNs after the previous one. Fills
+    /// out with what to send, oldest first, and returns how many: 0 to 2. No
+    /// allocation, no logging.
+    int Admit(const EtSample &sample, int64_t periodNs, EtSample out[2]) {
+        stats.samples++;
+        if (!enabled || !hasSent) {
+            out[0] = sample;
+            Sent(sample);
+            return 1;
+        }
+
+        auto now = (int64_t) sample.time;
+        bool changed = Changed(sample);
+        bool starting = changed && now >= activeUntil;
+        if (changed) {
+            activeUntil = now + kHoldNs;
+        }
+        bool active = now < activeUntil;
+        float pressure = linkPressure.load(std::memory_order_relaxed);
+        int64_t spacing;
+        if (active) {
+            stats.active++;
+            spacing = pressure >= kCongested ? periodNs * 3 / 2 : 0;
+        } else {
+            spacing = idleNs + (int64_t) (pressure * (float) (keepAliveNs - idleNs));
+        }
+
+        int count = 0;
+        int64_t sinceSent = now - (int64_t) lastSent.time;
+        if (sinceSent >= spacing || sinceSent < 0) {
+            if (starting && hasHeld && held.time != lastSent.time) {
+                out[count++] = held;
+                stats.sent++;
+            }
+            out[count++] = sample;
+            Sent(sample);
+        }
+        held = sample;
+        hasHeld = true;
+        return count;
+    }
+
+    /// One line with the counters since the last call, then resets them.
+    void LogStats() {
+        if (!enabled || stats.samples == 0) {
+            return;
+        }
+        PLOGI("[DEBUGGING] Adaptive rate: sent %llu of %llu samples, moving %.0f%% of the time | "
+              "link round trip %.1fms, %.1f%% pings late, pressure %.2f",
+              (unsigned long long) stats.sent, (unsigned long long) stats.samples,
+              100.0 * stats.active / stats.samples, linkRoundTripUs.load(std::memory_order_relaxed) / 1e3,
+              linkLossPermille.load(std::memory_order_relaxed) / 10.0, linkPressure.load(std::memory_order_relaxed));
+        stats = {};
+    }
+
+private:
+    /// Whether sample differs from the last one sent by more than noise, per
+    /// channel in the units of EtData.
+    bool Changed(const EtSample &sample) const {
+        if (sample.trackingState != lastSent.trackingState) {
+            return true;
+        }
+        const float *values = (const float *) &sample.data;
+        const float *sent = (const float *) &lastSent.data;
+        for (int i = 0; i < ET_CHANNELS; i++) {
+            if (std::fabs(values[i] - sent[i]) > kChangeThreshold[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Sent(const EtSample &sample) {
+        lastSent = sample;
+        hasSent = true;
+        stats.sent++;
+    }
+
+    /// Openness moves by far more than this within one tick of a blink, and the
+    /// canthus points follow a saccade; fixational jitter stays below.
+    static constexpr float kChangeThreshold[ET_CHANNELS] = {
+            0.02f, 0.02f,                   // openness
+            0.1f, 0.1f,                     // pupil dilation, mm
+            0.005f, 0.005f, 0.005f, 0.005f, // canthus uvs
+    };
+    static constexpr int64_t kHoldNs = 100000000;  // a blink reopens and a saccade settles within this
+    // Link pressure ramps from 0 to 1 between these, whichever is worse.
+    static constexpr int64_t kGoodRoundTripUs = 20000;
+    static constexpr int64_t kBadRoundTripUs = 150000;
+    static constexpr float kBadLossPermille = 100.0f;
+    static constexpr float kCongested = 0.5f;  // from here on, movement goes at half rate
+
+    struct Stats {
+        uint64_t samples;
+        uint64_t sent;
+        uint64_t active;  // samples taken while the eyes moved
+    };
+
+    bool enabled = false;
+    int64_t idleNs = 100000000;
+    int64_t keepAliveNs = 500000000;
+    EtSample lastSent{};
+    bool hasSent = false;
+    EtSample held{};  // the latest sample, sent or not
+    bool hasHeld = false;
+    int64_t activeUntil = 0;
+    Stats stats{};
+    std::atomic<float> linkPressure{0.0f};
+    std::atomic<uint32_t> linkRoundTripUs{0};
+    std::atomic<uint32_t> linkLossPermille{0};
+};
+
+#endif //PICONATIVEOPENXRSAMPLES_ADAPTIVERATE_H
@@ -29,6 +29,11 @@
 #include <unistd.h>
 #include "TcpClientV2.h"
 #include "EyeTrackerHandler.h"
+#include "FaceTrackerHandler.h"
+#include "PoseTrackerHandler.h"
+#include "GazeRayHandler.h"
+#include "EyeSampler.h"
+#include "EyeStreamConfig.h"
 // #include "OpenXrEyeTrackerHandler.h"
 
 using namespace PVRSampleFW;
@@ -40,7 +45,16 @@ public:
     explicit BasicDemo(const std::shared_ptr<PVRSampleFW::Configurations> &appConfigParam)
             : AndroidOpenXrProgram(appConfigParam) {
         PLOGI("[DEBUGGING] BasicDemo");
-        TcpClient::OpenConnection();
+        ConnectionSettings connection;
+        connection.hostAddress = appConfigParam->eye_host_address;
+        connection.port = (uint16_t) appConfigParam->eye_host_port;
+        connection.discoveryPort = (uint16_t) appConfigParam->eye_discovery_port;
+        connection.udp = GetEyeStreamTransport(appConfigParam->eye_stream_transport) == EyeStreamTransport::Udp;
+        connection.reconnectMinMs = appConfigParam->eye_reconnect_min_ms;
+        connection.reconnectMaxMs = appConfigParam->eye_reconnect_max_ms;
+        TcpClient::Configure(connection);
+        TcpClient::SetOverflowPolicy(GetOverflowPolicy(appConfigParam->eye_send_overflow_policy),
+                                     appConfigParam->eye_send_block_timeout_ms);
     }
 
     BasicDemo() : AndroidOpenXrProgram() {
@@ -48,8 +62,12 @@ public:
     }
 
     virtual ~BasicDemo() {
+        EyeSampler::Stop();
         TcpClient::CloseConnection();
         EyeTrackerHandler::DisposeTracker();
+        FaceTrackerHandler::DisposeTracker();
+        PoseTrackerHandler::DisposeTracker();
+        GazeRayHandler::DisposeTracker();
     };
 
     bool CustomizedAppPostInit() override {
@@ -62,11 +80,25 @@ public:
         // AddSimpleMesh();
         // SetupGltfModel();
 
-        // EyeTrackerHandler::Initialize(this);
+        EyeSampler::SetAdaptiveRate(app_config_->eye_adaptive_rate, app_config_->eye_idle_rate_hz,
+                                    app_config_->eye_keepalive_rate_hz);
+        EyeSampler::Start(this, app_config_->eye_sample_rate_hz);
 
         return true;
     }
 
+    bool CustomizedXrEventHandlerSetup() override {
+        PLOGI("[DEBUGGING] CustomizedXrEventHandlerSetup");
+        // Motion trackers connect and disconnect at any time; the pose handler
+        // keeps track of which are there.
+        for (XrStructureType type : {XR_TYPE_EVENT_DATA_REQUEST_MOTION_TRACKER_COMPLETE_PICO,
+                                     XR_TYPE_EVENT_DATA_MOTION_TRACKER_CONNECTION_STATE_CHANGED_PICO}) {
+            RegisterXrEventHandler({type, [](BasicOpenXrWrapper *, const XrEventDataBaseHeader *eventData, bool *,
+                                             bool *) { PoseTrackerHandler::HandleEvent(eventData); }});
+        }
+        return true;
+    }
+
     bool CustomizedXrInputHandlerSetup() override {
         PLOGI("[DEBUGGING] CustomizedXrInputHandlerSetup");
 
@@ -76,6 +108,8 @@ public:
         auto handleInputFunc = [](class BasicOpenXrWrapper *openxr,
                                   const PVRSampleFW::XrFrameIn &frameIn) {
             auto pOpenXrAppWrapper = dynamic_cast<BasicDemo *>(openxr);
+            // Eye data is sampled on its own thread; only hand it the frame timing.
+            EyeSampler::PublishFrameTime(frameIn.predicted_display_time);
             for (int hand = 0; hand < Side::COUNT; hand++) {
                 if (frameIn.controller_actives[hand]) {
                     auto triggerValue = frameIn.controller_trigger_value[hand];
@@ -84,11 +118,6 @@ public:
                     auto scale = 1.0f - 0.5f * triggerValue;
                     pOpenXrAppWrapper->SetControllerScale(hand, scale);
 
-
-                    auto etData = EyeTrackerHandler::ProcessData(openxr);
-                    // OpenXrEyeTrackerHandler::Initialize();
-                    TcpClient::SendMessage(frameIn.all_touches_bitmask, etData);
-
                     // Apply a vibration feedback to the controller
                     // if (frameIn.all_touches_bitmask) {
                     //     PLOGI("[DEBUGGING] frameIn.all_touches_bitmask: %d",
@@ -138,6 +167,23 @@ public:
 
         AndroidOpenXrProgram::CustomizedExtensionAndFeaturesInit();
         // TODO：non-plugin extensions
+        // Face tracking is optional; asking for an extension the runtime lacks fails the instance.
+        if (IsExtensionSupported(XR_FB_FACE_TRACKING2_EXTENSION_NAME)) {
+            non_plugin_extensions_.push_back(XR_FB_FACE_TRACKING2_EXTENSION_NAME);
+        }
+        // So are body tracking and motion trackers.
+        if (IsExtensionSupported(XR_BD_BODY_TRACKING_EXTENSION_NAME)) {
+            non_plugin_extensions_.push_back(XR_BD_BODY_TRACKING_EXTENSION_NAME);
+        }
+        if (IsExtensionSupported(XR_PICO_MOTION_TRACKING_EXTENSION_NAME)) {
+            non_plugin_extensions_.push_back(XR_PICO_MOTION_TRACKING_EXTENSION_NAME);
+        }
+        // The gaze ray: per-eye gaze where offered, else the combined gaze the
+        // framework binds once told the runtime has it.
+        if (IsExtensionSupported(XR_FB_EYE_TRACKING_SOCIAL_EXTENSION_NAME)) {
+            non_plugin_extensions_.push_back(XR_FB_EYE_TRACKING_SOCIAL_EXTENSION_NAME);
+        }
+        eye_tracking_supported_ = IsExtensionSupported(XR_EXT_EYE_GAZE_INTERACTION_EXTENSION_NAME);
 
         // TODO：setup your customized feature plugins here
         // 1. extension features
@@ -425,6 +471,7 @@ void android_main(struct android_app *app) {
     auto config = std::make_shared<Configurations>();
     /// you can set customized config here
     /*config->environment_blend_mode = "AlphaBlend";*/
+    EyeStreamConfig::Load(*config, app);
     auto program = std::make_shared<BasicDemo>(config);
     program->Run(app);
 }
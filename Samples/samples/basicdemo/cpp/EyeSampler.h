@@ -0,0 +1,301 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#ifndef PICONATIVEOPENXRSAMPLES_EYESAMPLER_H
+#define PICONATIVEOPENXRSAMPLES_EYESAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "AdaptiveRate.h"
+#include "EyeTrackerHandler.h"
+#include "FaceTrackerHandler.h"
+#include "GazeRayHandler.h"
+#include "PoseTrackerHandler.h"
+#include "SpscRing.h"
+#include "seqlock.h"
+#include "TcpClientV2.h"
+
+/// Samples the eye tracker on its own thread at a fixed rate, independent of the
+/// controllers and of the render loop. Samples go through a lock-free SPSC ring
+/// to a sender thread, so socket I/O never runs on the frame thread. Where the
+/// runtime has face tracking, the same tick reads the face too; as only the
+/// newest face matters, it goes through a SeqLock slot the next reading
+/// overwrites, and the sender takes whatever is there when the version moved.
+/// Body joints, motion trackers and the combined gaze ray likewise. Eye
+/// samples pass AdaptiveRate on their way to the ring.
+class EyeSampler {
+public:
+    /// Call before Start(); adaptive sending is off until then.
+    static void SetAdaptiveRate(bool enabled, int idleRateHz, int keepAliveRateHz) {
+        adaptiveRate.Configure(enabled, idleRateHz, keepAliveRateHz);
+        TcpClient::SetLinkReportsWanted(enabled);
+    }
+
+    static void Start(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper, int rateHz) {
+        if (running) return;
+
+        // Resolve the tracker on the calling thread; the sampler only reads it.
+        EyeTrackerHandler::Initialize(openxr_wrapper);
+        if (FaceTrackerHandler::Initialize(openxr_wrapper)) {
+            TcpClient::SetBlendshapeDictionary(&FaceTrackerHandler::Dictionary());
+        }
+        TcpClient::SetPosesOffered(PoseTrackerHandler::Initialize(openxr_wrapper));
+        TcpClient::SetGazeOffered(GazeRayHandler::Initialize(openxr_wrapper));
+
+        openxr = openxr_wrapper;
+        periodNs = 1000000000LL / (rateHz > 0 ? rateHz : 90);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        running = true;
+        samplerThread = std::thread(SampleLoop);
+        senderThread = std::thread(SendLoop);
+        PLOGI("[DEBUGGING] Eye sampler started at %d Hz", rateHz);
+    }
+
+    static void Stop() {
+        if (!running) return;
+        running = false;
+        Wake();
+        samplerThread.join();
+        senderThread.join();
+        close(wakeFd);
+        wakeFd = -1;
+        PLOGI("[DEBUGGING] Eye sampler stopped, %llu samples dropped",
+              (unsigned long long) droppedSamples.load());
+    }
+
+    /// Called once per frame with the frame's predicted display time. Samples
+    /// taken between frames are stamped relative to it.
+    static void PublishFrameTime(XrTime predictedDisplayTime) {
+        frameTimeAt.store((int64_t) MonotonicNs(), std::memory_order_relaxed);
+        frameTime.store(predictedDisplayTime, std::memory_order_release);
+    }
+
+private:
+    /// Applies the host's control requests; runs on the sender thread.
+    static bool ApplyControl(uint8_t command, uint32_t &value) {
+        switch (command) {
+            case CONTROL_SET_RATE:
+                value = value < kMinRateHz ? kMinRateHz : (value > kMaxRateHz ? kMaxRateHz : value);
+                periodNs = 1000000000LL / value;
+                PLOGI("[DEBUGGING] Host set the sample rate to %u Hz", value);
+                return true;
+            case CONTROL_SET_CHANNELS:
+                value &= CONTROL_ALL_CHANNELS;
+                EyeTrackerHandler::SetChannelMask((uint8_t) value);
+                PLOGI("[DEBUGGING] Host set the channel mask to 0x%02x", value);
+                return true;
+            case CONTROL_RECALIBRATE:
+                recalibrateRequested = true;
+                PLOGI("[DEBUGGING] Host asked to restart the eye tracker");
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Now in XrTime, extrapolated from the last frame's display time; 0 before
+    /// the first frame. Samples and time sync answers both use it, so the host's
+    /// clock mapping fits the sample times.
+    static int64_t HeadsetNow() {
+        XrTime displayTime = frameTime.load(std::memory_order_acquire);
+        if (displayTime == 0) {
+            return 0;
+        }
+        return displayTime + ((int64_t) MonotonicNs() - frameTimeAt.load(std::memory_order_relaxed));
+    }
+
+    static void SampleLoop() {
+        EtSample sample = {};
+        EtSample admitted[2];
+        BlendshapeFrame face;
+        PoseFrame poses;
+        GazeRay gaze;
+        auto next = std::chrono::steady_clock::now();
+        auto nextReport = next + kStatsInterval;
+        while (running) {
+            next += std::chrono::nanoseconds(periodNs.load(std::memory_order_relaxed));
+            std::this_thread::sleep_until(next);
+            if (recalibrateRequested.exchange(false)) {
+                EyeTrackerHandler::Recreate(openxr);
+                next = std::chrono::steady_clock::now();
+            }
+            if (next >= nextReport) {
+                nextReport += kStatsInterval;
+                EyeTrackerHandler::LogStats();
+                FaceTrackerHandler::LogStats();
+                PoseTrackerHandler::LogStats();
+                GazeRayHandler::LogStats();
+                adaptiveRate.LogStats();
+            }
+
+            if (frameTime.load(std::memory_order_acquire) == 0) {
+                continue;  // no frame yet, session is not running
+            }
+            // One wake-up per tick, however much of it was published.
+            XrTime now = HeadsetNow();
+            bool published = false;
+            if (FaceTrackerHandler::ProcessData(now, face)) {
+                faceSlot.Write(face);
+                published = true;
+            }
+            if (GazeRayHandler::ProcessData(now, gaze)) {
+                gazeSlot.Write(gaze);
+                published = true;
+            }
+            if (PoseTrackerHandler::ProcessBody(now, poses)) {
+                poseSlots[PoseSourceSlot(poses.source)].Write(poses);
+                published = true;
+            }
+            if (PoseTrackerHandler::ProcessTrackers(now, poses)) {
+                poseSlots[PoseSourceSlot(poses.source)].Write(poses);
+                published = true;
+            }
+            // An untracked eye (e.g. the session lost focus) is counted by the handler.
+            if (EyeTrackerHandler::ProcessData(now, sample)) {
+                int count = adaptiveRate.Admit(sample, periodNs.load(std::memory_order_relaxed), admitted);
+                for (int i = 0; i < count; i++) {
+                    if (ring.TryPush(admitted[i])) {
+                        published = true;
+                    } else {
+                        droppedSamples++;
+                    }
+                }
+            }
+            if (published) {
+                Wake();
+            }
+        }
+    }
+
+    static void SendLoop() {
+        EtSample sample;
+        BlendshapeFrame face;
+        PoseFrame poses;
+        GazeRay gaze;
+        uint32_t faceVersion = 0, gazeVersion = 0, poseVersion[POSE_SOURCE_COUNT] = {};
+        auto nextReport = std::chrono::steady_clock::now() + kStatsInterval;
+        while (running) {
+            if (!TcpClient::MaintainConnection()) {
+                // No host yet or it went away: keep queuing until the next attempt.
+                WaitForSample(TcpClient::MillisUntilReconnect());
+            } else if (TcpClient::WaitForWork(wakeFd, kWaitMs)) {
+                // Woken by new samples; the host's requests and a stalled link
+                // draining wake it as well, so pings are answered without waiting
+                // for the next sample, even when there is none.
+                TakeWake();
+            }
+
+            TcpClient::PollControl(ApplyControl, HeadsetNow);
+            LinkQuality link = TcpClient::Link();
+            adaptiveRate.SetLink(link.roundTripUs, link.lossPermille);
+            while (ring.TryPop(sample)) {
+                TcpClient::Enqueue(sample);
+            }
+            if (gazeSlot.Version() != gazeVersion) {
+                gazeVersion = gazeSlot.Read(gaze);
+                TcpClient::EnqueueGazeRay(gaze);
+            }
+            if (faceSlot.Version() != faceVersion) {
+                faceVersion = faceSlot.Read(face);
+                TcpClient::EnqueueBlendshapes(face);
+            }
+            for (int slot = 0; slot < POSE_SOURCE_COUNT; slot++) {
+                if (poseSlots[slot].Version() != poseVersion[slot]) {
+                    poseVersion[slot] = poseSlots[slot].Read(poses);
+                    TcpClient::EnqueuePoses(poses);
+                }
+            }
+            TcpClient::Flush();  // on failure the next MaintainConnection() reconnects
+
+            if (std::chrono::steady_clock::now() >= nextReport) {
+                nextReport += kStatsInterval;
+                SenderStats stats = TcpClient::Stats();
+                PLOGI("[DEBUGGING] Sender: %s connects=%llu queue=%zu sent=%llu dropped=%llu calls=%llu latency avg=%.2fms max=%.2fms",
+                      stats.connected ? "connected" : "disconnected", (unsigned long long) stats.connects,
+                      stats.queueDepth, (unsigned long long) stats.samplesSent,
+                      (unsigned long long) stats.samplesDropped, (unsigned long long) stats.sendCalls,
+                      stats.avgLatencyNs / 1e6, stats.maxLatencyNs / 1e6);
+                if (FaceTrackerHandler::Available()) {
+                    PLOGI("[DEBUGGING] Sender: face frames sent=%llu replaced=%llu",
+                          (unsigned long long) stats.faceFramesSent, (unsigned long long) stats.faceFramesReplaced);
+                }
+                if (GazeRayHandler::Available()) {
+                    PLOGI("[DEBUGGING] Sender: gaze rays sent=%llu replaced=%llu",
+                          (unsigned long long) stats.gazeRaysSent, (unsigned long long) stats.gazeRaysReplaced);
+                }
+                if (PoseTrackerHandler::Available()) {
+                    PLOGI("[DEBUGGING] Sender: pose frames sent=%llu replaced=%llu",
+                          (unsigned long long) stats.poseFramesSent, (unsigned long long) stats.poseFramesReplaced);
+                }
+                char captureLine[128];
+                FormatLatency(captureLine, sizeof(captureLine), "capture->send", TcpClient::CaptureToSend());
+                PLOGI("[DEBUGGING] Sender: %s", captureLine);
+                TcpClient::CaptureToSend().Reset();
+            }
+        }
+    }
+
+    /// Tells the sender there is something to send. The eventfd adds up any
+    /// number of these into one wake-up.
+    static void Wake() {
+        uint64_t one = 1;
+        write(wakeFd, &one, sizeof(one));
+    }
+
+    /// Clears the wake-ups so far; the sender drains everything after it.
+    static void TakeWake() {
+        uint64_t count;
+        read(wakeFd, &count, sizeof(count));
+    }
+
+    /// Sleeps until a sample arrives or timeoutMs passes; -1 waits without limit.
+    static void WaitForSample(int timeoutMs) {
+        pollfd pfd{wakeFd, POLLIN, 0};
+        if (poll(&pfd, 1, timeoutMs) > 0) {
+            TakeWake();
+        }
+    }
+
+    static constexpr std::chrono::seconds kStatsInterval{5};
+    static constexpr uint32_t kMinRateHz = 1;
+    static constexpr uint32_t kMaxRateHz = 1000;
+    static constexpr int kWaitMs = 1000;  // rechecks a link that neither moves nor fails
+
+    static PVRSampleFW::BasicOpenXrWrapper *openxr;
+    static AdaptiveRate adaptiveRate;
+    static std::atomic<int64_t> periodNs;
+    static std::atomic<bool> recalibrateRequested;
+    static std::atomic<bool> running;
+    static std::atomic<XrTime> frameTime;
+    static std::atomic<int64_t> frameTimeAt;
+    static std::atomic<uint64_t> droppedSamples;
+    static SpscRing<EtSample, 256> ring;
+    static SeqLock<BlendshapeFrame> faceSlot;
+    static SeqLock<PoseFrame> poseSlots[POSE_SOURCE_COUNT];  // at PoseSourceSlot(source)
+    static SeqLock<GazeRay> gazeSlot;
+    static int wakeFd;  // eventfd, readable while the sender has work
+    static std::thread samplerThread;
+    static std::thread senderThread;
+};
+PVRSampleFW::BasicOpenXrWrapper *EyeSampler::openxr = nullptr;
+AdaptiveRate EyeSampler::adaptiveRate;
+std::atomic<int64_t> EyeSampler::periodNs{11111111};
+std::atomic<bool> EyeSampler::recalibrateRequested{false};
+std::atomic<bool> EyeSampler::running{false};
+std::atomic<XrTime> EyeSampler::frameTime{0};
+std::atomic<int64_t> EyeSampler::frameTimeAt{0};
+std::atomic<uint64_t> EyeSampler::droppedSamples{0};
+SpscRing<EtSample, 256> EyeSampler::ring;
+SeqLock<BlendshapeFrame> EyeSampler::faceSlot;
+SeqLock<PoseFrame> EyeSampler::poseSlots[POSE_SOURCE_COUNT];
+SeqLock<GazeRay> EyeSampler::gazeSlot;
+int EyeSampler::wakeFd = -1;
+std::thread EyeSampler::samplerThread;
+std::thread EyeSampler::senderThread;
+
+#endif //PICONATIVEOPENXRSAMPLES_EYESAMPLER_H
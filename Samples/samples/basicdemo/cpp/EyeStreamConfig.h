@@ -0,0 +1,113 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#ifndef PICONATIVEOPENXRSAMPLES_EYESTREAMCONFIG_H
+#define PICONATIVEOPENXRSAMPLES_EYESTREAMCONFIG_H
+
+#include "LogUtils.h"
+#include "Configurations.h"
+#include <fstream>
+#include <string>
+#include <jni.h>
+#include <android_native_app_glue.h>
+
+/// Overrides the eye stream options in Configurations at launch, so the host
+/// can change per network without rebuilding the APK. Two sources, the later
+/// winning:
+///
+///   <external files dir>/eye_stream.cfg   "name=value" lines, '#' comments, e.g.
+///       adb push eye_stream.cfg /sdcard/Android/data/<package>/files/
+///   intent string extras with the same names, e.g.
+///       adb shell am start -n <package>/<activity> --es eye_host_address 192.168.1.20
+///
+/// Names are the Configurations fields (Configurations::EyeStreamOptionNames).
+class EyeStreamConfig {
+public:
+    static void Load(PVRSampleFW::Configurations &config, android_app *app) {
+        if (app->activity->externalDataPath != nullptr) {
+            LoadFile(config, std::string(app->activity->externalDataPath) + "/eye_stream.cfg");
+        }
+        LoadIntentExtras(config, app);
+    }
+
+    static void LoadFile(PVRSampleFW::Configurations &config, const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            return;
+        }
+        PLOGI("[DEBUGGING] Reading eye stream options from %s", path.c_str());
+
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+            size_t equals = line.find('=');
+            if (equals == std::string::npos) {
+                continue;
+            }
+            Apply(config, Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)));
+        }
+    }
+
+private:
+    static void LoadIntentExtras(PVRSampleFW::Configurations &config, android_app *app) {
+        JNIEnv *env = nullptr;
+        app->activity->vm->AttachCurrentThread(&env, nullptr);
+        if (env == nullptr) {
+            return;
+        }
+
+        jobject activity = app->activity->clazz;
+        jclass activityClass = env->GetObjectClass(activity);
+        jmethodID getIntent = env->GetMethodID(activityClass, "getIntent", "()Landroid/content/Intent;");
+        jobject intent = getIntent != nullptr ? env->CallObjectMethod(activity, getIntent) : nullptr;
+        if (intent != nullptr) {
+            jclass intentClass = env->GetObjectClass(intent);
+            jmethodID getStringExtra =
+                    env->GetMethodID(intentClass, "getStringExtra", "(Ljava/lang/String;)Ljava/lang/String;");
+            for (const std::string &name : PVRSampleFW::Configurations::EyeStreamOptionNames()) {
+                jstring key = env->NewStringUTF(name.c_str());
+                auto value = (jstring) env->CallObjectMethod(intent, getStringExtra, key);
+                if (value != nullptr) {
+                    const char *chars = env->GetStringUTFChars(value, nullptr);
+                    Apply(config, name, chars);
+                    env->ReleaseStringUTFChars(value, chars);
+                    env->DeleteLocalRef(value);
+                }
+                env->DeleteLocalRef(key);
+            }
+            env->DeleteLocalRef(intentClass);
+            env->DeleteLocalRef(intent);
+        }
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        }
+        env->DeleteLocalRef(activityClass);
+    }
+
+    static void Apply(PVRSampleFW::Configurations &config, const std::string &name, const std::string &value) {
+        try {
+            if (config.SetEyeStreamOption(name, value)) {
+                PLOGI("[DEBUGGING] %s = %s", name.c_str(), value.c_str());
+            } else {
+                PLOGW("[DEBUGGING] Unknown eye stream option '%s'", name.c_str());
+            }
+        } catch (const std::exception &) {
+            PLOGE("[DEBUGGING] Bad value '%s' for %s", value.c_str(), name.c_str());
+        }
+    }
+
+    static std::string Trim(const std::string &text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            return "";
+        }
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+};
+
+#endif //PICONATIVEOPENXRSAMPLES_EYESTREAMCONFIG_H
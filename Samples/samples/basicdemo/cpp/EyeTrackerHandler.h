@@ -4,100 +4,125 @@
 
 #include "openxr/openxr.h"
 #include "BasicOpenXrWrapper.h"
-#include <sstream>  // for std::ostringstream
+#include <atomic>
+#include "shared.cpp"  // EtData / EtSample, shared with the host
+#include "latency.h"
+#include "control.h"
 
 #ifndef PICONATIVEOPENXRSAMPLES_EYETRACKERHANDLER_H
 #define PICONATIVEOPENXRSAMPLES_EYETRACKERHANDLER_H
 
-#define CHK_XR(x) \
-    do { \
-        XrResult res = x; \
-        if (XR_FAILED(res)) { \
-            PLOGE("[DEBUGGING] OpenXR call failed: %d\n", res); \
-            exit(1); \
-        } \
-    } while(0)
-
-
-#pragma pack(push, 1)
-struct EtData {
-    float leftEyeOpenness;
-    float rightEyeOpenness;
-
-    float leftEyePupilDilation;
-    float rightEyePupilDilation;
-
-    float leftEyeMiddleCanthusUvX;
-    float leftEyeMiddleCanthusUvY;
-    float rightEyeMiddleCanthusUvX;
-    float rightEyeMiddleCanthusUvY;
-};
-#pragma pack(pop)
-
 class EyeTrackerHandler {
 private:
     static PFN_xrCreateEyeTrackerPICO xrCreateEyeTrackerPICO;
     static PFN_xrDestroyEyeTrackerPICO xrDestroyEyeTrackerPICO;
     static PFN_xrGetEyeDataPICO xrGetEyeDataPICO;
     static XrEyeTrackerPICO eyeTracker;
-    static bool isInitialized;
+    static std::atomic<uint8_t> channelMask;
+
+    /// Sampling thread only.
+    struct Stats {
+        uint64_t samples;
+        uint64_t partial;   // a reading without both eyes tracked
+        uint64_t failed;    // no reading at all
+        XrResult lastError;
+        EtData last;
+    };
+    static Stats stats;
 
 public:
-    // EyeTrackerHandler();
-    static void Initialize(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
-        if (isInitialized) return; isInitialized = true;
+    /// Resolves the PICO eye tracker functions and creates the tracker, on the
+    /// thread that then owns the session. Returns whether there is a tracker;
+    /// failing, e.g. without the eye tracking permission, is only logged, and
+    /// ProcessData() then returns false until a Recreate() succeeds.
+    static bool Initialize(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
+        if (eyeTracker != XR_NULL_HANDLE) {
+            return true;
+        }
 
         auto instance = openxr_wrapper->GetXrInstance();
-        auto session = openxr_wrapper->GetXrSession();
-
-        CHK_XR(xrGetInstanceProcAddr(instance, "xrCreateEyeTrackerPICO",
-                              reinterpret_cast<PFN_xrVoidFunction*>(
-                                      &xrCreateEyeTrackerPICO)));
-
-        CHK_XR(xrGetInstanceProcAddr(instance, "xrDestroyEyeTrackerPICO",
-                              reinterpret_cast<PFN_xrVoidFunction*>(
-                                      &xrDestroyEyeTrackerPICO)));
-
-        CHK_XR(xrGetInstanceProcAddr(instance, "xrGetEyeDataPICO",
-                              reinterpret_cast<PFN_xrVoidFunction*>(
-                                      &xrGetEyeDataPICO)));
+        if (XR_FAILED(xrGetInstanceProcAddr(instance, "xrCreateEyeTrackerPICO",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrCreateEyeTrackerPICO))) ||
+            XR_FAILED(xrGetInstanceProcAddr(instance, "xrDestroyEyeTrackerPICO",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrDestroyEyeTrackerPICO))) ||
+            XR_FAILED(xrGetInstanceProcAddr(instance, "xrGetEyeDataPICO",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrGetEyeDataPICO)))) {
+            PLOGE("[DEBUGGING] No eye tracking: the runtime does not resolve its functions");
+            xrCreateEyeTrackerPICO = nullptr;
+            return false;
+        }
 
         XrEyeTrackerCreateInfoPICO createInfo{XR_TYPE_EYE_TRACKER_CREATE_INFO_PICO};
         createInfo.next = nullptr;
-
-        CHK_XR(xrCreateEyeTrackerPICO(session, &createInfo, &eyeTracker));
+        XrResult res = xrCreateEyeTrackerPICO(openxr_wrapper->GetXrSession(), &createInfo, &eyeTracker);
+        if (XR_FAILED(res)) {
+            PLOGE("[DEBUGGING] No eye tracking: creating the tracker failed: %d", res);
+            eyeTracker = XR_NULL_HANDLE;
+            return false;
+        }
+        return true;
     }
 
-
-    static void LogEyeData(const XrEyeTrackerDataPICO& eyeData) {
-        std::ostringstream oss;
-
-        oss << "Left Eye: openness=" << eyeData.leftEyeData.openness
-            << ", pupilDilation=" << eyeData.leftEyeData.pupilDilation
-            << ", middleCanthusUv=(" << eyeData.leftEyeData.middleCanthusUv.x
-            << ", " << eyeData.leftEyeData.middleCanthusUv.y << ") | "
-            << "Right Eye: openness=" << eyeData.rightEyeData.openness
-            << ", pupilDilation=" << eyeData.rightEyeData.pupilDilation
-            << ", middleCanthusUv=(" << eyeData.rightEyeData.middleCanthusUv.x
-            << ", " << eyeData.rightEyeData.middleCanthusUv.y << ")";
-
-        PLOGI(oss.str().c_str());  // convert to C-style string for logging
+    /// Which EtData channels to read, one bit per float (see control.h). Disabled
+    /// channels are sent as 0, and an eye with none enabled is not queried.
+    static void SetChannelMask(uint8_t mask) {
+        channelMask.store(mask, std::memory_order_relaxed);
     }
 
+    /// Destroys and recreates the tracker, so the runtime starts it afresh.
+    /// Call from the thread that samples it. On failure there is no tracker and
+    /// ProcessData() returns false until the next Recreate().
+    static bool Recreate(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
+        DisposeTracker();
+        if (xrCreateEyeTrackerPICO == nullptr) {
+            return false;  // Initialize() could not resolve the functions
+        }
 
-    static EtData ProcessData(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
-        Initialize(openxr_wrapper);
+        XrEyeTrackerCreateInfoPICO createInfo{XR_TYPE_EYE_TRACKER_CREATE_INFO_PICO};
+        createInfo.next = nullptr;
+        XrResult res = xrCreateEyeTrackerPICO(openxr_wrapper->GetXrSession(), &createInfo, &eyeTracker);
+        if (XR_FAILED(res)) {
+            PLOGE("[DEBUGGING] Recreating the eye tracker failed: %d", res);
+            eyeTracker = XR_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
 
+    /// Reads the tracker into sample; the hot path of the sampler thread. It
+    /// neither allocates nor logs: Initialize() has resolved the functions, and
+    /// readings and failures only go into counters for LogStats(). Returns false
+    /// when there is no reading, e.g. while the session is not focused; the
+    /// caller skips that sample and tries again at the next one.
+    static bool ProcessData(XrTime time, EtSample &sample) {
+        uint8_t mask = channelMask.load(std::memory_order_relaxed);
         XrEyeTrackerDataPICO eyeData = {XR_TYPE_EYE_TRACKER_DATA_PICO, nullptr};
         XrEyeTrackerDataInfoPICO eyeDataInfo = {
                 XR_TYPE_EYE_TRACKER_DATA_INFO_PICO,
                 nullptr,
-                XR_EYE_TRACKER_LEFT_BIT_PICO | XR_EYE_TRACKER_RIGHT_BIT_PICO,
+                ((mask & CONTROL_LEFT_CHANNELS) ? XR_EYE_TRACKER_LEFT_BIT_PICO : 0) |
+                ((mask & CONTROL_RIGHT_CHANNELS) ? XR_EYE_TRACKER_RIGHT_BIT_PICO : 0),
         };
-        CHK_XR(xrGetEyeDataPICO(eyeTracker, &eyeDataInfo, &eyeData));
-        LogEyeData(eyeData);
-
-        EtData dataToExport = {};
+        if (eyeTracker == XR_NULL_HANDLE) {
+            stats.failed++;
+            stats.lastError = XR_ERROR_HANDLE_INVALID;
+            return false;
+        }
+        if (eyeDataInfo.eyeTrackingFlags != 0) {
+            XrResult res = xrGetEyeDataPICO(eyeTracker, &eyeDataInfo, &eyeData);
+            if (XR_FAILED(res)) {
+                stats.failed++;
+                stats.lastError = res;
+                return false;
+            }
+        }
+        uint64_t captureNs = MonotonicNs();
+
+        sample.time = time;
+        sample.captureNs = captureNs;
+        sample.trackingState = eyeData.trackingState;
+        sample.hostTime = 0;
+        EtData &dataToExport = sample.data;
 
         dataToExport.leftEyeOpenness = eyeData.leftEyeData.openness;
         dataToExport.rightEyeOpenness = eyeData.rightEyeData.openness;
@@ -111,20 +136,51 @@ public:
         dataToExport.rightEyeMiddleCanthusUvX = eyeData.rightEyeData.middleCanthusUv.x;
         dataToExport.rightEyeMiddleCanthusUvY = eyeData.rightEyeData.middleCanthusUv.y;
 
-        // PLOGI("[ETDATA]");
-        // PLOGI(dataToExport.leftEyeOpenness);
-
+        if (mask != CONTROL_ALL_CHANNELS) {
+            float *channels = (float *) &dataToExport;
+            for (int i = 0; i < 8; i++) {
+                if (!(mask & (1u << i))) {
+                    channels[i] = 0.0f;
+                }
+            }
+        }
+
+        stats.samples++;
+        if ((sample.trackingState & ET_TRACKING_BOTH_EYES) != ET_TRACKING_BOTH_EYES) {
+            stats.partial++;
+        }
+        stats.last = dataToExport;
+        return true;
+    }
 
-        return dataToExport;
+    /// One line with the counters since the last call and the latest reading,
+    /// then resets the counters. Call from the sampling thread, every few seconds.
+    static void LogStats() {
+        const EtData &d = stats.last;
+        PLOGI("[DEBUGGING] Tracker: %llu readings (%llu missing an eye), %llu failed (last %d) | "
+              "left open=%.2f pupil=%.2f uv=(%.3f, %.3f) right open=%.2f pupil=%.2f uv=(%.3f, %.3f)",
+              (unsigned long long) stats.samples, (unsigned long long) stats.partial,
+              (unsigned long long) stats.failed, stats.lastError,
+              d.leftEyeOpenness, d.leftEyePupilDilation, d.leftEyeMiddleCanthusUvX, d.leftEyeMiddleCanthusUvY,
+              d.rightEyeOpenness, d.rightEyePupilDilation, d.rightEyeMiddleCanthusUvX, d.rightEyeMiddleCanthusUvY);
+        stats.samples = stats.partial = stats.failed = 0;
     }
 
     static void DisposeTracker() {
-        CHK_XR(xrDestroyEyeTrackerPICO(eyeTracker));
+        if (eyeTracker == XR_NULL_HANDLE) {
+            return;
+        }
+        XrResult res = xrDestroyEyeTrackerPICO(eyeTracker);
+        if (XR_FAILED(res)) {
+            PLOGW("[DEBUGGING] Destroying the eye tracker failed: %d", res);
+        }
+        eyeTracker = XR_NULL_HANDLE;
     }
 };
 PFN_xrCreateEyeTrackerPICO EyeTrackerHandler::xrCreateEyeTrackerPICO = XR_NULL_HANDLE;
 PFN_xrDestroyEyeTrackerPICO EyeTrackerHandler::xrDestroyEyeTrackerPICO = XR_NULL_HANDLE;
 PFN_xrGetEyeDataPICO EyeTrackerHandler::xrGetEyeDataPICO = XR_NULL_HANDLE;
 XrEyeTrackerPICO EyeTrackerHandler::eyeTracker = XR_NULL_HANDLE;
-bool EyeTrackerHandler::isInitialized = false;
+std::atomic<uint8_t> EyeTrackerHandler::channelMask{CONTROL_ALL_CHANNELS};
+EyeTrackerHandler::Stats EyeTrackerHandler::stats = {};
 #endif //PICONATIVEOPENXRSAMPLES_EYETRACKERHANDLER_H
@@ -0,0 +1,187 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#include "openxr/openxr.h"
+#include "BasicOpenXrWrapper.h"
+#include <cstring>
+#include "blendshape.h"  // BlendshapeFrame / BlendshapeDictionary, shared with the host
+#include "latency.h"
+
+#ifndef PICONATIVEOPENXRSAMPLES_FACETRACKERHANDLER_H
+#define PICONATIVEOPENXRSAMPLES_FACETRACKERHANDLER_H
+
+/// Face and lip tracking through XR_FB_face_tracking2: 70 blendshape weights per
+/// reading, sent to the host as a generic blendshape stream (blendshape.h). The
+/// runtime may not offer the extension, or the user may not grant face
+/// tracking; the handler then stays unavailable and the eye stream goes on alone.
+class FaceTrackerHandler {
+private:
+    static PFN_xrCreateFaceTracker2FB xrCreateFaceTracker2FB;
+    static PFN_xrDestroyFaceTracker2FB xrDestroyFaceTracker2FB;
+    static PFN_xrGetFaceExpressionWeights2FB xrGetFaceExpressionWeights2FB;
+    static XrFaceTracker2FB faceTracker;
+    static BlendshapeDictionary dictionary;
+    static XrTime lastTime;
+
+    /// Sampling thread only.
+    struct Stats {
+        uint64_t readings;
+        uint64_t repeated;  // the runtime had nothing newer than the last reading
+        uint64_t invalid;   // a reading the runtime marked as not tracking
+        uint64_t failed;
+        XrResult lastError;
+        float jawDrop;
+    };
+    static Stats stats;
+
+    /// XrFaceExpression2FB in order, as the host will address them over OSC.
+    static constexpr const char *kChannelNames[XR_FACE_EXPRESSION2_COUNT_FB] = {
+            "BrowLowererL", "BrowLowererR", "CheekPuffL", "CheekPuffR", "CheekRaiserL", "CheekRaiserR",
+            "CheekSuckL", "CheekSuckR", "ChinRaiserB", "ChinRaiserT", "DimplerL", "DimplerR",
+            "EyesClosedL", "EyesClosedR", "EyesLookDownL", "EyesLookDownR", "EyesLookLeftL", "EyesLookLeftR",
+            "EyesLookRightL", "EyesLookRightR", "EyesLookUpL", "EyesLookUpR", "InnerBrowRaiserL",
+            "InnerBrowRaiserR", "JawDrop", "JawSidewaysLeft", "JawSidewaysRight", "JawThrust", "LidTightenerL",
+            "LidTightenerR", "LipCornerDepressorL", "LipCornerDepressorR", "LipCornerPullerL", "LipCornerPullerR",
+            "LipFunnelerLb", "LipFunnelerLt", "LipFunnelerRb", "LipFunnelerRt", "LipPressorL", "LipPressorR",
+            "LipPuckerL", "LipPuckerR", "LipStretcherL", "LipStretcherR", "LipSuckLb", "LipSuckLt", "LipSuckRb",
+            "LipSuckRt", "LipTightenerL", "LipTightenerR", "LipsToward", "LowerLipDepressorL",
+            "LowerLipDepressorR", "MouthLeft", "MouthRight", "NoseWrinklerL", "NoseWrinklerR",
+            "OuterBrowRaiserL", "OuterBrowRaiserR", "UpperLidRaiserL", "UpperLidRaiserR", "UpperLipRaiserL",
+            "UpperLipRaiserR", "TongueTipInterdental", "TongueTipAlveolar", "TongueFrontDorsalPalate",
+            "TongueMidDorsalPalate", "TongueBackDorsalVelar", "TongueOut", "TongueRetreat",
+    };
+
+public:
+    /// Resolves the extension and creates the tracker, on the thread that then
+    /// owns the session. Returns whether face tracking is available; failing is
+    /// not an error, only logged.
+    static bool Initialize(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
+        if (faceTracker != XR_NULL_HANDLE) {
+            return true;
+        }
+        if (!openxr_wrapper->IsExtensionEnabled(XR_FB_FACE_TRACKING2_EXTENSION_NAME)) {
+            PLOGI("[DEBUGGING] No face tracking: %s is not enabled", XR_FB_FACE_TRACKING2_EXTENSION_NAME);
+            return false;
+        }
+
+        auto instance = openxr_wrapper->GetXrInstance();
+        if (XR_FAILED(xrGetInstanceProcAddr(instance, "xrCreateFaceTracker2FB",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrCreateFaceTracker2FB))) ||
+            XR_FAILED(xrGetInstanceProcAddr(instance, "xrDestroyFaceTracker2FB",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrDestroyFaceTracker2FB))) ||
+            XR_FAILED(xrGetInstanceProcAddr(instance, "xrGetFaceExpressionWeights2FB",
+                                            reinterpret_cast<PFN_xrVoidFunction *>(&xrGetFaceExpressionWeights2FB)))) {
+            PLOGW("[DEBUGGING] No face tracking: the runtime does not resolve its functions");
+            return false;
+        }
+
+        // Visual tracking where the headset has face cameras, lip sync from the
+        // microphone otherwise; the runtime picks per reading.
+        XrFaceTrackingDataSource2FB sources[] = {XR_FACE_TRACKING_DATA_SOURCE2_VISUAL_FB,
+                                                 XR_FACE_TRACKING_DATA_SOURCE2_AUDIO_FB};
+        XrFaceTrackerCreateInfo2FB createInfo{XR_TYPE_FACE_TRACKER_CREATE_INFO2_FB};
+        createInfo.faceExpressionSet = XR_FACE_EXPRESSION_SET2_DEFAULT_FB;
+        createInfo.requestedDataSourceCount = 2;
+        createInfo.requestedDataSources = sources;
+        XrResult res = xrCreateFaceTracker2FB(openxr_wrapper->GetXrSession(), &createInfo, &faceTracker);
+        if (XR_FAILED(res)) {
+            PLOGW("[DEBUGGING] No face tracking: creating the tracker failed: %d", res);
+            faceTracker = XR_NULL_HANDLE;
+            return false;
+        }
+
+        dictionary.encoding = BLENDSHAPE_UNORM8;
+        dictionary.channelCount = XR_FACE_EXPRESSION2_COUNT_FB;
+        for (int i = 0; i < XR_FACE_EXPRESSION2_COUNT_FB; i++) {
+            std::strncpy(dictionary.names[i], kChannelNames[i], BLENDSHAPE_MAX_NAME - 1);
+            dictionary.names[i][BLENDSHAPE_MAX_NAME - 1] = '\0';
+        }
+        lastTime = 0;
+        PLOGI("[DEBUGGING] Face tracking with %d channels", dictionary.channelCount);
+        return true;
+    }
+
+    static bool Available() {
+        return faceTracker != XR_NULL_HANDLE;
+    }
+
+    /// The channel names the frames carry; valid once Initialize() succeeded.
+    static const BlendshapeDictionary &Dictionary() {
+        return dictionary;
+    }
+
+    /// Reads the tracker into frame, on the sampler thread next to the eye
+    /// tracker and under the same rules: no allocation, no logging. Returns false
+    /// when there is no new reading; the face runs slower than the eye sampler,
+    /// so readings the runtime already returned are skipped rather than resent.
+    static bool ProcessData(XrTime time, BlendshapeFrame &frame) {
+        if (faceTracker == XR_NULL_HANDLE) {
+            return false;
+        }
+        float confidences[XR_FACE_CONFIDENCE2_COUNT_FB];
+        XrFaceExpressionInfo2FB info{XR_TYPE_FACE_EXPRESSION_INFO2_FB};
+        info.time = time;
+        XrFaceExpressionWeights2FB weights{XR_TYPE_FACE_EXPRESSION_WEIGHTS2_FB};
+        weights.weightCount = XR_FACE_EXPRESSION2_COUNT_FB;
+        weights.weights = frame.weights;
+        weights.confidenceCount = XR_FACE_CONFIDENCE2_COUNT_FB;
+        weights.confidences = confidences;
+        XrResult res = xrGetFaceExpressionWeights2FB(faceTracker, &info, &weights);
+        if (XR_FAILED(res)) {
+            stats.failed++;
+            stats.lastError = res;
+            return false;
+        }
+        if (!weights.isValid) {
+            stats.invalid++;
+            return false;
+        }
+        if (weights.time == lastTime) {
+            stats.repeated++;
+            return false;
+        }
+        lastTime = weights.time;
+
+        frame.time = (uint64_t) weights.time;
+        frame.captureNs = MonotonicNs();
+        frame.hostTime = 0;
+        frame.channelCount = XR_FACE_EXPRESSION2_COUNT_FB;
+        frame.flags = (weights.isEyeFollowingBlendshapesValid ? BLENDSHAPE_EYES_VALID : 0) |
+                      (weights.dataSource == XR_FACE_TRACKING_DATA_SOURCE2_AUDIO_FB ? BLENDSHAPE_FROM_AUDIO : 0);
+        stats.readings++;
+        stats.jawDrop = frame.weights[XR_FACE_EXPRESSION2_JAW_DROP_FB];
+        return true;
+    }
+
+    /// One line with the counters since the last call, then resets them. Call
+    /// from the sampling thread, every few seconds.
+    static void LogStats() {
+        if (faceTracker == XR_NULL_HANDLE) {
+            return;
+        }
+        PLOGI("[DEBUGGING] Face: %llu readings, %llu repeated, %llu not tracking, %llu failed (last %d) | jaw=%.2f",
+              (unsigned long long) stats.readings, (unsigned long long) stats.repeated,
+              (unsigned long long) stats.invalid, (unsigned long long) stats.failed, stats.lastError, stats.jawDrop);
+        stats.readings = stats.repeated = stats.invalid = stats.failed = 0;
+    }
+
+    static void DisposeTracker() {
+        if (faceTracker == XR_NULL_HANDLE) {
+            return;
+        }
+        XrResult res = xrDestroyFaceTracker2FB(faceTracker);
+        if (XR_FAILED(res)) {
+            PLOGW("[DEBUGGING] Destroying the face tracker failed: %d", res);
+        }
+        faceTracker = XR_NULL_HANDLE;
+    }
+};
+PFN_xrCreateFaceTracker2FB FaceTrackerHandler::xrCreateFaceTracker2FB = nullptr;
+PFN_xrDestroyFaceTracker2FB FaceTrackerHandler::xrDestroyFaceTracker2FB = nullptr;
+PFN_xrGetFaceExpressionWeights2FB FaceTrackerHandler::xrGetFaceExpressionWeights2FB = nullptr;
+XrFaceTracker2FB FaceTrackerHandler::faceTracker = XR_NULL_HANDLE;
+BlendshapeDictionary FaceTrackerHandler::dictionary;
+XrTime FaceTrackerHandler::lastTime = 0;
+FaceTrackerHandler::Stats FaceTrackerHandler::stats = {};
+#endif //PICONATIVEOPENXRSAMPLES_FACETRACKERHANDLER_H
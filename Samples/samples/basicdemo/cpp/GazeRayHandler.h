@@ -0,0 +1,243 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#include "openxr/openxr.h"
+#include "BasicOpenXrWrapper.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "gaze.h"  // GazeRay, shared with the host
+#include "latency.h"
+
+#ifndef PICONATIVEOPENXRSAMPLES_GAZERAYHANDLER_H
+#define PICONATIVEOPENXRSAMPLES_GAZERAYHANDLER_H
+
+/// The combined gaze ray in app space, for the host to drive look-at targets
+/// with. XR_PICO_eye_tracker only reports openness, pupils and canthus UVs, so
+/// the ray comes from the runtime's gaze instead: per eye through
+/// XR_FB_eye_tracking_social where offered, which also gives the convergence
+/// distance, or else the combined gaze of XR_EXT_eye_gaze_interaction. Either
+/// is located in app space at the sample time, so the head pose at that instant
+/// is already applied.
+class GazeRayHandler {
+private:
+    static PFN_xrCreateEyeTrackerFB xrCreateEyeTrackerFB;
+    static PFN_xrDestroyEyeTrackerFB xrDestroyEyeTrackerFB;
+    static PFN_xrGetEyeGazesFB xrGetEyeGazesFB;
+    static XrEyeTrackerFB eyeTracker;
+    static XrSpace gazeSpace;  // the framework's XR_EXT_eye_gaze_interaction action space, when there is no eyeTracker
+    static XrSpace baseSpace;
+
+    /// Sampling thread only.
+    struct Stats {
+        uint64_t rays;
+        uint64_t converged;
+        uint64_t untracked;  // no valid gaze at the sample time
+        uint64_t failed;
+        XrResult lastError;
+        float convergence;
+    };
+    static Stats stats;
+
+    /// Rays closer to parallel than this (cosine of the angle between them) have
+    /// no convergence: it would lie beyond ~10 m at a 63 mm IPD, where it is
+    /// pure noise.
+    static constexpr float kParallelCos = 0.99998f;  // ~0.36 degrees
+
+    static glm::vec3 Position(const XrPosef &pose) {
+        return glm::vec3(pose.position.x, pose.position.y, pose.position.z);
+    }
+
+    /// OpenXR poses look down -Z.
+    static glm::vec3 Forward(const XrPosef &pose) {
+        glm::quat q(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+        return glm::normalize(q * glm::vec3(0.0f, 0.0f, -1.0f));
+    }
+
+    static void Store(const glm::vec3 &origin, const glm::vec3 &direction, GazeRay &ray) {
+        for (int axis = 0; axis < 3; axis++) {
+            ray.origin[axis] = origin[axis];
+            ray.direction[axis] = direction[axis];
+        }
+    }
+
+    /// Where the eyes' rays pass closest, as a distance from origin along
+    /// direction. False for parallel or diverging rays.
+    static bool Converge(const glm::vec3 &leftOrigin, const glm::vec3 &left, const glm::vec3 &rightOrigin,
+                         const glm::vec3 &right, const glm::vec3 &origin, const glm::vec3 &direction,
+                         float &distance) {
+        float b = glm::dot(left, right);
+        if (b > kParallelCos) {
+            return false;
+        }
+        glm::vec3 w = leftOrigin - rightOrigin;
+        float d = glm::dot(left, w);
+        float e = glm::dot(right, w);
+        float denominator = 1.0f - b * b;
+        float s = (b * e - d) / denominator;  // along the left ray
+        float t = (e - b * d) / denominator;  // along the right ray
+        if (s <= 0.0f || t <= 0.0f) {
+            return false;
+        }
+        glm::vec3 midpoint = 0.5f * (leftOrigin + s * left + rightOrigin + t * right);
+        distance = glm::dot(midpoint - origin, direction);
+        return distance > 0.0f;
+    }
+
+    static bool FromEyes(XrTime time, GazeRay &ray) {
+        XrEyeGazesInfoFB info{XR_TYPE_EYE_GAZES_INFO_FB};
+        info.baseSpace = baseSpace;
+        info.time = time;
+        XrEyeGazesFB gazes{XR_TYPE_EYE_GAZES_FB};
+        XrResult res = xrGetEyeGazesFB(eyeTracker, &info, &gazes);
+        if (XR_FAILED(res)) {
+            stats.failed++;
+            stats.lastError = res;
+            return false;
+        }
+        const XrEyeGazeFB &leftGaze = gazes.gaze[XR_EYE_POSITION_LEFT_FB];
+        const XrEyeGazeFB &rightGaze = gazes.gaze[XR_EYE_POSITION_RIGHT_FB];
+        if (!leftGaze.isValid && !rightGaze.isValid) {
+            stats.untracked++;
+            return false;
+        }
+        if (!leftGaze.isValid || !rightGaze.isValid) {
+            // One eye only: its ray, without a convergence.
+            const XrPosef &pose = leftGaze.isValid ? leftGaze.gazePose : rightGaze.gazePose;
+            Store(Position(pose), Forward(pose), ray);
+            ray.flags = 0;
+            ray.convergence = 0.0f;
+            return true;
+        }
+
+        glm::vec3 leftOrigin = Position(leftGaze.gazePose), rightOrigin = Position(rightGaze.gazePose);
+        glm::vec3 left = Forward(leftGaze.gazePose), right = Forward(rightGaze.gazePose);
+        glm::vec3 origin = 0.5f * (leftOrigin + rightOrigin);
+        glm::vec3 direction = glm::normalize(left + right);
+        Store(origin, direction, ray);
+        ray.flags = GAZE_FROM_EYES;
+        ray.convergence = 0.0f;
+        float distance;
+        if (Converge(leftOrigin, left, rightOrigin, right, origin, direction, distance)) {
+            ray.flags |= GAZE_CONVERGENCE;
+            ray.convergence = distance;
+            stats.converged++;
+            stats.convergence = distance;
+        }
+        return true;
+    }
+
+    static bool FromCombinedGaze(XrTime time, GazeRay &ray) {
+        XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+        XrResult res = xrLocateSpace(gazeSpace, baseSpace, time, &location);
+        if (XR_FAILED(res)) {
+            stats.failed++;
+            stats.lastError = res;
+            return false;
+        }
+        const XrSpaceLocationFlags valid = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+        if ((location.locationFlags & valid) != valid) {
+            stats.untracked++;
+            return false;
+        }
+        Store(Position(location.pose), Forward(location.pose), ray);
+        ray.flags = 0;
+        ray.convergence = 0.0f;
+        return true;
+    }
+
+public:
+    /// Picks the gaze source, on the thread that then owns the session, after
+    /// the framework set up its actions. Returns whether there is one; failing
+    /// is not an error, only logged.
+    static bool Initialize(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
+        if (Available()) {
+            return true;
+        }
+        baseSpace = openxr_wrapper->GetAppSpace();
+        auto instance = openxr_wrapper->GetXrInstance();
+        if (openxr_wrapper->IsExtensionEnabled(XR_FB_EYE_TRACKING_SOCIAL_EXTENSION_NAME)) {
+            XrResult res = XR_ERROR_FUNCTION_UNSUPPORTED;
+            if (XR_SUCCEEDED(xrGetInstanceProcAddr(instance, "xrCreateEyeTrackerFB",
+                                                   reinterpret_cast<PFN_xrVoidFunction *>(&xrCreateEyeTrackerFB))) &&
+                XR_SUCCEEDED(xrGetInstanceProcAddr(instance, "xrDestroyEyeTrackerFB",
+                                                   reinterpret_cast<PFN_xrVoidFunction *>(&xrDestroyEyeTrackerFB))) &&
+                XR_SUCCEEDED(xrGetInstanceProcAddr(instance, "xrGetEyeGazesFB",
+                                                   reinterpret_cast<PFN_xrVoidFunction *>(&xrGetEyeGazesFB)))) {
+                XrEyeTrackerCreateInfoFB createInfo{XR_TYPE_EYE_TRACKER_CREATE_INFO_FB};
+                res = xrCreateEyeTrackerFB(openxr_wrapper->GetXrSession(), &createInfo, &eyeTracker);
+            }
+            if (XR_SUCCEEDED(res)) {
+                PLOGI("[DEBUGGING] Gaze ray from both eyes' gaze, with convergence");
+                return true;
+            }
+            PLOGW("[DEBUGGING] Per-eye gaze unavailable: %d", res);
+            eyeTracker = XR_NULL_HANDLE;
+        }
+        gazeSpace = openxr_wrapper->GetInputState().gaze_action_space;
+        if (gazeSpace != XR_NULL_HANDLE) {
+            PLOGI("[DEBUGGING] Gaze ray from the combined eye gaze, without convergence");
+            return true;
+        }
+        PLOGI("[DEBUGGING] No gaze ray: the runtime offers no eye gaze");
+        return false;
+    }
+
+    static bool Available() {
+        return eyeTracker != XR_NULL_HANDLE || gazeSpace != XR_NULL_HANDLE;
+    }
+
+    /// Locates the gaze at time into ray, on the sampler thread next to the eye
+    /// tracker and under the same rules: no allocation, no logging. Returns false
+    /// when there is no gaze.
+    static bool ProcessData(XrTime time, GazeRay &ray) {
+        bool located;
+        if (eyeTracker != XR_NULL_HANDLE) {
+            located = FromEyes(time, ray);
+        } else if (gazeSpace != XR_NULL_HANDLE) {
+            located = FromCombinedGaze(time, ray);
+        } else {
+            return false;
+        }
+        if (!located) {
+            return false;
+        }
+        ray.time = (uint64_t) time;
+        ray.captureNs = MonotonicNs();
+        ray.hostTime = 0;
+        stats.rays++;
+        return true;
+    }
+
+    /// One line with the counters since the last call, then resets them. Call
+    /// from the sampling thread, every few seconds.
+    static void LogStats() {
+        if (!Available()) {
+            return;
+        }
+        PLOGI("[DEBUGGING] Gaze: %llu rays (%llu converged, last at %.2fm), %llu not tracking, %llu failed (last %d)",
+              (unsigned long long) stats.rays, (unsigned long long) stats.converged, stats.convergence,
+              (unsigned long long) stats.untracked, (unsigned long long) stats.failed, stats.lastError);
+        stats.rays = stats.converged = stats.untracked = stats.failed = 0;
+    }
+
+    static void DisposeTracker() {
+        gazeSpace = XR_NULL_HANDLE;  // the framework's to destroy
+        if (eyeTracker == XR_NULL_HANDLE) {
+            return;
+        }
+        XrResult res = xrDestroyEyeTrackerFB(eyeTracker);
+        if (XR_FAILED(res)) {
+            PLOGW("[DEBUGGING] Destroying the per-eye gaze tracker failed: %d", res);
+        }
+        eyeTracker = XR_NULL_HANDLE;
+    }
+};
+PFN_xrCreateEyeTrackerFB GazeRayHandler::xrCreateEyeTrackerFB = nullptr;
+PFN_xrDestroyEyeTrackerFB GazeRayHandler::xrDestroyEyeTrackerFB = nullptr;
+PFN_xrGetEyeGazesFB GazeRayHandler::xrGetEyeGazesFB = nullptr;
+XrEyeTrackerFB GazeRayHandler::eyeTracker = XR_NULL_HANDLE;
+XrSpace GazeRayHandler::gazeSpace = XR_NULL_HANDLE;
+XrSpace GazeRayHandler::baseSpace = XR_NULL_HANDLE;
+GazeRayHandler::Stats GazeRayHandler::stats = {};
+#endif //PICONATIVEOPENXRSAMPLES_GAZERAYHANDLER_H
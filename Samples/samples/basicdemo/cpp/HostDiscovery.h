@@ -0,0 +1,107 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#ifndef PICONATIVEOPENXRSAMPLES_HOSTDISCOVERY_H
+#define PICONATIVEOPENXRSAMPLES_HOSTDISCOVERY_H
+
+#include "LogUtils.h"
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#include <unistd.h>
+#include <poll.h>
+#include "discovery.h"
+
+/// Finds a host on the local network with the probe/announce exchange in
+/// discovery.h, so the headset does not need the host's address configured.
+class HostDiscovery {
+public:
+    /// Broadcasts a probe on every interface and waits up to timeoutMs for a host
+    /// streaming over the wanted transport. On success hostAddr holds its address
+    /// and stream port.
+    static bool Find(uint16_t discoveryPort, bool udp, int timeoutMs, sockaddr_in &hostAddr) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) {
+            PLOGE("[DEBUGGING] Discovery socket creation failed");
+            return false;
+        }
+        int on = 1;
+        setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+
+        DiscoveryMessage probe{};
+        probe.magic = DISCOVERY_MAGIC;
+        probe.version = DISCOVERY_VERSION;
+        probe.kind = DISCOVERY_PROBE;
+        int sent = SendProbes(sock, probe, discoveryPort);
+
+        bool found = false;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (sent > 0 && !found) {
+            int remaining = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            pollfd pfd{sock, POLLIN, 0};
+            if (remaining <= 0 || poll(&pfd, 1, remaining) <= 0) {
+                break;
+            }
+
+            DiscoveryMessage announce;
+            sockaddr_in from{};
+            socklen_t fromLen = sizeof(from);
+            ssize_t received = recvfrom(sock, &announce, sizeof(announce), 0, (sockaddr *) &from, &fromLen);
+            if (received < (ssize_t) sizeof(announce) || announce.magic != DISCOVERY_MAGIC ||
+                announce.kind != DISCOVERY_ANNOUNCE ||
+                !(announce.transports & (udp ? DISCOVERY_UDP : DISCOVERY_TCP))) {
+                continue;
+            }
+
+            announce.name[sizeof(announce.name) - 1] = '\0';
+            hostAddr = sockaddr_in{};
+            hostAddr.sin_family = AF_INET;
+            hostAddr.sin_addr = from.sin_addr;
+            hostAddr.sin_port = announce.streamPort;
+            char address[INET_ADDRSTRLEN] = "?";
+            inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+            PLOGI("[DEBUGGING] Discovered host %s at %s:%d", announce.name, address, ntohs(announce.streamPort));
+            found = true;
+        }
+
+        close(sock);
+        return found;
+    }
+
+private:
+    /// The limited broadcast address is not forwarded by every access point, so
+    /// the probe also goes to each interface's directed broadcast address.
+    static int SendProbes(int sock, const DiscoveryMessage &probe, uint16_t port) {
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(port);
+        target.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        int sent = sendto(sock, &probe, sizeof(probe), 0, (sockaddr *) &target, sizeof(target)) > 0 ? 1 : 0;
+
+        ifaddrs *interfaces = nullptr;
+        if (getifaddrs(&interfaces) != 0) {
+            return sent;
+        }
+        for (ifaddrs *it = interfaces; it != nullptr; it = it->ifa_next) {
+            if (it->ifa_addr == nullptr || it->ifa_addr->sa_family != AF_INET ||
+                !(it->ifa_flags & IFF_BROADCAST) || (it->ifa_flags & IFF_LOOPBACK) ||
+                it->ifa_broadaddr == nullptr) {
+                continue;
+            }
+            target.sin_addr = ((sockaddr_in *) it->ifa_broadaddr)->sin_addr;
+            if (sendto(sock, &probe, sizeof(probe), 0, (sockaddr *) &target, sizeof(target)) > 0) {
+                sent++;
+            }
+        }
+        freeifaddrs(interfaces);
+        return sent;
+    }
+};
+
+#endif //PICONATIVEOPENXRSAMPLES_HOSTDISCOVERY_H
@@ -0,0 +1,286 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#include "openxr/openxr.h"
+#include "BasicOpenXrWrapper.h"
+#include <atomic>
+#include "poses.h"  // PoseFrame, shared with the host
+#include "latency.h"
+
+#ifndef PICONATIVEOPENXRSAMPLES_POSETRACKERHANDLER_H
+#define PICONATIVEOPENXRSAMPLES_POSETRACKERHANDLER_H
+
+/// Body joints through XR_BD_body_tracking and motion trackers through
+/// XR_PICO_motion_tracking, sent to the host as pose frames (poses.h), one per
+/// source and reading. Either extension may be missing, or the user may have no
+/// trackers; what is there gets streamed and the rest stays quiet.
+class PoseTrackerHandler {
+private:
+    static PFN_xrCreateBodyTrackerBD xrCreateBodyTrackerBD;
+    static PFN_xrDestroyBodyTrackerBD xrDestroyBodyTrackerBD;
+    static PFN_xrLocateBodyJointsBD xrLocateBodyJointsBD;
+    static PFN_xrRequestMotionTrackerDevicePICO xrRequestMotionTrackerDevicePICO;
+    static PFN_xrLocateMotionTrackerPICO xrLocateMotionTrackerPICO;
+    static XrBodyTrackerBD bodyTracker;
+    static bool motionTracking;
+    static XrSession session;
+    static XrSpace baseSpace;
+    /// Connected trackers by slot, 0 for a free one; written on the event thread,
+    /// read by the sampler. A tracker keeps its slot, and so its host address,
+    /// while it stays connected.
+    static std::atomic<XrMotionTrackerIdPICO> trackerIds[POSE_MAX_TRACKERS];
+
+    /// Sampling thread only.
+    struct Stats {
+        uint64_t bodyReadings;
+        uint64_t bodyUntracked;    // the runtime located no joint
+        uint64_t trackerReadings;
+        uint64_t failed;
+        XrResult lastError;
+        int trackedJoints;
+        int trackedTrackers;
+    };
+    static Stats stats;
+
+    static bool Tracked(XrSpaceLocationFlags flags) {
+        const XrSpaceLocationFlags valid = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+        return (flags & valid) == valid;
+    }
+
+    static void StorePose(const XrPosef &from, Pose &to) {
+        to.position[0] = from.position.x;
+        to.position[1] = from.position.y;
+        to.position[2] = from.position.z;
+        to.rotation[0] = from.orientation.x;
+        to.rotation[1] = from.orientation.y;
+        to.rotation[2] = from.orientation.z;
+        to.rotation[3] = from.orientation.w;
+    }
+
+    static void Failed(XrResult res) {
+        stats.failed++;
+        stats.lastError = res;
+    }
+
+public:
+    /// Resolves both extensions and creates the body tracker, on the thread that
+    /// then owns the session. Returns whether there is any source to stream;
+    /// failing is not an error, only logged.
+    static bool Initialize(PVRSampleFW::BasicOpenXrWrapper *openxr_wrapper) {
+        auto instance = openxr_wrapper->GetXrInstance();
+        session = openxr_wrapper->GetXrSession();
+        baseSpace = openxr_wrapper->GetAppSpace();
+
+        if (bodyTracker == XR_NULL_HANDLE && openxr_wrapper->IsExtensionEnabled(XR_BD_BODY_TRACKING_EXTENSION_NAME)) {
+            if (XR_FAILED(xrGetInstanceProcAddr(instance, "xrCreateBodyTrackerBD",
+                                                reinterpret_cast<PFN_xrVoidFunction *>(&xrCreateBodyTrackerBD))) ||
+                XR_FAILED(xrGetInstanceProcAddr(instance, "xrDestroyBodyTrackerBD",
+                                                reinterpret_cast<PFN_xrVoidFunction *>(&xrDestroyBodyTrackerBD))) ||
+                XR_FAILED(xrGetInstanceProcAddr(instance, "xrLocateBodyJointsBD",
+                                                reinterpret_cast<PFN_xrVoidFunction *>(&xrLocateBodyJointsBD)))) {
+                PLOGW("[DEBUGGING] No body tracking: the runtime does not resolve its functions");
+            } else {
+                XrBodyTrackerCreateInfoBD createInfo{XR_TYPE_BODY_TRACKER_CREATE_INFO_BD};
+                createInfo.jointSet = XR_BODY_JOINT_SET_FULL_BODY_JOINTS_BD;
+                XrResult res = xrCreateBodyTrackerBD(session, &createInfo, &bodyTracker);
+                if (XR_FAILED(res)) {
+                    PLOGW("[DEBUGGING] No body tracking: creating the tracker failed: %d", res);
+                    bodyTracker = XR_NULL_HANDLE;
+                } else {
+                    PLOGI("[DEBUGGING] Body tracking with %d joints", XR_BODY_JOINT_COUNT_BD);
+                }
+            }
+        } else if (bodyTracker == XR_NULL_HANDLE) {
+            PLOGI("[DEBUGGING] No body tracking: %s is not enabled", XR_BD_BODY_TRACKING_EXTENSION_NAME);
+        }
+
+        if (!motionTracking && openxr_wrapper->IsExtensionEnabled(XR_PICO_MOTION_TRACKING_EXTENSION_NAME)) {
+            if (XR_FAILED(xrGetInstanceProcAddr(instance, "xrRequestMotionTrackerDevicePICO",
+                                                reinterpret_cast<PFN_xrVoidFunction *>(&xrRequestMotionTrackerDevicePICO))) ||
+                XR_FAILED(xrGetInstanceProcAddr(instance, "xrLocateMotionTrackerPICO",
+                                                reinterpret_cast<PFN_xrVoidFunction *>(&xrLocateMotionTrackerPICO)))) {
+                PLOGW("[DEBUGGING] No motion trackers: the runtime does not resolve their functions");
+            } else {
+                motionTracking = true;
+                // The trackers already paired arrive as an event, as do later ones.
+                XrResult res = xrRequestMotionTrackerDevicePICO(session, POSE_MAX_TRACKERS);
+                if (XR_FAILED(res)) {
+                    PLOGW("[DEBUGGING] Requesting motion trackers failed: %d", res);
+                }
+                PLOGI("[DEBUGGING] Motion trackers enabled");
+            }
+        } else if (!motionTracking) {
+            PLOGI("[DEBUGGING] No motion trackers: %s is not enabled", XR_PICO_MOTION_TRACKING_EXTENSION_NAME);
+        }
+        return Available();
+    }
+
+    static bool Available() {
+        return bodyTracker != XR_NULL_HANDLE || motionTracking;
+    }
+
+    /// Takes the motion tracker events the wrapper polls: a tracker connecting
+    /// gets the first free slot, one disconnecting frees its slot.
+    static void HandleEvent(const XrEventDataBaseHeader *eventData) {
+        if (eventData->type == XR_TYPE_EVENT_DATA_REQUEST_MOTION_TRACKER_COMPLETE_PICO) {
+            auto complete = reinterpret_cast<const XrEventDataRequestMotionTrackerCompletePICO *>(eventData);
+            if (XR_FAILED(complete->result)) {
+                PLOGW("[DEBUGGING] Motion tracker request failed: %d", complete->result);
+                return;
+            }
+            for (uint32_t i = 0; i < complete->trackerCount && i < XR_MOTION_TRACKER_MAX_SIZE_PICO; i++) {
+                TrackerConnected(complete->trackerIds[i], true);
+            }
+        } else if (eventData->type == XR_TYPE_EVENT_DATA_MOTION_TRACKER_CONNECTION_STATE_CHANGED_PICO) {
+            auto changed = reinterpret_cast<const XrEventDataMotionTrackerConnectionStateChangedPICO *>(eventData);
+            TrackerConnected(changed->trackerId,
+                             changed->state == XR_MOTION_TRACKER_CONNECTION_STATE_CONNECTED_PICO);
+        }
+    }
+
+    static void TrackerConnected(XrMotionTrackerIdPICO id, bool connected) {
+        int free = -1;
+        for (int i = 0; i < POSE_MAX_TRACKERS; i++) {
+            XrMotionTrackerIdPICO slot = trackerIds[i].load(std::memory_order_relaxed);
+            if (slot == id) {
+                if (!connected) {
+                    trackerIds[i].store(0, std::memory_order_relaxed);
+                    PLOGI("[DEBUGGING] Motion tracker %d disconnected", i);
+                }
+                return;
+            }
+            if (slot == 0 && free < 0) {
+                free = i;
+            }
+        }
+        if (connected && free >= 0) {
+            trackerIds[free].store(id, std::memory_order_relaxed);
+            PLOGI("[DEBUGGING] Motion tracker %d connected", free);
+        }
+    }
+
+    /// Locates every body joint at time into frame, on the sampler thread and
+    /// under its rules: no allocation, no logging. Returns false when there is
+    /// no tracker or no joint was located.
+    static bool ProcessBody(XrTime time, PoseFrame &frame) {
+        if (bodyTracker == XR_NULL_HANDLE) {
+            return false;
+        }
+        XrBodyJointLocationBD joints[XR_BODY_JOINT_COUNT_BD];
+        XrBodyJointsLocateInfoBD info{XR_TYPE_BODY_JOINTS_LOCATE_INFO_BD};
+        info.baseSpace = baseSpace;
+        info.time = time;
+        XrBodyJointLocationsBD locations{XR_TYPE_BODY_JOINT_LOCATIONS_BD};
+        locations.jointLocationCount = XR_BODY_JOINT_COUNT_BD;
+        locations.jointLocations = joints;
+        XrResult res = xrLocateBodyJointsBD(bodyTracker, &info, &locations);
+        if (XR_FAILED(res)) {
+            Failed(res);
+            return false;
+        }
+
+        frame.trackedMask = 0;
+        int tracked = 0;
+        for (int i = 0; i < XR_BODY_JOINT_COUNT_BD; i++) {
+            if (!Tracked(joints[i].locationFlags)) {
+                continue;
+            }
+            StorePose(joints[i].pose, frame.joints[i]);
+            frame.trackedMask |= 1u << i;
+            tracked++;
+        }
+        if (tracked == 0) {
+            stats.bodyUntracked++;
+            return false;
+        }
+        frame.time = (uint64_t) time;
+        frame.captureNs = MonotonicNs();
+        frame.hostTime = 0;
+        frame.source = POSE_SOURCE_BODY;
+        frame.jointCount = XR_BODY_JOINT_COUNT_BD;
+        stats.bodyReadings++;
+        stats.trackedJoints = tracked;
+        return true;
+    }
+
+    /// Locates the connected motion trackers at time into frame, by slot; same
+    /// rules as ProcessBody(). Returns false when none was located.
+    static bool ProcessTrackers(XrTime time, PoseFrame &frame) {
+        if (!motionTracking) {
+            return false;
+        }
+        XrMotionTrackerLocationInfoPICO info{XR_TYPE_MOTION_TRACKER_LOCATION_INFO_PICO};
+        info.baseSpace = baseSpace;
+        info.time = time;
+        frame.trackedMask = 0;
+        int tracked = 0;
+        for (int i = 0; i < POSE_MAX_TRACKERS; i++) {
+            XrMotionTrackerIdPICO id = trackerIds[i].load(std::memory_order_relaxed);
+            if (id == 0) {
+                continue;
+            }
+            XrMotionTrackerSpaceLocationPICO location{XR_TYPE_MOTION_TRACKER_SPACE_LOCATION_PICO};
+            XrResult res = xrLocateMotionTrackerPICO(session, id, &info, &location);
+            if (XR_FAILED(res)) {
+                Failed(res);
+                continue;
+            }
+            if (!Tracked(location.locationFlags)) {
+                continue;
+            }
+            StorePose(location.pose, frame.joints[i]);
+            frame.trackedMask |= 1u << i;
+            tracked++;
+        }
+        if (tracked == 0) {
+            return false;
+        }
+        frame.time = (uint64_t) time;
+        frame.captureNs = MonotonicNs();
+        frame.hostTime = 0;
+        frame.source = POSE_SOURCE_TRACKERS;
+        frame.jointCount = POSE_MAX_TRACKERS;
+        stats.trackerReadings++;
+        stats.trackedTrackers = tracked;
+        return true;
+    }
+
+    /// One line with the counters since the last call, then resets them. Call
+    /// from the sampling thread, every few seconds.
+    static void LogStats() {
+        if (!Available()) {
+            return;
+        }
+        PLOGI("[DEBUGGING] Poses: %llu body readings (%d joints), %llu without joints, %llu tracker readings (%d trackers), %llu failed (last %d)",
+              (unsigned long long) stats.bodyReadings, stats.trackedJoints, (unsigned long long) stats.bodyUntracked,
+              (unsigned long long) stats.trackerReadings, stats.trackedTrackers, (unsigned long long) stats.failed,
+              stats.lastError);
+        stats.bodyReadings = stats.bodyUntracked = stats.trackerReadings = stats.failed = 0;
+        stats.trackedJoints = stats.trackedTrackers = 0;
+    }
+
+    static void DisposeTracker() {
+        motionTracking = false;
+        if (bodyTracker == XR_NULL_HANDLE) {
+            return;
+        }
+        XrResult res = xrDestroyBodyTrackerBD(bodyTracker);
+        if (XR_FAILED(res)) {
+            PLOGW("[DEBUGGING] Destroying the body tracker failed: %d", res);
+        }
+        bodyTracker = XR_NULL_HANDLE;
+    }
+};
+PFN_xrCreateBodyTrackerBD PoseTrackerHandler::xrCreateBodyTrackerBD = nullptr;
+PFN_xrDestroyBodyTrackerBD PoseTrackerHandler::xrDestroyBodyTrackerBD = nullptr;
+PFN_xrLocateBodyJointsBD PoseTrackerHandler::xrLocateBodyJointsBD = nullptr;
+PFN_xrRequestMotionTrackerDevicePICO PoseTrackerHandler::xrRequestMotionTrackerDevicePICO = nullptr;
+PFN_xrLocateMotionTrackerPICO PoseTrackerHandler::xrLocateMotionTrackerPICO = nullptr;
+XrBodyTrackerBD PoseTrackerHandler::bodyTracker = XR_NULL_HANDLE;
+bool PoseTrackerHandler::motionTracking = false;
+XrSession PoseTrackerHandler::session = XR_NULL_HANDLE;
+XrSpace PoseTrackerHandler::baseSpace = XR_NULL_HANDLE;
+std::atomic<XrMotionTrackerIdPICO> PoseTrackerHandler::trackerIds[POSE_MAX_TRACKERS] = {};
+PoseTrackerHandler::Stats PoseTrackerHandler::stats = {};
+#endif //PICONATIVEOPENXRSAMPLES_POSETRACKERHANDLER_H
@@ -0,0 +1,48 @@
+//
+// Created by user on 17-Oct-26.
+//
+
+#ifndef PICONATIVEOPENXRSAMPLES_SPSCRING_H
+#define PICONATIVEOPENXRSAMPLES_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+
+/// Bounded single-producer / single-consumer ring. TryPush is only ever called
+/// from one thread and TryPop from another; neither blocks nor allocates.
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool TryPush(const T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail & (Capacity - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots_[Capacity];
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif //PICONATIVEOPENXRSAMPLES_SPSCRING_H
@@ -6,76 +6,880 @@
 #define PICONATIVEOPENXRSAMPLES_TCPCLIENTV2_H
 
 #include "LogUtils.h"
+#include "Configurations.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <string>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include "EyeTrackerHandler.h"
-#ifndef SHARED_H
-#define SHARED_H
-
-#pragma pack(push, 1)
-struct Message {
-    int id;
-    uint32_t value;
-    char text[32];
-    EtData etData;
+#include "framing.h"
+#include "etcodec.h"
+#include "control.h"
+#include "blendshape.h"
+#include "poses.h"
+#include "gaze.h"
+#include "datagram.h"
+#include "latency.h"
+#include "HostDiscovery.h"
+#include <netinet/tcp.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+
+/// Where the host is and how to reach it. An empty hostAddress means find it
+/// with HostDiscovery; port is then taken from the host's answer.
+struct ConnectionSettings {
+    std::string hostAddress;
+    uint16_t port = 54000;
+    uint16_t discoveryPort = DISCOVERY_PORT;
+    bool udp = false;
+    int reconnectMinMs = 250;
+    int reconnectMaxMs = 10000;
 };
-#pragma pack(pop)
 
-#endif
+/// Applies a host control request (control.h) other than a time sync. Returns
+/// false when the command is not supported; otherwise value holds what was
+/// actually applied, e.g. a rate after clamping.
+typedef bool (*ControlHandler)(uint8_t command, uint32_t &value);
+
+/// The current XrTime as the samples are stamped with it, or 0 while unknown.
+typedef int64_t (*HeadsetClock)();
 
+/// The host's view of the link, from its latest CONTROL_LINK_REPORT; zeros
+/// until one arrives on the current connection.
+struct LinkQuality {
+    uint32_t roundTripUs;
+    uint16_t lossPermille;
+};
+
+struct SenderStats {
+    bool connected;
+    uint64_t connects;     // successful connections, the first one included
+    size_t queueDepth;
+    uint64_t samplesSent;
+    uint64_t samplesDropped;
+    uint64_t sendCalls;
+    uint64_t faceFramesSent;
+    uint64_t faceFramesReplaced;  // overtaken by a newer one before they could be sent
+    uint64_t poseFramesSent;
+    uint64_t poseFramesReplaced;  // likewise, per source
+    uint64_t gazeRaysSent;
+    uint64_t gazeRaysReplaced;
+    int64_t avgLatencyNs;  // enqueue -> last byte handed to the kernel, moving average
+    int64_t maxLatencyNs;
+};
+
+/// Streams eye samples to the host. The socket is non-blocking: Enqueue only
+/// queues, Flush gathers every queued frame into one sendmsg() and returns as
+/// soon as the kernel buffer is full. Both are called from the sender thread.
 class TcpClient {
 public:
-    static void OpenConnection() {
-        sock = socket(AF_INET, SOCK_STREAM, 0);
+    /// Remembers where the host is and how to reach it; the sender thread
+    /// connects on its first MaintainConnection() call.
+    static void Configure(const ConnectionSettings &connectionSettings) {
+        settings = connectionSettings;
+        udp = settings.udp;
+        backoffMs = 0;
+        nextAttemptNs = 0;
+    }
+
+    /// Makes one attempt to reach the host: discovers it unless an address is
+    /// configured, then connects over TCP or UDP. UDP skips the hello exchange and
+    /// always sends self-contained v2 key records.
+    static bool OpenConnection() {
+        sockaddr_in serverAddr{};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_port = htons(settings.port);
+        if (settings.hostAddress.empty()) {
+            if (!HostDiscovery::Find(settings.discoveryPort, udp, kDiscoveryTimeoutMs, serverAddr)) {
+                return false;
+            }
+        } else if (inet_pton(AF_INET, settings.hostAddress.c_str(), &serverAddr.sin_addr) <= 0) {
+            PLOGE("[DEBUGGING] Invalid host address '%s'", settings.hostAddress.c_str());
+            return false;
+        }
+
+        sock = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
         if (sock < 0) {
             PLOGE("[DEBUGGING] Socket creation failed");
+            return false;
+        }
+
+        // Connect without blocking so an unreachable host costs kConnectTimeoutMs,
+        // not the kernel's minutes-long SYN retry.
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+        if (connect(sock, (sockaddr *) &serverAddr, sizeof(serverAddr)) < 0) {
+            int error = errno;
+            if (error == EINPROGRESS) {
+                pollfd pfd{sock, POLLOUT, 0};
+                socklen_t length = sizeof(error);
+                if (poll(&pfd, 1, kConnectTimeoutMs) <= 0) {
+                    error = ETIMEDOUT;
+                } else if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+                    error = errno;
+                }
+            }
+            if (error != 0) {
+                PLOGE("[DEBUGGING] Connection failed: %s", strerror(error));
+                CloseConnection();
+                return false;
+            }
+        }
+
+        if (udp) {
+            wireVersion = ET_WIRE_V2;
+            encoder = EtEncoder(false);
+            sendBlendshapes = false;
+            sendPoses = false;
+            sendGaze = false;
+            link = LinkQuality{};
+            failedBatches = 0;
+        } else {
+            // Let a host that vanished without closing the connection fail the
+            // next send instead of leaving the queue stalled forever.
+            unsigned int userTimeout = kTcpUserTimeoutMs;
+            setsockopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof(userTimeout));
+            // A lone control reply must not wait behind the previous batch's ack.
+            int noDelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+            Negotiate();
+            fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+        }
+
+        char address[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &serverAddr.sin_addr, address, sizeof(address));
+        PLOGI("[DEBUGGING] Connected to %s:%d over %s", address, ntohs(serverAddr.sin_port), udp ? "UDP" : "TCP");
+        return true;
+    }
+
+    /// Reconnects once the backoff since the last failure has passed. Returns
+    /// whether a connection is up; queued samples wait (subject to the overflow
+    /// policy) while it is not. Sender thread only.
+    static bool MaintainConnection() {
+        if (sock >= 0) {
+            return true;
+        }
+        if (NowNs() < nextAttemptNs) {
+            return false;
+        }
+        if (OpenConnection()) {
+            if (stats.connects++ > 0) {
+                PLOGI("[DEBUGGING] Reconnected after %d ms backoff", backoffMs);
+            }
+            backoffMs = 0;
+            return true;
+        }
+
+        // Exponential backoff with jitter, so a room of headsets does not retry in lockstep.
+        int minMs = settings.reconnectMinMs > 0 ? settings.reconnectMinMs : 1;
+        int maxMs = settings.reconnectMaxMs > minMs ? settings.reconnectMaxMs : minMs;
+        backoffMs = backoffMs == 0 ? minMs : (backoffMs > maxMs / 2 ? maxMs : backoffMs * 2);
+        int waitMs = backoffMs / 2 + (int) (random() % (backoffMs / 2 + 1));
+        nextAttemptNs = NowNs() + (int64_t) waitMs * 1000000;
+        PLOGW("[DEBUGGING] Host not reachable, retrying in %d ms", waitMs);
+        return false;
+    }
+
+    /// Reads what the host sent since the last call without blocking, hands each
+    /// control request to handler and queues the answers. Time syncs are answered
+    /// here with the headset's XrTime at receipt, so the host can map sample times
+    /// onto its own clock. Notices a host that closed or broke the connection.
+    /// Sender thread only.
+    static void PollControl(ControlHandler handler, HeadsetClock headsetNow) {
+        if (sock < 0 || udp) {
             return;
         }
+        controlBuffered = false;
+        while (true) {
+            // Frames the handshake left buffered go first.
+            FrameHeader hdr;
+            const uint8_t *payload;
+            while (controlDecoder.Next(hdr, payload)) {
+                if (hdr.type != FRAME_CONTROL || hdr.length < sizeof(ControlPayload)) {
+                    continue;
+                }
+                ControlPayload request;
+                std::memcpy(&request, payload, sizeof(request));
+                if (request.command == CONTROL_LINK_REPORT) {
+                    link = LinkQuality{request.value, request.loss};
+                    continue;  // informs only, not answered
+                }
+                PendingReply reply{request, NowNs()};
+                reply.payload.status = CONTROL_OK;
+                if (request.command == CONTROL_TIME_SYNC) {
+                    reply.payload.clientTime = (uint64_t) headsetNow();
+                } else if (!handler(request.command, reply.payload.value)) {
+                    reply.payload.status = CONTROL_UNSUPPORTED;
+                }
+                QueueReply(reply);
+            }
 
-        sockaddr_in serverAddr{};
-        serverAddr.sin_family = AF_INET;
-        serverAddr.sin_port = htons(54000);
+            size_t space;
+            uint8_t *dst = controlDecoder.WritePtr(space);
+            ssize_t received = recv(sock, dst, space, MSG_DONTWAIT);
+            if (received == 0) {
+                PLOGE("[DEBUGGING] Host closed the connection, reconnecting");
+                CloseConnection();
+                return;
+            }
+            if (received < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    PLOGE("[DEBUGGING] Connection lost: %s, reconnecting", strerror(errno));
+                    CloseConnection();
+                }
+                return;  // nothing more for now
+            }
+            controlDecoder.Commit(received);
+        }
+    }
 
-        if (inet_pton(AF_INET, "192.168.100.111", &serverAddr.sin_addr) <=
-            0) { // Replace with your server's IP
-            PLOGE("[DEBUGGING] Invalid address");
-            close(sock);
+    /// How long MaintainConnection() has nothing to do, for the sender to sleep.
+    static int MillisUntilReconnect() {
+        int64_t remaining = nextAttemptNs - NowNs();
+        return remaining > 0 ? (int) (remaining / 1000000) + 1 : 0;
+    }
+
+    /// Offers face tracking to the host on every connection from now on, with
+    /// these channels; null stops offering it. The dictionary must outlive the
+    /// client. Call before the sender thread starts.
+    static void SetBlendshapeDictionary(const BlendshapeDictionary *channels) {
+        blendshapeDictionary = channels;
+    }
+
+    /// Queues a face reading when the host agreed to take them. Only the newest
+    /// waits: a blendshape frame is the whole face, so an older one still queued
+    /// is worth nothing once a newer exists, and a stalled link then costs one
+    /// frame of bandwidth rather than a backlog.
+    static void EnqueueBlendshapes(const BlendshapeFrame &frame) {
+        if (!sendBlendshapes) {
             return;
         }
+        if (hasPendingFace) {
+            stats.faceFramesReplaced++;
+        }
+        pendingFace = frame;
+        hasPendingFace = true;
+    }
 
-        if (connect(sock, (sockaddr *) &serverAddr, sizeof(serverAddr)) < 0) {
-            PLOGE("[DEBUGGING] Connection failed");
-            close(sock);
+    /// Offers body and motion-tracker poses to the host on every connection from
+    /// now on. Call before the sender thread starts.
+    static void SetPosesOffered(bool offered) {
+        offerPoses = offered;
+    }
+
+    /// Queues a pose frame when the host agreed to take them. As with the face,
+    /// only the newest frame of each source waits.
+    static void EnqueuePoses(const PoseFrame &frame) {
+        int slot = PoseSourceSlot(frame.source);
+        if (!sendPoses || slot < 0) {
             return;
         }
+        if (hasPendingPoses[slot]) {
+            stats.poseFramesReplaced++;
+        }
+        pendingPoses[slot] = frame;
+        hasPendingPoses[slot] = true;
     }
 
-    static void SendMessage(uint32_t value, EtData etData) {
-        Message msg{};
+    /// Offers the combined gaze ray to the host on every connection from now on.
+    /// Call before the sender thread starts.
+    static void SetGazeOffered(bool offered) {
+        offerGaze = offered;
+    }
 
-        msg.id = counter++;
-        msg.value = value;
-        msg.etData = etData;
-        std::snprintf(msg.text, sizeof(msg.text), "Hello %d", msg.id);
+    /// Queues a gaze ray when the host agreed to take them; only the newest waits.
+    static void EnqueueGazeRay(const GazeRay &ray) {
+        if (!sendGaze) {
+            return;
+        }
+        if (hasPendingGaze) {
+            stats.gazeRaysReplaced++;
+        }
+        pendingGaze = ray;
+        hasPendingGaze = true;
+    }
+
+    /// Asks the host for link reports on every connection from now on. Call
+    /// before the sender thread starts.
+    static void SetLinkReportsWanted(bool wanted) {
+        offerLinkReports = wanted;
+    }
+
+    /// Sender thread only.
+    static LinkQuality Link() {
+        return link;
+    }
+
+    static void SetOverflowPolicy(PVRSampleFW::OverflowPolicy overflowPolicy, int blockTimeoutMs) {
+        policy = overflowPolicy;
+        blockTimeout = blockTimeoutMs;
+    }
+
+    /// Queues one sample; it is encoded in the wire format agreed on at connect
+    /// when it is handed to the socket, so dropped samples never break the delta chain.
+    static void Enqueue(const EtSample &sample) {
+        if (pendingCount == kQueueCapacity) {
+            switch (policy) {
+                case PVRSampleFW::OverflowPolicy::BlockWithTimeout:
+                    if (WaitWritable(blockTimeout)) {
+                        Flush();
+                    }
+                    if (pendingCount < kQueueCapacity) {
+                        break;
+                    }
+                    DropPending(1);
+                    break;
+                case PVRSampleFW::OverflowPolicy::CoalesceLatest:
+                    DropPending(pendingCount);
+                    break;
+                case PVRSampleFW::OverflowPolicy::DropOldest:
+                default:
+                    DropPending(1);
+                    break;
+            }
+        }
+
+        PendingSample &slot = pending[(pendingHead + pendingCount) % kQueueCapacity];
+        slot.sample = sample;
+        slot.enqueuedAt = NowNs();
+        pendingCount++;
+    }
+
+    /// Writes as much as the socket takes without blocking. Returns false once the
+    /// connection is gone.
+    static bool Flush() {
+        if (udp) {
+            return FlushDatagrams();
+        }
+
+        while (sock >= 0) {
+            if (inflightCount == 0 && !FillInflight()) {
+                return true;
+            }
+
+            iovec iov[kBatchSize];
+            size_t skip = inflightSent;
+            int iovCount = 0;
+            for (int i = 0; i < inflightCount; i++) {
+                if (skip >= inflight[i].length) {
+                    skip -= inflight[i].length;
+                    continue;
+                }
+                iov[iovCount].iov_base = inflight[i].bytes + skip;
+                iov[iovCount].iov_len = inflight[i].length - skip;
+                iovCount++;
+                skip = 0;
+            }
+
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovCount;
+            ssize_t written = sendmsg(sock, &msg, MSG_NOSIGNAL);
+            stats.sendCalls++;
+            if (written < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return true;
+                }
+                PLOGE("[DEBUGGING] Connection lost: %s, reconnecting", strerror(errno));
+                CloseConnection();
+                return false;
+            }
+
+            inflightSent += written;
+            size_t total = 0;
+            for (int i = 0; i < inflightCount; i++) {
+                total += inflight[i].length;
+            }
+            if (inflightSent < total) {
+                return true;  // kernel buffer is full, try again when writable
+            }
+
+            int64_t now = NowNs();
+            for (int i = 0; i < inflightCount; i++) {
+                if (!inflight[i].sample) {
+                    continue;
+                }
+                RecordLatency(now - inflight[i].enqueuedAt);
+                if (inflight[i].capturedAt > 0) {
+                    captureToSend.Record(now - inflight[i].capturedAt);
+                }
+                stats.samplesSent++;
+            }
+            inflightCount = 0;
+            inflightSent = 0;
+        }
+        return false;
+    }
 
-        send(sock, &msg, sizeof(msg), 0);
+    /// UDP variant of Flush: one datagram per frame, the whole batch in one sendmmsg().
+    static bool FlushDatagrams() {
+        while (sock >= 0 && (inflightCount > 0 || FillInflight())) {
+            DatagramHeader headers[kBatchSize];
+            iovec iov[kBatchSize][2];
+            mmsghdr msgs[kBatchSize] = {};
+            int64_t sendTime = NowNs();
+            for (int i = 0; i < inflightCount; i++) {
+                uint16_t age = CaptureAgeUs(inflight[i].capturedAt, sendTime);
+                headers[i] = {DATAGRAM_MAGIC, age, datagramSequence + i, (uint64_t) sendTime};
+                iov[i][0] = {&headers[i], sizeof(DatagramHeader)};
+                iov[i][1] = {inflight[i].bytes, inflight[i].length};
+                msgs[i].msg_hdr.msg_iov = iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 2;
+            }
+
+            int sent = sendmmsg(sock, msgs, inflightCount, MSG_NOSIGNAL);
+            stats.sendCalls++;
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    return true;
+                }
+                // e.g. ECONNREFUSED while the host is down: the samples are stale anyway.
+                stats.samplesDropped += inflightCount;
+                datagramSequence += inflightCount;
+                inflightCount = 0;
+                // A refused send alternates with ones that seem to succeed, so count
+                // refusals that follow each other closely rather than in a row.
+                int64_t now = NowNs();
+                if (now - lastFailureNs > kFailureWindowNs) {
+                    failedBatches = 0;
+                }
+                lastFailureNs = now;
+                if (++failedBatches >= kMaxFailedBatches) {
+                    // The host is gone or moved; go back to discovery.
+                    PLOGE("[DEBUGGING] Host not answering: %s, reconnecting", strerror(errno));
+                    CloseConnection();
+                    return false;
+                }
+                continue;
+            }
+
+            int64_t now = NowNs();
+            for (int i = 0; i < sent; i++) {
+                RecordLatency(now - inflight[i].enqueuedAt);
+                if (inflight[i].capturedAt > 0) {
+                    captureToSend.Record(now - inflight[i].capturedAt);
+                }
+            }
+            stats.samplesSent += sent;
+            datagramSequence += sent;
+            inflightCount -= sent;
+            std::memmove(inflight, inflight + sent, inflightCount * sizeof(OutFrame));
+        }
+        return sock >= 0;
+    }
+
+    /// Whether queued data waits for the socket to drain. False without a
+    /// socket: there is nothing to wait on then, and a sender polling
+    /// WaitWritable() would only spin.
+    static bool HasBacklog() {
+        if (sock < 0) {
+            return false;
+        }
+        return inflightCount > 0 || pendingCount > 0 || replyCount > 0 || hasPendingFace || hasPendingGaze ||
+               std::any_of(hasPendingPoses, hasPendingPoses + POSE_SOURCE_COUNT, [](bool pending) { return pending; });
+    }
+
+    /// Waits until the socket accepts more data or timeoutMs passes.
+    static bool WaitWritable(int timeoutMs) {
+        if (sock < 0) {
+            return false;
+        }
+        pollfd pfd{sock, POLLOUT, 0};
+        return poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLOUT);
     }
 
+    /// Sleeps until wakeFd turns readable, the host sent something, queued data
+    /// can move on, or timeoutMs passes. Returns whether wakeFd woke it. Waking on
+    /// the host's frames keeps the time between a ping's arrival and
+    /// PollControl() reading it out of the round trip the host measures.
+    static bool WaitForWork(int wakeFd, int timeoutMs) {
+        if (controlBuffered) {
+            timeoutMs = 0;  // the socket shows nothing of what the handshake read ahead
+        }
+        pollfd pfds[2] = {{wakeFd, POLLIN, 0}, {sock, 0, 0}};
+        if (sock >= 0) {
+            pfds[1].events = (short) ((udp ? 0 : POLLIN) | (HasBacklog() ? POLLOUT : 0));
+        }
+        nfds_t count = pfds[1].events != 0 ? 2 : 1;
+        return poll(pfds, count, timeoutMs) > 0 && (pfds[0].revents & POLLIN);
+    }
+
+    static SenderStats Stats() {
+        SenderStats current = stats;
+        current.connected = sock >= 0;
+        current.queueDepth = pendingCount;
+        return current;
+    }
+
+    /// Capture -> handed to the kernel, per sample. Sender thread only; the
+    /// caller resets it after reporting.
+    static LatencyHistogram &CaptureToSend() {
+        return captureToSend;
+    }
+
+    /// Closes the socket. A batch that was only partly written cannot be resumed
+    /// on a new connection, so it counts as dropped; queued samples are kept.
     static void CloseConnection() {
-        close(sock);
+        if (sock >= 0) {
+            close(sock);
+        }
+        sock = -1;
+        for (int i = 0; i < inflightCount; i++) {
+            if (inflight[i].sample) {
+                stats.samplesDropped++;
+            }
+        }
+        replyCount = 0;  // they answer requests made on this connection
+        inflightCount = 0;
+        inflightSent = 0;
     }
 
 private:
+    /// Offers wire v2 with delta encoding, timing and control, face tracking when
+    /// there is a dictionary, and poses, the gaze ray and link reports when
+    /// offered, and waits briefly for the host's answer.
+    /// Hosts that predate v2 ignore the hello, so we stay on the legacy struct.
+    static void Negotiate() {
+        wireVersion = ET_WIRE_LEGACY;
+        sendTiming = false;
+        sendBlendshapes = false;
+        hasPendingFace = false;
+        sendPoses = false;
+        std::fill(hasPendingPoses, hasPendingPoses + POSE_SOURCE_COUNT, false);
+        sendGaze = false;
+        hasPendingGaze = false;
+        link = LinkQuality{};
+        controlDecoder = FrameDecoder();
+
+        uint8_t flags = HELLO_DELTA | HELLO_TIMING | HELLO_CONTROL | (blendshapeDictionary ? HELLO_BLENDSHAPES : 0) |
+                        (offerPoses ? HELLO_POSES : 0) | (offerGaze ? HELLO_GAZE : 0) |
+                        (offerLinkReports ? HELLO_LINK_REPORTS : 0);
+        HelloPayload hello{ET_WIRE_V2, flags};
+        uint8_t frame[sizeof(FrameHeader) + sizeof(HelloPayload)];
+        size_t length = WriteFrame(frame, sizeof(frame), FRAME_HELLO, &hello, sizeof(hello));
+        if (send(sock, frame, length, 0) != (ssize_t) length) {
+            return;
+        }
+
+        timeval timeout{0, 500 * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        // Decodes into controlDecoder and stops at the ack: the host pings right
+        // after it, and PollControl() takes whatever came in the same read.
+        FrameHeader hdr;
+        const uint8_t *payload;
+        bool answered = false;
+        while (!answered) {
+            size_t space;
+            uint8_t *dst = controlDecoder.WritePtr(space);
+            ssize_t received = recv(sock, dst, space, 0);
+            if (received <= 0) {
+                break;
+            }
+            controlDecoder.Commit(received);
+            while (!answered && controlDecoder.Next(hdr, payload)) {
+                if (hdr.type == FRAME_HELLO_ACK && hdr.length >= sizeof(HelloPayload)) {
+                    HelloPayload ack;
+                    std::memcpy(&ack, payload, sizeof(ack));
+                    wireVersion = ack.version;
+                    encoder = EtEncoder((ack.flags & HELLO_DELTA) != 0);
+                    sendTiming = (ack.flags & HELLO_TIMING) != 0;
+                    sendPoses = (ack.flags & HELLO_POSES) != 0;
+                    sendGaze = (ack.flags & HELLO_GAZE) != 0;
+                    answered = true;
+                    controlBuffered = true;
+                    PLOGI("[DEBUGGING] Host %s control requests", (ack.flags & HELLO_CONTROL) ? "sends" : "does not send");
+                    if (ack.flags & HELLO_BLENDSHAPES) {
+                        SendBlendshapeDictionary();
+                    }
+                }
+            }
+        }
+
+        timeval noTimeout{0, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &noTimeout, sizeof(noTimeout));
+        PLOGI("[DEBUGGING] Streaming with wire v%d", wireVersion);
+    }
+
+    /// Names the face channels once, right after the hello, while the socket still
+    /// blocks; frames only follow if that went out whole.
+    static void SendBlendshapeDictionary() {
+        uint8_t frame[sizeof(FrameHeader) + FRAME_MAX_PAYLOAD];
+        size_t length = WriteBlendshapeDictionary(*blendshapeDictionary, frame, sizeof(frame));
+        sendBlendshapes = length > 0 && send(sock, frame, length, MSG_NOSIGNAL) == (ssize_t) length;
+        PLOGI("[DEBUGGING] %s %d face channels", sendBlendshapes ? "Streaming" : "Could not offer",
+              blendshapeDictionary->channelCount);
+    }
+
+    static const int kQueueCapacity = 64;
+    static const int kBatchSize = 16;
+    static const int kDiscoveryTimeoutMs = 500;
+    static const int kConnectTimeoutMs = 1000;
+    static const int kTcpUserTimeoutMs = 5000;
+    static const int kMaxReplies = 8;
+    static const int kMaxFailedBatches = 32;  // UDP sends the host refused, each within
+    static const int64_t kFailureWindowNs = 1000000000LL;  // this long of the previous one
+
+    struct PendingSample {
+        EtSample sample;
+        int64_t enqueuedAt;
+    };
+
+    struct OutFrame {
+        uint8_t bytes[std::max({BLENDSHAPE_MAX_FRAME, POSE_MAX_FRAME, sizeof(FrameHeader) + sizeof(Message)})];
+        uint16_t length;
+        bool sample;  // false for FRAME_TIMING, face, pose and gaze frames and control replies
+        int64_t enqueuedAt;
+        int64_t capturedAt;
+    };
+
+    struct PendingReply {
+        ControlPayload payload;
+        int64_t receivedAt;  // NowNs() when the request was read
+    };
+
+    /// Same clock as EtSample::captureNs.
+    static int64_t NowNs() {
+        return (int64_t) MonotonicNs();
+    }
+
+    static void DropPending(int count) {
+        pendingHead = (pendingHead + count) % kQueueCapacity;
+        pendingCount -= count;
+        stats.samplesDropped += count;
+    }
+
+    static void QueueReply(const PendingReply &reply) {
+        if (replyCount == kMaxReplies) {
+            PLOGW("[DEBUGGING] Dropping the answer to control command %d", reply.payload.command);
+            return;
+        }
+        replies[replyCount++] = reply;
+    }
+
+    /// Encodes up to kBatchSize queued samples, then the waiting gaze ray, face and
+    /// pose frames and any control replies, into the in-flight batch. With HELLO_TIMING agreed, slot 0 holds a FRAME_TIMING
+    /// stamped once the batch is known.
+    static bool FillInflight() {
+        bool timing = sendTiming && inflightCount == 0;
+        if (timing) {
+            inflightCount = 1;
+        }
+        while (inflightCount < kBatchSize && pendingCount > 0) {
+            const PendingSample &next = pending[pendingHead];
+            OutFrame &frame = inflight[inflightCount];
+            frame.length = (uint16_t) EncodeSample(next.sample, frame.bytes, sizeof(frame.bytes));
+            frame.sample = true;
+            frame.enqueuedAt = next.enqueuedAt;
+            frame.capturedAt = (int64_t) next.sample.captureNs;
+            pendingHead = (pendingHead + 1) % kQueueCapacity;
+            pendingCount--;
+            if (frame.length > 0) {
+                inflightCount++;
+            }
+        }
+        if (hasPendingGaze && inflightCount < kBatchSize) {
+            OutFrame &frame = inflight[inflightCount];
+            frame.length = (uint16_t) EncodeGazeRay(pendingGaze, frame.bytes, sizeof(frame.bytes));
+            frame.sample = false;
+            frame.enqueuedAt = NowNs();
+            frame.capturedAt = 0;
+            hasPendingGaze = false;
+            if (frame.length > 0) {
+                inflightCount++;
+                stats.gazeRaysSent++;
+            }
+        }
+        if (hasPendingFace && inflightCount < kBatchSize) {
+            OutFrame &frame = inflight[inflightCount];
+            frame.length = (uint16_t) EncodeBlendshapes(pendingFace, blendshapeDictionary->encoding, frame.bytes,
+                                                        sizeof(frame.bytes));
+            frame.sample = false;
+            frame.enqueuedAt = NowNs();
+            frame.capturedAt = 0;
+            hasPendingFace = false;
+            if (frame.length > 0) {
+                inflightCount++;
+                stats.faceFramesSent++;
+            }
+        }
+        for (int slot = 0; slot < POSE_SOURCE_COUNT && inflightCount < kBatchSize; slot++) {
+            if (!hasPendingPoses[slot]) {
+                continue;
+            }
+            OutFrame &frame = inflight[inflightCount];
+            frame.length = (uint16_t) EncodePoses(pendingPoses[slot], frame.bytes, sizeof(frame.bytes));
+            frame.sample = false;
+            frame.enqueuedAt = NowNs();
+            frame.capturedAt = 0;
+            hasPendingPoses[slot] = false;
+            if (frame.length > 0) {
+                inflightCount++;
+                stats.poseFramesSent++;
+            }
+        }
+        int replied = 0;
+        while (inflightCount < kBatchSize && replied < replyCount) {
+            PendingReply &reply = replies[replied++];
+            OutFrame &frame = inflight[inflightCount++];
+            frame.enqueuedAt = NowNs();
+            if (reply.payload.command == CONTROL_TIME_SYNC) {
+                // How long the request waited here, which the host takes out of the round trip.
+                int64_t held = frame.enqueuedAt - reply.receivedAt;
+                reply.payload.value = (uint32_t) (held > UINT32_MAX ? UINT32_MAX : held);
+            }
+            frame.length = (uint16_t) WriteFrame(frame.bytes, sizeof(frame.bytes), FRAME_CONTROL_ACK,
+                                                 &reply.payload, sizeof(ControlPayload));
+            frame.sample = false;
+            frame.capturedAt = 0;
+        }
+        replyCount -= replied;
+        std::memmove(replies, replies + replied, replyCount * sizeof(PendingReply));
+        if (timing) {
+            if (inflightCount == 1) {
+                inflightCount = 0;
+                return false;
+            }
+            if (inflight[1].sample) {
+                WriteTiming(inflight[0], inflight[1].capturedAt);
+            } else {
+                // Only replies, gaze, face and poses: there is no eye capture to time.
+                inflightCount--;
+                std::memmove(inflight, inflight + 1, inflightCount * sizeof(OutFrame));
+            }
+        }
+        return inflightCount > 0;
+    }
+
+    static void WriteTiming(OutFrame &frame, int64_t oldestCapture) {
+        int64_t now = NowNs();
+        int64_t age = oldestCapture > 0 ? now - oldestCapture : 0;
+        EtTimingPayload timing{(uint64_t) now, (uint32_t) (age < 0 ? 0 : (age > UINT32_MAX ? UINT32_MAX : age))};
+        frame.length = (uint16_t) WriteFrame(frame.bytes, sizeof(frame.bytes), FRAME_TIMING, &timing, sizeof(timing));
+        frame.sample = false;
+        frame.enqueuedAt = now;
+        frame.capturedAt = 0;
+    }
+
+    /// Microseconds since capture for the datagram header, 0 when unknown.
+    static uint16_t CaptureAgeUs(int64_t capturedAt, int64_t now) {
+        if (capturedAt <= 0) {
+            return 0;
+        }
+        int64_t us = (now - capturedAt) / 1000;
+        return (uint16_t) (us < 1 ? 1 : (us > UINT16_MAX ? UINT16_MAX : us));
+    }
+
+    static size_t EncodeSample(const EtSample &sample, uint8_t *out, size_t cap) {
+        if (wireVersion >= ET_WIRE_V2) {
+            return encoder.Encode(sample, out, cap);
+        }
+
+        Message msg{};
+        msg.id = counter++;
+        msg.etData = sample.data;
+        std::snprintf(msg.text, sizeof(msg.text), "Hello %d", msg.id);
+        return WriteFrame(out, cap, FRAME_LEGACY_MESSAGE, &msg, sizeof(msg));
+    }
+
+    static void RecordLatency(int64_t latencyNs) {
+        stats.avgLatencyNs += (latencyNs - stats.avgLatencyNs) / 16;
+        if (latencyNs > stats.maxLatencyNs) {
+            stats.maxLatencyNs = latencyNs;
+        }
+    }
+
+    static ConnectionSettings settings;
+    static int backoffMs;
+    static int64_t nextAttemptNs;
+    static int failedBatches;
+    static int64_t lastFailureNs;
     static int sock;
+    static bool udp;
+    static uint32_t datagramSequence;
     static int counter;
+    static int wireVersion;
+    static bool sendTiming;
+    static EtEncoder encoder;
+    static FrameDecoder controlDecoder;
+    static bool controlBuffered;  // controlDecoder may hold frames read with the hello ack
+    static const BlendshapeDictionary *blendshapeDictionary;
+    static bool sendBlendshapes;
+    static BlendshapeFrame pendingFace;
+    static bool hasPendingFace;
+    static bool offerPoses;
+    static bool sendPoses;
+    static PoseFrame pendingPoses[POSE_SOURCE_COUNT];  // at PoseSourceSlot(source)
+    static bool hasPendingPoses[POSE_SOURCE_COUNT];
+    static bool offerGaze;
+    static bool sendGaze;
+    static GazeRay pendingGaze;
+    static bool hasPendingGaze;
+    static bool offerLinkReports;
+    static LinkQuality link;
+    static PendingReply replies[kMaxReplies];
+    static int replyCount;
+
+    static PVRSampleFW::OverflowPolicy policy;
+    static int blockTimeout;
+    static PendingSample pending[kQueueCapacity];
+    static int pendingHead;
+    static int pendingCount;
+    static OutFrame inflight[kBatchSize];
+    static int inflightCount;
+    static size_t inflightSent;
+    static SenderStats stats;
+    static LatencyHistogram captureToSend;
 };
+ConnectionSettings TcpClient::settings;
+int TcpClient::backoffMs = 0;
+int64_t TcpClient::nextAttemptNs = 0;
+int TcpClient::failedBatches = 0;
+int64_t TcpClient::lastFailureNs = 0;
 int TcpClient::sock = -1;
+bool TcpClient::udp = false;
+uint32_t TcpClient::datagramSequence = 0;
 int TcpClient::counter = 0;
+int TcpClient::wireVersion = ET_WIRE_LEGACY;
+bool TcpClient::sendTiming = false;
+EtEncoder TcpClient::encoder;
+FrameDecoder TcpClient::controlDecoder;
+bool TcpClient::controlBuffered = false;
+const BlendshapeDictionary *TcpClient::blendshapeDictionary = nullptr;
+bool TcpClient::sendBlendshapes = false;
+BlendshapeFrame TcpClient::pendingFace;
+bool TcpClient::hasPendingFace = false;
+bool TcpClient::offerPoses = false;
+bool TcpClient::sendPoses = false;
+PoseFrame TcpClient::pendingPoses[POSE_SOURCE_COUNT];
+bool TcpClient::hasPendingPoses[POSE_SOURCE_COUNT] = {};
+bool TcpClient::offerGaze = false;
+bool TcpClient::sendGaze = false;
+GazeRay TcpClient::pendingGaze;
+bool TcpClient::hasPendingGaze = false;
+bool TcpClient::offerLinkReports = false;
+LinkQuality TcpClient::link = {};
+TcpClient::PendingReply TcpClient::replies[TcpClient::kMaxReplies];
+int TcpClient::replyCount = 0;
+PVRSampleFW::OverflowPolicy TcpClient::policy = PVRSampleFW::OverflowPolicy::DropOldest;
+int TcpClient::blockTimeout = 5;
+TcpClient::PendingSample TcpClient::pending[TcpClient::kQueueCapacity];
+int TcpClient::pendingHead = 0;
+int TcpClient::pendingCount = 0;
+TcpClient::OutFrame TcpClient::inflight[TcpClient::kBatchSize];
+int TcpClient::inflightCount = 0;
+size_t TcpClient::inflightSent = 0;
+SenderStats TcpClient::stats = {};
+LatencyHistogram TcpClient::captureToSend;
 
 
 #endif //PICONATIVEOPENXRSAMPLES_TCPCLIENTV2_H